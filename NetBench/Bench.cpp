@@ -0,0 +1,128 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+volatile const void* g_pSink;
+volatile long long	 g_ValueSink;
+} // namespace
+
+BenchTimer::BenchTimer()
+: m_Elapsed(0)
+{
+	QueryPerformanceFrequency(&m_Frequency);
+	m_Start.QuadPart = 0;
+}
+
+void BenchTimer::Start()
+{
+	QueryPerformanceCounter(&m_Start);
+}
+
+void BenchTimer::Stop()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	m_Elapsed += now.QuadPart - m_Start.QuadPart;
+}
+
+double BenchTimer::GetSeconds() const
+{
+	return (double)m_Elapsed / m_Frequency.QuadPart;
+}
+
+void Consume(const void* p)
+{
+	g_pSink = p;
+}
+
+void Consume(long long value)
+{
+	g_ValueSink = value;
+}
+
+double MeasureThreadsNsPerOp(int threadCnt, long long iterations, const std::function<void(int threadIndex, long long iterations)>& body)
+{
+	std::atomic<int>  readyCnt{ 0 };
+	std::atomic<bool> go{ false };
+
+	std::vector<std::thread> vecThread;
+	for (int t = 0; t < threadCnt; ++t)
+	{
+		vecThread.emplace_back([&, t]() {
+			// warm up outside the timed window, the pools grow their chunks here
+			body(t, iterations / 10);
+
+			++readyCnt;
+			while (!go)
+				YieldProcessor();
+
+			body(t, iterations);
+		});
+	}
+
+	while (readyCnt < threadCnt)
+		Sleep(0);
+
+	BenchTimer timer;
+	timer.Start();
+	go = true;
+
+	for (std::thread& thread : vecThread)
+		thread.join();
+	timer.Stop();
+
+	return timer.GetSeconds() * 1e9 / (iterations * threadCnt);
+}
+
+int GetBenchThreadCount(int step)
+{
+	const int hardwareCnt = (std::max)((int)std::thread::hardware_concurrency(), 1);
+	const int threadCnt = 1 << step;
+	if (threadCnt >= hardwareCnt)
+		return (threadCnt >> 1) < hardwareCnt ? hardwareCnt : 0;
+
+	return threadCnt;
+}
+
+ULONGLONG GetProcessCpuTime()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+
+	return kernel.QuadPart + user.QuadPart;
+}
+
+void PrintGroup(const char* group)
+{
+	std::cout << std::endl << "[" << group << "]" << std::endl;
+}
+
+void PrintResult(const char* name, double nsPerOp)
+{
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1) << std::setw(12) << nsPerOp << " ns/op" << std::endl;
+}
+
+void PrintResult(const char* name, double nsPerOp, long long bytesPerOp)
+{
+	const double gbPerSecond = nsPerOp > 0 ? bytesPerOp / nsPerOp : 0;
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1) << std::setw(12) << nsPerOp << " ns/op"
+			  << std::setprecision(2) << std::setw(10) << gbPerSecond << " GB/s" << std::endl;
+}
+
+void PrintOverhead(const char* name, double baseNsPerOp, double nsPerOp)
+{
+	const double percent = baseNsPerOp > 0 ? (nsPerOp - baseNsPerOp) * 100 / baseNsPerOp : 0;
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1) << std::setw(12) << percent << " %" << std::endl;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <winsock2.h>
+#include <windows.h>
+#include <functional>
+
+// wall clock, after an untimed warm up of a tenth of the loop. compare on the same machine only
+
+class BenchTimer
+{
+public:
+	BenchTimer();
+
+	void   Start();
+	void   Stop();
+	void   Reset() { m_Elapsed = 0; }
+	double GetSeconds() const;
+
+private:
+	LARGE_INTEGER m_Frequency;
+	LARGE_INTEGER m_Start;
+	LONGLONG	  m_Elapsed;
+};
+
+// keeps a result alive, so the optimizer can't drop the work that produced it
+void Consume(const void* p);
+void Consume(long long value);
+
+template <typename FUNC>
+double MeasureNsPerOp(long long iterations, FUNC func)
+{
+	for (long long i = 0; i < iterations / 10; ++i)
+		func(i);
+
+	BenchTimer timer;
+	timer.Start();
+	for (long long i = 0; i < iterations; ++i)
+		func(i);
+	timer.Stop();
+
+	return timer.GetSeconds() * 1e9 / iterations;
+}
+
+// ns per operation over every thread's operations
+double MeasureThreadsNsPerOp(int threadCnt, long long iterations, const std::function<void(int threadIndex, long long iterations)>& body);
+
+// 1, 2, 4 ... up to the hardware threads, the last one always included
+int GetBenchThreadCount(int step);
+
+// kernel and user time of every thread in the process, in 100ns units
+ULONGLONG GetProcessCpuTime();
+
+void PrintGroup(const char* group);
+void PrintResult(const char* name, double nsPerOp);
+void PrintResult(const char* name, double nsPerOp, long long bytesPerOp);
+void PrintOverhead(const char* name, double baseNsPerOp, double nsPerOp); // nsPerOp over baseNsPerOp in percent
+
+// one group per file, NetBench.cpp selects them by name
+void RunCoreBench();
+void RunIntegrityBench();
+void RunCryptoBench();
+void RunLayoutBench();
+void RunFairnessBench();
+void RunTopicBench();
+void RunChainBench();
+void RunCoroutineBench();
+void RunShmBench();
+void RunStressBench();
+void RunLoopbackBench();
+void RunSendBufferBench();
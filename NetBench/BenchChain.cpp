@@ -0,0 +1,71 @@
+#include "Bench.h"
+#include "BenchEcho.h"
+#include "MessageChain.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr int CHAIN_APPEND_SIZE = 4 * 1024; // what a response builder appends at a time
+
+// what an application did before : the response grows in one vector, then is cut into MESSAGEs by hand
+double MeasureVectorBuild(ThreadLocalMemoryPool<MESSAGE>& pool, const std::vector<char>& piece, int payloadSize, bool reserve)
+{
+	std::vector<MESSAGE*> vecFragment;
+
+	return MeasureNsPerOp(GetBenchIterations(payloadSize), [&](long long) {
+		std::vector<char> buffer;
+		if (reserve)
+			buffer.reserve(payloadSize);
+
+		for (int size = 0; size < payloadSize; size += CHAIN_APPEND_SIZE)
+			buffer.insert(buffer.end(), piece.begin(), piece.end());
+
+		for (size_t offset = 0; offset < buffer.size(); offset += CHAIN_FRAGMENT_SIZE)
+		{
+			MESSAGE* pMessage = pool.Allocate();
+			pMessage->Reset();
+			pMessage->put(buffer.data() + offset, (int)(std::min)(buffer.size() - offset, (size_t)CHAIN_FRAGMENT_SIZE));
+			vecFragment.push_back(pMessage);
+		}
+
+		// the send completions
+		for (MESSAGE* pMessage : vecFragment)
+			pool.Free(pMessage);
+		vecFragment.clear();
+	});
+}
+
+// MessageChain::put straight into pooled fragments, Clear stands in for the send completions
+double MeasureChainBuild(ThreadLocalMemoryPool<MESSAGE>& pool, const std::vector<char>& piece, int payloadSize)
+{
+	return MeasureNsPerOp(GetBenchIterations(payloadSize), [&](long long) {
+		MessageChain chain([&pool]() { return pool.Allocate(); }, [&pool](MESSAGE* pMessage) { pool.Free(pMessage); });
+
+		for (int size = 0; size < payloadSize; size += CHAIN_APPEND_SIZE)
+			chain.put(piece.data(), CHAIN_APPEND_SIZE);
+
+		Consume(chain.GetFirst());
+	});
+}
+} // namespace
+
+// a large response built in 4KB appends, up to the point it is queued
+void RunChainBench()
+{
+	PrintGroup("chain");
+
+	ThreadLocalMemoryPool<MESSAGE> pool(64);
+	std::vector<char>			   piece(CHAIN_APPEND_SIZE, 'c');
+
+	const int payloadSizes[] = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+	for (int payloadSize : payloadSizes)
+	{
+		const std::string suffix = " " + std::to_string(payloadSize / 1024) + "KB";
+
+		PrintResult(("vector grow + split" + suffix).c_str(), MeasureVectorBuild(pool, piece, payloadSize, false), payloadSize);
+		PrintResult(("vector reserved + split" + suffix).c_str(), MeasureVectorBuild(pool, piece, payloadSize, true), payloadSize);
+		PrintResult(("MessageChain::put" + suffix).c_str(), MeasureChainBuild(pool, piece, payloadSize), payloadSize);
+	}
+}
@@ -0,0 +1,201 @@
+#include "Bench.h"
+#include "MemoryPool.h"
+#include "MessageFramer.h"
+#include "Protocol.h"
+#include "RingBuffer.h"
+#include "SystemPacket.h"
+#include "SystemPacketProcessor.h"
+#include "ThreadLocalMemoryPool.h"
+
+#include <climits>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr long long CORE_ITERATIONS = 2000000;
+constexpr int		POOL_BATCH = 16; // blocks held at once per thread, like a worker gathering a send
+
+// a stand in of MESSAGE's size, MESSAGE itself can only be built by its friends
+struct POOL_BLOCK
+{
+	char data[sizeof(MESSAGE)];
+};
+
+void BenchRingBuffer()
+{
+	const int chunkSizes[] = { 64, 512, 4096 };
+	for (int chunkSize : chunkSizes)
+	{
+		RingBuffer		  ring(RINGBUFFER_SIZE);
+		std::vector<char> chunk(chunkSize, 'r');
+		std::vector<char> out(chunkSize);
+
+		double nsPerOp = MeasureNsPerOp(CORE_ITERATIONS, [&](long long) {
+			ring.put(chunk.data(), chunkSize);
+			ring.peek(out.data(), chunkSize);
+			ring.move_tail(chunkSize);
+		});
+		Consume(out.data());
+
+		PrintResult(("RingBuffer put+peek+move_tail " + std::to_string(chunkSize) + "B").c_str(), nsPerOp, chunkSize);
+	}
+}
+
+void BenchPools()
+{
+	int threadCnt = 0;
+	for (int step = 0; (threadCnt = GetBenchThreadCount(step)) > 0; ++step)
+	{
+		MemoryPool<POOL_BLOCK> globalPool(POOL_BATCH * threadCnt);
+		auto				 globalBody = [&globalPool](int, long long iterations) {
+			POOL_BLOCK* blocks[POOL_BATCH];
+			for (long long i = 0; i < iterations; ++i)
+			{
+				for (POOL_BLOCK*& pBlock : blocks)
+					pBlock = globalPool.Allocate();
+				for (POOL_BLOCK* pBlock : blocks)
+					globalPool.Deallocate(pBlock);
+			}
+		};
+
+		ThreadLocalMemoryPool<POOL_BLOCK> localPool(POOL_BATCH * 4);
+		auto							localBody = [&localPool](int, long long iterations) {
+			POOL_BLOCK* blocks[POOL_BATCH];
+			for (long long i = 0; i < iterations; ++i)
+			{
+				for (POOL_BLOCK*& pBlock : blocks)
+					pBlock = localPool.Allocate();
+				for (POOL_BLOCK* pBlock : blocks)
+					localPool.Free(pBlock);
+			}
+		};
+
+		const double globalNs = MeasureThreadsNsPerOp(threadCnt, CORE_ITERATIONS / POOL_BATCH, globalBody);
+		const double localNs = MeasureThreadsNsPerOp(threadCnt, CORE_ITERATIONS / POOL_BATCH, localBody);
+
+		// per block, an allocate and a free
+		PrintResult(("MemoryPool alloc+free, " + std::to_string(threadCnt) + " threads").c_str(), globalNs / POOL_BATCH);
+		PrintResult(("ThreadLocalMemoryPool alloc+free, " + std::to_string(threadCnt) + " threads").c_str(), localNs / POOL_BATCH);
+	}
+}
+
+void BenchPut(ThreadLocalMemoryPool<MESSAGE>& pool)
+{
+	MESSAGE* pMessage = pool.Allocate();
+
+	const int pieceSizes[] = { 8, 64, 1024 };
+	for (int pieceSize : pieceSizes)
+	{
+		std::vector<char> piece(pieceSize, 'p');
+		const int		  piecesPerMessage = SHRT_MAX / pieceSize; // header.length is a short
+
+		pMessage->Reset();
+		int	   pieceCnt = 0;
+		double nsPerOp = MeasureNsPerOp(CORE_ITERATIONS, [&](long long) {
+			if (pieceCnt++ == piecesPerMessage)
+			{
+				pMessage->Reset();
+				pieceCnt = 1;
+			}
+			pMessage->put(piece.data(), pieceSize);
+		});
+		Consume(pMessage);
+
+		PrintResult(("MESSAGE::put " + std::to_string(pieceSize) + "B").c_str(), nsPerOp, pieceSize);
+	}
+
+	pool.Free(pMessage);
+}
+
+// the lookup and the call through std::function are what every system frame pays
+void BenchDispatch(ThreadLocalMemoryPool<MESSAGE>& pool)
+{
+	SystemPacketProcessor processor;
+	long long			  handledCnt = 0;
+	auto				  handler = [&handledCnt](SESSION*, SystemPacketHeader*) { ++handledCnt; };
+
+	processor.RegisterProcessor<SystemPacket_TestPacket>(handler);
+	processor.RegisterProcessor<SystemPacket_UdpBind>(handler);
+	processor.RegisterProcessor<SystemPacket_ShmOffer>(handler);
+	processor.RegisterProcessor<SystemPacket_ShmReady>(handler);
+	processor.RegisterProcessor<SystemPacket_ShmSwitch>(handler);
+	processor.RegisterProcessor<SystemPacket_IntegrityOffer>(handler);
+	processor.RegisterProcessor<SystemPacket_IntegrityReady>(handler);
+	processor.RegisterProcessor<SystemPacket_IntegritySwitch>(handler);
+	processor.RegisterProcessor<SystemPacket_CryptoOffer>(handler);
+	processor.RegisterProcessor<SystemPacket_CryptoReady>(handler);
+	processor.RegisterProcessor<SystemPacket_CryptoSwitch>(handler);
+
+	MESSAGE* pMessage = pool.Allocate();
+	pMessage->Reset();
+
+	SystemPacket_ShmSwitch packet;
+	pMessage->put(&packet, sizeof(packet));
+
+	// never dereferenced, the handlers ignore it
+	int		 sessionStandIn = 0;
+	SESSION* pSession = reinterpret_cast<SESSION*>(&sessionStandIn);
+
+	double nsPerOp = MeasureNsPerOp(CORE_ITERATIONS, [&](long long) { processor.RunProcessor(pSession, pMessage); });
+	Consume(handledCnt);
+
+	PrintResult("SystemPacketProcessor::RunProcessor", nsPerOp);
+
+	pool.Free(pMessage);
+}
+
+// the recv loop of both sides on a synthetic stream. only the framing is timed, not the refill
+void BenchFraming(ThreadLocalMemoryPool<MESSAGE>& pool)
+{
+	MESSAGE* pMessage = pool.Allocate();
+
+	const int payloadSizes[] = { 16, 256, 4096 };
+	for (int payloadSize : payloadSizes)
+	{
+		RingBuffer		  recvQ(RINGBUFFER_SIZE);
+		const int		  frameSize = (int)sizeof(HEADER) + payloadSize;
+		const int		  framesPerFill = (RINGBUFFER_SIZE - 1) / frameSize;
+		std::vector<char> frame(frameSize, 'f');
+
+		HEADER header;
+		header.type = PACKET_TYPE::USER;
+		header.length = (short)payloadSize;
+		std::memcpy(frame.data(), &header, sizeof(header));
+
+		BenchTimer timer;
+		long long  frameCnt = 0;
+		while (frameCnt < CORE_ITERATIONS)
+		{
+			for (int i = 0; i < framesPerFill; ++i)
+				recvQ.put(frame.data(), frameSize);
+
+			timer.Start();
+			while (PeekFrame(recvQ, header) == FRAME_STATUS::READY)
+			{
+				PopFrame(recvQ, header, pMessage);
+				++frameCnt;
+			}
+			timer.Stop();
+		}
+		Consume(pMessage);
+
+		PrintResult(("PeekFrame+PopFrame " + std::to_string(payloadSize) + "B payload").c_str(), timer.GetSeconds() * 1e9 / frameCnt, frameSize);
+	}
+
+	pool.Free(pMessage);
+}
+} // namespace
+
+void RunCoreBench()
+{
+	PrintGroup("core");
+
+	ThreadLocalMemoryPool<MESSAGE> messagePool(16);
+
+	BenchRingBuffer();
+	BenchPools();
+	BenchPut(messagePool);
+	BenchDispatch(messagePool);
+	BenchFraming(messagePool);
+}
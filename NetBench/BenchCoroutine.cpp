@@ -0,0 +1,126 @@
+#include "Bench.h"
+#include "Coroutine.h"
+#include "ThreadLocalMemoryPool.h"
+
+namespace
+{
+constexpr long long CORO_REQUESTS = 2000000; // requests handled per measurement
+constexpr int		CORO_REQUEST_SIZE = 32;
+constexpr size_t	CORO_FRAME_SIZE = 256; // about what a session handler's frame takes
+
+void HandleRequest(ThreadLocalMemoryPool<MESSAGE>& pool, MESSAGE* pRequest)
+{
+	MESSAGE* pReply = pool.Allocate();
+	pReply->Reset();
+	pReply->put(pRequest->GetPayload(), pRequest->GetPayloadSize());
+	Consume(pReply);
+
+	pool.Free(pReply);
+	pool.Free(pRequest);
+}
+
+// what NetServer calls for every frame
+class RecvHandler
+{
+public:
+	virtual ~RecvHandler() = default;
+	virtual void OnRecv(MESSAGE* pMessage) = 0;
+};
+
+class CallbackHandler : public RecvHandler
+{
+public:
+	explicit CallbackHandler(ThreadLocalMemoryPool<MESSAGE>& pool) : m_Pool(pool) {}
+
+	void OnRecv(MESSAGE* pMessage) { HandleRequest(m_Pool, pMessage); }
+
+private:
+	ThreadLocalMemoryPool<MESSAGE>& m_Pool;
+};
+
+// CoNetServer's handler loop, resumed by MessageInbox::Deliver on the delivering thread
+NetTask RecvLoop(MessageInbox& inbox, ThreadLocalMemoryPool<MESSAGE>& pool)
+{
+	while (MESSAGE* pMessage = co_await inbox.Recv())
+		HandleRequest(pool, pMessage);
+}
+
+// the same, with every request handed to a sub flow, one pooled frame per request
+CoTask HandleRequestTask(ThreadLocalMemoryPool<MESSAGE>& pool, MESSAGE* pMessage)
+{
+	HandleRequest(pool, pMessage);
+	co_return;
+}
+
+NetTask SubFlowLoop(MessageInbox& inbox, ThreadLocalMemoryPool<MESSAGE>& pool)
+{
+	while (MESSAGE* pMessage = co_await inbox.Recv())
+		co_await HandleRequestTask(pool, pMessage);
+}
+
+MESSAGE* MakeRequest(ThreadLocalMemoryPool<MESSAGE>& pool, const char* pPayload)
+{
+	MESSAGE* pMessage = pool.Allocate();
+	pMessage->Reset();
+	pMessage->put(pPayload, CORO_REQUEST_SIZE);
+	return pMessage;
+}
+
+// through a pointer the compiler can't see through, like NetServer's call of its subclass
+RecvHandler* volatile g_pHandler;
+
+double MeasureCallback(ThreadLocalMemoryPool<MESSAGE>& pool, const char* pPayload)
+{
+	CallbackHandler handler(pool);
+	g_pHandler = &handler;
+
+	return MeasureNsPerOp(CORO_REQUESTS, [&](long long) { g_pHandler->OnRecv(MakeRequest(pool, pPayload)); });
+}
+
+template <typename LOOP>
+double MeasureCoroutine(ThreadLocalMemoryPool<MESSAGE>& pool, const char* pPayload, LOOP loop)
+{
+	MessageInbox inbox;
+	loop(inbox, pool);
+
+	double nsPerOp = MeasureNsPerOp(CORO_REQUESTS, [&](long long) { inbox.Deliver(MakeRequest(pool, pPayload)); });
+
+	// the handler returns, its frame goes back to the pool
+	inbox.Close();
+	return nsPerOp;
+}
+} // namespace
+
+// one thread delivers, as one worker does for the sessions whose recvs it completes
+void RunCoroutineBench()
+{
+	PrintGroup("coroutine");
+
+	ThreadLocalMemoryPool<MESSAGE> pool(64);
+	char						   payload[CORO_REQUEST_SIZE] = {};
+
+	const double callbackNs = MeasureCallback(pool, payload);
+	const double coroutineNs = MeasureCoroutine(pool, payload, RecvLoop);
+	const double subFlowNs = MeasureCoroutine(pool, payload, SubFlowLoop);
+
+	PrintResult("request, virtual OnRecv", callbackNs);
+	PrintResult("request, co_await Recv", coroutineNs);
+	PrintResult("request, co_await Recv + CoTask", subFlowNs);
+	PrintOverhead("co_await Recv over OnRecv", callbackNs, coroutineNs);
+	PrintOverhead("co_await Recv + CoTask over OnRecv", callbackNs, subFlowNs);
+
+	const double poolNs = MeasureNsPerOp(CORO_REQUESTS, [](long long) {
+		void* pFrame = CoroutineFramePool::Allocate(CORO_FRAME_SIZE);
+		Consume(pFrame);
+		CoroutineFramePool::Free(pFrame, CORO_FRAME_SIZE);
+	});
+
+	const double heapNs = MeasureNsPerOp(CORO_REQUESTS, [](long long) {
+		void* pFrame = ::operator new(CORO_FRAME_SIZE);
+		Consume(pFrame);
+		::operator delete(pFrame);
+	});
+
+	PrintResult("frame, CoroutineFramePool 256B", poolNs);
+	PrintResult("frame, operator new 256B", heapNs);
+}
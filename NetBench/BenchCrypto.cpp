@@ -0,0 +1,53 @@
+#include "Bench.h"
+#include "BenchEcho.h"
+#include "ChaCha20Poly1305.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+void BenchSeal()
+{
+	unsigned char key[CHACHA20_KEY_SIZE];
+	std::memset(key, 0x24, sizeof(key));
+
+	const int sizes[] = { 64, 1024, 16384 };
+	for (int size : sizes)
+	{
+		std::vector<unsigned char> data(size, 's');
+		unsigned char			   tag[POLY1305_TAG_SIZE];
+		HEADER					   header = { PACKET_TYPE::USER, (short)size };
+
+		double nsPerOp = MeasureNsPerOp(GetBenchIterations(size), [&](long long i) {
+			ChaCha20Poly1305Seal(key, (unsigned long long)i, &header, sizeof(header), data.data(), size, tag);
+		});
+		Consume(tag);
+
+		PrintResult(("ChaCha20Poly1305Seal " + std::to_string(size) + "B").c_str(), nsPerOp, size);
+	}
+}
+} // namespace
+
+// no sockets, so the overhead is an upper bound
+void RunCryptoBench()
+{
+	PrintGroup("crypto");
+
+	BenchSeal();
+
+	ThreadLocalMemoryPool<MESSAGE> messagePool(16);
+
+	const int payloadSizes[] = { 64, 1024, 8192, 32000 };
+	for (int payloadSize : payloadSizes)
+	{
+		const std::string suffix = " " + std::to_string(payloadSize) + "B";
+
+		const double plainNs = MeasureEchoFrame(messagePool, payloadSize, ECHO_SEAL::PLAIN);
+		const double encryptNs = MeasureEchoFrame(messagePool, payloadSize, ECHO_SEAL::ENCRYPT);
+
+		PrintResult(("echo frame, plain" + suffix).c_str(), plainNs, payloadSize);
+		PrintResult(("echo frame, encrypted" + suffix).c_str(), encryptNs, payloadSize);
+		PrintOverhead(("encryption overhead" + suffix).c_str(), plainNs, encryptNs);
+	}
+}
@@ -0,0 +1,85 @@
+#include "BenchEcho.h"
+#include "Bench.h"
+#include "MessageFramer.h"
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+constexpr long long BENCH_BYTES = 256LL * 1024 * 1024;
+
+bool Open(MESSAGE* pMessage, ECHO_SEAL seal, AEAD_STATE& state)
+{
+	if (seal == ECHO_SEAL::INTEGRITY)
+		return pMessage->CheckIntegrity();
+	if (seal == ECHO_SEAL::ENCRYPT)
+		return pMessage->Decrypt(state);
+
+	return true;
+}
+
+void Seal(MESSAGE* pMessage, ECHO_SEAL seal, AEAD_STATE& state)
+{
+	if (seal == ECHO_SEAL::INTEGRITY)
+		pMessage->SealIntegrity();
+	else if (seal == ECHO_SEAL::ENCRYPT)
+		pMessage->Encrypt(state);
+}
+} // namespace
+
+double MeasureEchoFrame(ThreadLocalMemoryPool<MESSAGE>& pool, int payloadSize, ECHO_SEAL seal)
+{
+	MESSAGE* pRecv = pool.Allocate();
+	MESSAGE* pSend = pool.Allocate();
+
+	AEAD_STATE state;
+	std::memset(state.key, 0x42, sizeof(state.key));
+	state.counter = 0;
+
+	// every recv opens the same frame, the decrypt side rewinds its counter
+	pSend->Reset();
+	std::vector<char> payload(payloadSize, 'e');
+	pSend->put(payload.data(), payloadSize);
+	Seal(pSend, seal, state);
+
+	const int		  frameSize = (int)sizeof(HEADER) + (unsigned short)pSend->GetPayloadSize();
+	std::vector<char> frame(frameSize);
+	std::memcpy(frame.data(), pSend, frameSize);
+
+	AEAD_STATE recvState = state;
+	recvState.counter = 0;
+
+	RingBuffer recvQ(RINGBUFFER_SIZE);
+	HEADER	   header;
+	long long  openedCnt = 0;
+
+	double nsPerOp = MeasureNsPerOp(GetBenchIterations(payloadSize), [&](long long) {
+		recvQ.put(frame.data(), frameSize);
+		if (PeekFrame(recvQ, header) != FRAME_STATUS::READY)
+			return;
+
+		PopFrame(recvQ, header, pRecv);
+
+		recvState.counter = 0;
+		if (!Open(pRecv, seal, recvState))
+			return;
+
+		++openedCnt;
+		pSend->Reset();
+		pSend->put(pRecv->GetPayload(), pRecv->GetPayloadSize());
+		Seal(pSend, seal, state);
+	});
+	Consume(pSend);
+	Consume(openedCnt);
+
+	pool.Free(pSend);
+	pool.Free(pRecv);
+	return nsPerOp;
+}
+
+long long GetBenchIterations(int bytesPerOp)
+{
+	return (std::max)(BENCH_BYTES / bytesPerOp, 10000LL);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "Protocol.h"
+#include "ThreadLocalMemoryPool.h"
+
+enum class ECHO_SEAL
+{
+	PLAIN,
+	INTEGRITY, // CheckIntegrity in, SealIntegrity out
+	ENCRYPT	   // Decrypt in, Encrypt out
+};
+
+// an echo server's per frame work without the socket calls
+double MeasureEchoFrame(ThreadLocalMemoryPool<MESSAGE>& pool, int payloadSize, ECHO_SEAL seal);
+
+// enough iterations to push a fixed volume through, so large sizes don't run for minutes
+long long GetBenchIterations(int bytesPerOp);
@@ -0,0 +1,157 @@
+#include "Bench.h"
+#include "GlobalValue.h"
+#include "MessageFramer.h"
+#include "ThreadLocalMemoryPool.h"
+#include "TokenBucket.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr int FAIRNESS_ROUNDS = 300;
+constexpr int FAIRNESS_GOOD_SESSIONS = 32;
+constexpr int FAIRNESS_PAYLOAD_SIZE = 16;
+
+struct FAIR_SESSION
+{
+	FAIR_SESSION()
+	: recvQ(RINGBUFFER_SIZE)
+	{
+	}
+
+	RingBuffer recvQ;
+	bool	   good;
+};
+
+void FillFrames(FAIR_SESSION& session, int frameCnt)
+{
+	char frame[sizeof(HEADER) + FAIRNESS_PAYLOAD_SIZE] = {};
+
+	HEADER header;
+	header.type = PACKET_TYPE::USER;
+	header.length = FAIRNESS_PAYLOAD_SIZE;
+	std::memcpy(frame, &header, sizeof(header));
+
+	for (int i = 0; i < frameCnt; ++i)
+		session.recvQ.put(frame, sizeof(frame));
+}
+
+// AfterRecvProcess's loop on one worker, the flooder queued first. each good frame's wait in ns
+std::vector<double> RunRounds(ThreadLocalMemoryPool<MESSAGE>& pool, int recvBudget)
+{
+	std::vector<std::unique_ptr<FAIR_SESSION>> vecSession;
+	for (int i = 0; i <= FAIRNESS_GOOD_SESSIONS; ++i)
+	{
+		vecSession.emplace_back(new FAIR_SESSION());
+		vecSession.back()->good = i > 0;
+	}
+
+	const int floodFrameCnt = (RINGBUFFER_SIZE - 1) / (int)(sizeof(HEADER) + FAIRNESS_PAYLOAD_SIZE);
+
+	MESSAGE*			pMessage = pool.Allocate();
+	std::vector<double> vecWaitNs;
+	LARGE_INTEGER		frequency;
+	QueryPerformanceFrequency(&frequency);
+
+	for (int round = 0; round < FAIRNESS_ROUNDS; ++round)
+	{
+		std::deque<FAIR_SESSION*> completions;
+		for (auto& pSession : vecSession)
+		{
+			FillFrames(*pSession, pSession->good ? 1 : floodFrameCnt);
+			completions.push_back(pSession.get());
+		}
+
+		LARGE_INTEGER roundBegin;
+		QueryPerformanceCounter(&roundBegin);
+
+		while (!completions.empty())
+		{
+			FAIR_SESSION* pSession = completions.front();
+			completions.pop_front();
+
+			int	   framedCount = 0;
+			HEADER header;
+			while (PeekFrame(pSession->recvQ, header) == FRAME_STATUS::READY)
+			{
+				if (recvBudget > 0 && framedCount++ >= recvBudget)
+				{
+					completions.push_back(pSession);
+					break;
+				}
+
+				PopFrame(pSession->recvQ, header, pMessage);
+				Consume(pMessage);
+
+				if (pSession->good)
+				{
+					LARGE_INTEGER now;
+					QueryPerformanceCounter(&now);
+					vecWaitNs.push_back((double)(now.QuadPart - roundBegin.QuadPart) * 1e9 / frequency.QuadPart);
+				}
+			}
+		}
+	}
+
+	pool.Free(pMessage);
+	return vecWaitNs;
+}
+
+double GetPercentile(std::vector<double>& vecValue, double percentile)
+{
+	std::sort(vecValue.begin(), vecValue.end());
+	const size_t index = (std::min)((size_t)(vecValue.size() * percentile / 100), vecValue.size() - 1);
+	return vecValue[index];
+}
+
+void BenchTailLatency()
+{
+	ThreadLocalMemoryPool<MESSAGE> messagePool(16);
+
+	const int budgets[] = { 0, RECV_BUDGET };
+	for (int budget : budgets)
+	{
+		std::vector<double> vecWaitNs = RunRounds(messagePool, budget);
+
+		const std::string suffix = budget > 0 ? ", budget " + std::to_string(budget) : ", no budget";
+		PrintResult(("good session wait p50" + suffix).c_str(), GetPercentile(vecWaitNs, 50));
+		PrintResult(("good session wait p99" + suffix).c_str(), GetPercentile(vecWaitNs, 99));
+	}
+}
+
+// what AdmitFrame adds to every frame once limits are on, both buckets checked and charged
+void BenchTokenBucket()
+{
+	TokenBucket messageBucket;
+	TokenBucket byteBucket;
+	messageBucket.Reset(1 << 30, 0, 0);
+	byteBucket.Reset(1 << 30, 0, 0);
+
+	long long admittedCnt = 0;
+	double	  nsPerOp = MeasureNsPerOp(20000000, [&](long long i) {
+		const ULONGLONG now = (ULONGLONG)(i >> 10);
+		if ((std::max)(messageBucket.GetWait(1, now), byteBucket.GetWait(FAIRNESS_PAYLOAD_SIZE, now)) != 0)
+			return;
+
+		messageBucket.Take(1);
+		byteBucket.Take(FAIRNESS_PAYLOAD_SIZE);
+		++admittedCnt;
+	});
+	Consume(admittedCnt);
+
+	PrintResult("TokenBucket check+take, two buckets", nsPerOp);
+}
+} // namespace
+
+// one flooding session with a full recvQ of small frames against sessions with one frame each
+void RunFairnessBench()
+{
+	PrintGroup("fairness");
+
+	BenchTailLatency();
+	BenchTokenBucket();
+}
@@ -0,0 +1,46 @@
+#include "Bench.h"
+#include "BenchEcho.h"
+#include "Crc32c.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+void BenchCrc()
+{
+	const int sizes[] = { 64, 1024, 16384 };
+	for (int size : sizes)
+	{
+		std::vector<char> data(size, 'c');
+		unsigned int	  crc = 0;
+
+		double nsPerOp = MeasureNsPerOp(GetBenchIterations(size), [&](long long) { crc += ComputeCrc32c(data.data(), size); });
+		Consume((long long)crc);
+
+		PrintResult(("ComputeCrc32c " + std::to_string(size) + "B").c_str(), nsPerOp, size);
+	}
+}
+} // namespace
+
+void RunIntegrityBench()
+{
+	PrintGroup(IsCrc32cHardwareAccelerated() ? "integrity, crc32c in hardware" : "integrity, crc32c by table");
+
+	BenchCrc();
+
+	ThreadLocalMemoryPool<MESSAGE> messagePool(16);
+
+	const int payloadSizes[] = { 64, 1024, 8192, 32000 };
+	for (int payloadSize : payloadSizes)
+	{
+		const std::string suffix = " " + std::to_string(payloadSize) + "B";
+
+		const double plainNs = MeasureEchoFrame(messagePool, payloadSize, ECHO_SEAL::PLAIN);
+		const double integrityNs = MeasureEchoFrame(messagePool, payloadSize, ECHO_SEAL::INTEGRITY);
+
+		PrintResult(("echo frame, plain" + suffix).c_str(), plainNs, payloadSize);
+		PrintResult(("echo frame, integrity" + suffix).c_str(), integrityNs, payloadSize);
+		PrintOverhead(("integrity overhead" + suffix).c_str(), plainNs, integrityNs);
+	}
+}
@@ -0,0 +1,105 @@
+#include "Bench.h"
+#include "GlobalValue.h"
+
+#include <atomic>
+#include <string>
+
+namespace
+{
+constexpr long long LAYOUT_ITERATIONS = 20000000;
+constexpr int		SCAN_SESSION_COUNT = 16384;
+constexpr int		SCAN_READY_EVERY = 64; // one session in 64 has something queued
+constexpr int		SESSION_STAND_IN_SIZE = 8 * CACHE_LINE_SIZE; // SESSION's control and queue lines, recvQ aside
+
+// the refcount, recv and send state on one line, as before the split
+struct alignas(CACHE_LINE_SIZE) PACKED_STATE
+{
+	std::atomic<long long> refCount;
+	std::atomic<long long> recvState;
+	std::atomic<long long> sendState;
+};
+
+struct SPLIT_STATE
+{
+	alignas(CACHE_LINE_SIZE) std::atomic<long long> refCount;
+	alignas(CACHE_LINE_SIZE) std::atomic<long long> recvState;
+	alignas(CACHE_LINE_SIZE) std::atomic<long long> sendState;
+};
+
+// no data is shared between the threads, only the line
+template <typename STATE>
+double MeasureWriters(STATE& state)
+{
+	return MeasureThreadsNsPerOp(3, LAYOUT_ITERATIONS, [&state](int threadIndex, long long iterations) {
+		if (threadIndex == 0)
+		{
+			for (long long i = 0; i < iterations; ++i)
+			{
+				state.refCount.fetch_add(1);
+				state.refCount.fetch_sub(1);
+			}
+			return;
+		}
+
+		std::atomic<long long>& own = threadIndex == 1 ? state.recvState : state.sendState;
+		for (long long i = 0; i < iterations; ++i)
+			own.store(own.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	});
+}
+
+struct SESSION_STAND_IN
+{
+	alignas(CACHE_LINE_SIZE) std::atomic<char> sendReady;
+	char rest[SESSION_STAND_IN_SIZE - 1];
+};
+
+// static, so the alignment holds without an aligned new
+PACKED_STATE	  g_PackedState;
+SPLIT_STATE		  g_SplitState;
+SESSION_STAND_IN  g_Sessions[SCAN_SESSION_COUNT];
+std::atomic<char> g_SendReady[SCAN_SESSION_COUNT];
+
+void BenchFalseSharing()
+{
+	PrintResult("refcount+recv+send writers, one line", MeasureWriters(g_PackedState));
+	PrintResult("refcount+recv+send writers, own lines", MeasureWriters(g_SplitState));
+}
+
+// ns per session scanned
+void BenchSendScan()
+{
+	for (int idx = 0; idx < SCAN_SESSION_COUNT; ++idx)
+	{
+		const char ready = idx % SCAN_READY_EVERY == 0 ? 1 : 0;
+		g_Sessions[idx].sendReady = ready;
+		g_SendReady[idx] = ready;
+	}
+
+	const long long passCnt = LAYOUT_ITERATIONS / SCAN_SESSION_COUNT;
+	long long		readyCnt = 0;
+
+	double stridedNs = MeasureNsPerOp(passCnt, [&](long long) {
+		for (int idx = 0; idx < SCAN_SESSION_COUNT; ++idx)
+			readyCnt += g_Sessions[idx].sendReady.load(std::memory_order_relaxed);
+	});
+
+	double compactNs = MeasureNsPerOp(passCnt, [&](long long) {
+		for (int idx = 0; idx < SCAN_SESSION_COUNT; ++idx)
+			readyCnt += g_SendReady[idx].load(std::memory_order_relaxed);
+	});
+	Consume(readyCnt);
+
+	const std::string suffix = ", " + std::to_string(SCAN_SESSION_COUNT) + " sessions";
+	PrintResult(("send scan, flag in session" + suffix).c_str(), stridedNs / SCAN_SESSION_COUNT);
+	PrintResult(("send scan, compact flags" + suffix).c_str(), compactNs / SCAN_SESSION_COUNT);
+}
+} // namespace
+
+// false sharing only shows with the writers on different cores, on one core both layouts match
+void RunLayoutBench()
+{
+	PrintGroup("layout");
+
+	BenchFalseSharing();
+	BenchSendScan();
+}
@@ -0,0 +1,241 @@
+#include "NetServer.h"
+#include "Bench.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr int	LOOPBACK_BENCH_SECONDS = 10;
+constexpr int	LOOPBACK_BENCH_CONNECTIONS = 64;
+constexpr int	LOOPBACK_BENCH_WORKERS = 4;
+constexpr int	LOOPBACK_BENCH_PAYLOAD = 64;
+constexpr int	LOOPBACK_BENCH_DEPTH = 8;
+constexpr int	LOOPBACK_BENCH_RECV_SIZE = 64 * 1024;
+constexpr int	LOOPBACK_BENCH_CLIENT_THREADS = 2;
+constexpr DWORD LOOPBACK_BENCH_WARMUP_MS = 1000;
+
+class EchoServer : public NetServer
+{
+private:
+	bool OnConnectionRequest(char* pClientIP, short port) { return true; }
+	void OnClientJoin(SESSION_UID sessionUID) {}
+	void OnClientLeave(SESSION_UID sessionUID) {}
+
+	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
+	{
+		Send(sessionUID, pMessage);
+	}
+};
+
+// one send and one recv in flight, like the engine's own sessions
+struct BENCH_CONNECTION
+{
+	LoopbackPipe* pPipe;
+	OVERLAPPED	  recvOverlapped;
+	OVERLAPPED	  sendOverlapped;
+	char		  recvBuffer[LOOPBACK_BENCH_RECV_SIZE];
+	int			  recvSize;	 // bytes buffered from the start of recvBuffer
+	int			  resendCnt; // echoes back that haven't been sent out again yet
+	bool		  sending;
+};
+
+class BenchClient
+{
+public:
+	BenchClient(LoopbackNetwork& network, int connectionCnt, int payloadSize, int depth, std::atomic<long long>& echoCnt)
+	: m_Network(network)
+	, m_ConnectionCnt(connectionCnt)
+	, m_FrameSize((int)sizeof(HEADER) + payloadSize)
+	, m_Depth(depth)
+	, m_EchoCnt(echoCnt)
+	{
+		m_vecFrames.resize((size_t)m_FrameSize * depth, 'l');
+
+		HEADER header;
+		header.type = PACKET_TYPE::USER;
+		header.length = (short)payloadSize;
+		for (int i = 0; i < depth; ++i)
+			std::memcpy(m_vecFrames.data() + (size_t)m_FrameSize * i, &header, sizeof(header));
+	}
+
+	void Run(const std::atomic<bool>& stop)
+	{
+		HANDLE hIocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, 1);
+		if (hIocp == NULL)
+			return;
+
+		std::vector<BENCH_CONNECTION*> vecConnection;
+		for (int i = 0; i < m_ConnectionCnt; ++i)
+		{
+			BENCH_CONNECTION* pConnection = new BENCH_CONNECTION;
+			pConnection->pPipe = m_Network.Connect();
+			if (pConnection->pPipe == nullptr)
+			{
+				delete pConnection;
+				break;
+			}
+
+			pConnection->pPipe->Attach(hIocp, (ULONG_PTR)pConnection);
+			pConnection->recvSize = 0;
+			pConnection->resendCnt = m_Depth;
+			pConnection->sending = false;
+
+			PostRecv(pConnection);
+			PostSend(pConnection);
+			vecConnection.push_back(pConnection);
+		}
+
+		while (!stop)
+		{
+			DWORD		 bytes = 0;
+			ULONG_PTR	 key = 0;
+			OVERLAPPED* pOverlapped = nullptr;
+			if (!GetQueuedCompletionStatus(hIocp, &bytes, &key, &pOverlapped, 100) && pOverlapped == nullptr)
+				continue;
+
+			BENCH_CONNECTION* pConnection = (BENCH_CONNECTION*)key;
+			if (pOverlapped == &pConnection->sendOverlapped)
+			{
+				pConnection->sending = false;
+				PostSend(pConnection);
+				continue;
+			}
+
+			// a closed stream, the server let go of the session
+			if (bytes == 0)
+				continue;
+
+			pConnection->recvSize += bytes;
+			pConnection->resendCnt += TakeEchoes(pConnection);
+			PostRecv(pConnection);
+			PostSend(pConnection);
+		}
+	}
+
+private:
+	void PostRecv(BENCH_CONNECTION* pConnection)
+	{
+		ZeroMemory(&pConnection->recvOverlapped, sizeof(pConnection->recvOverlapped));
+
+		WSABUF buf;
+		buf.buf = pConnection->recvBuffer + pConnection->recvSize;
+		buf.len = LOOPBACK_BENCH_RECV_SIZE - pConnection->recvSize;
+		pConnection->pPipe->Recv(&buf, 1, &pConnection->recvOverlapped);
+	}
+
+	void PostSend(BENCH_CONNECTION* pConnection)
+	{
+		if (pConnection->sending || pConnection->resendCnt == 0)
+			return;
+
+		const int frameCnt = (std::min)(pConnection->resendCnt, m_Depth);
+		pConnection->resendCnt -= frameCnt;
+		pConnection->sending = true;
+
+		ZeroMemory(&pConnection->sendOverlapped, sizeof(pConnection->sendOverlapped));
+
+		WSABUF buf;
+		buf.buf = m_vecFrames.data();
+		buf.len = (ULONG)(m_FrameSize * frameCnt);
+		if (pConnection->pPipe->Send(&buf, 1, &pConnection->sendOverlapped) != 0)
+			pConnection->sending = false;
+	}
+
+	// system frames aren't echoes
+	int TakeEchoes(BENCH_CONNECTION* pConnection)
+	{
+		int echoCnt = 0;
+		int offset = 0;
+		while (pConnection->recvSize - offset >= (int)sizeof(HEADER))
+		{
+			HEADER header;
+			std::memcpy(&header, pConnection->recvBuffer + offset, sizeof(header));
+
+			const int frameSize = (int)sizeof(header) + (unsigned short)header.length;
+			if (pConnection->recvSize - offset < frameSize)
+				break;
+
+			if (header.type == PACKET_TYPE::USER)
+				++echoCnt;
+
+			offset += frameSize;
+		}
+
+		std::memmove(pConnection->recvBuffer, pConnection->recvBuffer + offset, pConnection->recvSize - offset);
+		pConnection->recvSize -= offset;
+
+		m_EchoCnt += echoCnt;
+		return echoCnt;
+	}
+
+private:
+	LoopbackNetwork&		m_Network;
+	int						m_ConnectionCnt;
+	int						m_FrameSize;
+	int						m_Depth;
+	std::vector<char>		m_vecFrames; // depth frames back to back, every send takes a prefix
+	std::atomic<long long>& m_EchoCnt;
+};
+
+} // namespace
+
+// echo throughput over a LoopbackNetwork, no kernel socket is touched
+void RunLoopbackBench()
+{
+	PrintGroup("loopback");
+
+	const int connectionCnt = LOOPBACK_BENCH_CONNECTIONS;
+	const int workerThreadCnt = LOOPBACK_BENCH_WORKERS;
+	const int payloadSize = LOOPBACK_BENCH_PAYLOAD;
+	const int depth = LOOPBACK_BENCH_DEPTH;
+
+	// NetServer can't be stopped, the server and network are left until the process exits
+	LoopbackNetwork* pNetwork = new LoopbackNetwork;
+	EchoServer*		 pServer = new EchoServer;
+	if (!pServer->StartLoopback(pNetwork, workerThreadCnt, connectionCnt))
+	{
+		std::cout << "  loopback : server start fail" << std::endl;
+		return;
+	}
+
+	std::atomic<bool>	   stop{ false };
+	std::atomic<long long> echoCnt{ 0 };
+
+	const int clientThreadCnt = (std::min)(LOOPBACK_BENCH_CLIENT_THREADS, connectionCnt);
+
+	std::vector<std::unique_ptr<BenchClient>> vecClient;
+	std::vector<std::thread>				  vecThread;
+	for (int i = 0; i < clientThreadCnt; ++i)
+	{
+		const int share = connectionCnt / clientThreadCnt + (i < connectionCnt % clientThreadCnt ? 1 : 0);
+		vecClient.emplace_back(new BenchClient(*pNetwork, share, payloadSize, depth, echoCnt));
+
+		BenchClient* pClient = vecClient.back().get();
+		vecThread.emplace_back([pClient, &stop]() { pClient->Run(stop); });
+	}
+
+	Sleep(LOOPBACK_BENCH_WARMUP_MS);
+
+	LARGE_INTEGER frequency, begin, end;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&begin);
+	const ULONGLONG cpuBegin = GetProcessCpuTime();
+	const long long echoBegin = echoCnt;
+
+	Sleep(LOOPBACK_BENCH_SECONDS * 1000);
+
+	QueryPerformanceCounter(&end);
+	const ULONGLONG cpuEnd = GetProcessCpuTime();
+	const long long echoes = echoCnt - echoBegin;
+
+	stop = true;
+	for (std::thread& thread : vecThread)
+		thread.join();
+
+	const double elapsed = (double)(end.QuadPart - begin.QuadPart) / frequency.QuadPart;
+	const double echoesPerSecond = echoes / elapsed;
+
+	std::cout << "  " << connectionCnt << " connections, " << workerThreadCnt << " workers, " << payloadSize << "B payload, depth " << depth << " : "
+			  << (long long)echoesPerSecond << " echoes/s, " << (long long)(echoesPerSecond / workerThreadCnt) << " per worker" << std::endl;
+	PrintResult("cpu per echo, clients included", echoes > 0 ? (double)(cpuEnd - cpuBegin) * 100 / echoes : 0);
+}
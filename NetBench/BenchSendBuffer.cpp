@@ -0,0 +1,204 @@
+#include "NetServer.h"
+#include "Bench.h"
+
+#include <climits>
+
+namespace
+{
+constexpr short SNDBUF_BENCH_PORT = 27933;
+constexpr int	SNDBUF_BENCH_SECONDS = 5; // per phase
+constexpr int	SNDBUF_BENCH_CONNECTIONS = 4;
+constexpr int	SNDBUF_BENCH_BURST = 16;	// frames answered per request
+constexpr int	SNDBUF_BENCH_REQUESTS = 2;	// requests a client keeps in flight
+constexpr int	SNDBUF_BENCH_RECV_SIZE = 256 * 1024;
+constexpr DWORD SNDBUF_BENCH_WARMUP_MS = 500;
+
+// every frame a client sends is a request for a burst of payloadSize frames
+class BurstServer : public NetServer
+{
+public:
+	BurstServer()
+	: m_PayloadSize(0)
+	, m_vecPayload(MAX_PAYLOAD_SIZE, 's')
+	{
+	}
+
+	void SetPayloadSize(int payloadSize) { m_PayloadSize = payloadSize; }
+
+private:
+	bool OnConnectionRequest(char* pClientIP, short port) { return true; }
+	void OnClientJoin(SESSION_UID sessionUID) {}
+	void OnClientLeave(SESSION_UID sessionUID) {}
+
+	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
+	{
+		FreeMessage(pMessage);
+
+		const int payloadSize = m_PayloadSize;
+		for (int i = 0; i < SNDBUF_BENCH_BURST; ++i)
+		{
+			MESSAGE* pReply = AllocateMessage();
+			if (pReply == nullptr)
+				return;
+
+			pReply->put(m_vecPayload.data(), payloadSize);
+			Send(sessionUID, pReply);
+		}
+	}
+
+private:
+	std::atomic<int>  m_PayloadSize;
+	std::vector<char> m_vecPayload;
+};
+
+void SendRequest(SOCKET clientSocket)
+{
+	HEADER header;
+	header.type = PACKET_TYPE::USER;
+	header.length = 0;
+	send(clientSocket, (const char*)&header, sizeof(header), 0);
+}
+
+void ClientLoop(short port, const std::atomic<bool>& stop, std::atomic<long long>& recvBytes)
+{
+	SOCKET clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (clientSocket == INVALID_SOCKET)
+		return;
+
+	SOCKADDR_IN serverAddr;
+	ZeroMemory(&serverAddr, sizeof(serverAddr));
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons(port);
+	InetPtonA(AF_INET, "127.0.0.1", &serverAddr.sin_addr);
+
+	if (connect(clientSocket, (SOCKADDR*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+	{
+		closesocket(clientSocket);
+		return;
+	}
+
+	DWORD recvTimeout = 100;
+	setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&recvTimeout, sizeof(recvTimeout));
+
+	for (int i = 0; i < SNDBUF_BENCH_REQUESTS; ++i)
+		SendRequest(clientSocket);
+
+	std::vector<char> recvBuffer(SNDBUF_BENCH_RECV_SIZE);
+	int				  recvSize = 0;
+	int				  frameCnt = 0;
+	while (!stop)
+	{
+		int received = recv(clientSocket, recvBuffer.data() + recvSize, SNDBUF_BENCH_RECV_SIZE - recvSize, 0);
+		if (received == 0)
+			break;
+		if (received == SOCKET_ERROR)
+		{
+			if (WSAGetLastError() == WSAETIMEDOUT)
+				continue;
+			break;
+		}
+
+		recvSize += received;
+
+		int offset = 0;
+		while (recvSize - offset >= (int)sizeof(HEADER))
+		{
+			HEADER header;
+			std::memcpy(&header, recvBuffer.data() + offset, sizeof(header));
+
+			const int frameSize = (int)sizeof(header) + (unsigned short)header.length;
+			if (recvSize - offset < frameSize)
+				break;
+
+			if (header.type == PACKET_TYPE::USER)
+			{
+				recvBytes += (unsigned short)header.length;
+				if (++frameCnt == SNDBUF_BENCH_BURST)
+				{
+					frameCnt = 0;
+					SendRequest(clientSocket);
+				}
+			}
+
+			offset += frameSize;
+		}
+
+		std::memmove(recvBuffer.data(), recvBuffer.data() + offset, recvSize - offset);
+		recvSize -= offset;
+	}
+
+	closesocket(clientSocket);
+}
+
+// false when nothing arrived, the clients lost their connections
+bool MeasurePhase(BurstServer& server, const char* mode, int payloadSize, int seconds, const std::atomic<long long>& recvBytes)
+{
+	server.SetPayloadSize(payloadSize);
+	Sleep(SNDBUF_BENCH_WARMUP_MS);
+
+	LARGE_INTEGER frequency, begin, end;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&begin);
+	const ULONGLONG			 cpuBegin = GetProcessCpuTime();
+	const long long			 bytesBegin = recvBytes;
+	const unsigned long long zeroCopyBegin = server.GetZeroCopySendBytes();
+
+	Sleep(seconds * 1000);
+
+	QueryPerformanceCounter(&end);
+	const ULONGLONG			 cpuEnd = GetProcessCpuTime();
+	const long long			 bytes = recvBytes - bytesBegin;
+	const unsigned long long zeroCopyBytes = server.GetZeroCopySendBytes() - zeroCopyBegin;
+
+	const double elapsed = (double)(end.QuadPart - begin.QuadPart) / frequency.QuadPart;
+	const double gigabytes = bytes / 1e9;
+	const double cpuMs = (double)(cpuEnd - cpuBegin) / 10000;
+
+	std::cout << "  " << payloadSize << "B " << mode << " : " << (long long)(gigabytes * 1000 / elapsed) << " MB/s, "
+			  << (long long)(gigabytes > 0 ? cpuMs / gigabytes : 0) << " ms cpu per GB, " << zeroCopyBytes / 1000000 << " MB sent from the frames"
+			  << std::endl;
+
+	return bytes > 0;
+}
+} // namespace
+
+// process CPU per GB with SO_SNDBUF at its default and at 0, over 127.0.0.1
+void RunSendBufferBench()
+{
+	PrintGroup("sendbuffer");
+
+	// NetServer can't be stopped, the server is left running until the process exits
+	BurstServer* pServer = new BurstServer;
+	pServer->EnableSharedMemory(false);
+	if (!pServer->Start("127.0.0.1", SNDBUF_BENCH_PORT, 4, false, SNDBUF_BENCH_CONNECTIONS))
+	{
+		std::cout << "  sendbuffer : server start fail" << std::endl;
+		return;
+	}
+
+	std::atomic<bool>	   stop{ false };
+	std::atomic<long long> recvBytes{ 0 };
+
+	std::vector<std::thread> vecThread;
+	for (int i = 0; i < SNDBUF_BENCH_CONNECTIONS; ++i)
+		vecThread.emplace_back([&]() { ClientLoop(SNDBUF_BENCH_PORT, stop, recvBytes); });
+
+	// INT_MAX, so a socket left at 0 by the last phase is put back
+	bool moved = true;
+	const int payloadSizes[] = { 1024, 8192, 32768 };
+	for (int payloadSize : payloadSizes)
+	{
+		pServer->SetZeroCopySend(INT_MAX);
+		moved &= MeasurePhase(*pServer, "SO_SNDBUF default", payloadSize, SNDBUF_BENCH_SECONDS, recvBytes);
+
+		pServer->SetZeroCopySend(1);
+		moved &= MeasurePhase(*pServer, "SO_SNDBUF 0", payloadSize, SNDBUF_BENCH_SECONDS, recvBytes);
+	}
+
+	stop = true;
+	for (std::thread& thread : vecThread)
+		thread.join();
+
+	if (!moved)
+		std::cout << "  sendbuffer : a phase received nothing, the clients lost their connections" << std::endl;
+}
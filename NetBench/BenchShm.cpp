@@ -0,0 +1,244 @@
+#include "Bench.h"
+#include "ShmTransport.h"
+#include "ThreadLocalMemoryPool.h"
+
+#include <WS2tcpip.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace
+{
+constexpr long long SHM_BENCH_BYTES = 256LL * 1024 * 1024; // echoed per measurement
+constexpr int		SHM_BENCH_STREAM_BYTES = 32 * 1024;	   // in flight for the throughput figure, both links buffer it
+constexpr int		SHM_BENCH_SOCKET_BUFFER = 256 * 1024;
+
+// the two ends of one link, as the client and the server's drain see it
+class EchoLink
+{
+public:
+	virtual ~EchoLink() = default;
+	virtual bool Write(MESSAGE* pMessage) = 0;
+	virtual bool Read(MESSAGE* pMessage) = 0;
+};
+
+class ShmLink : public EchoLink
+{
+public:
+	explicit ShmLink(ShmChannel& channel) : m_Channel(channel) {}
+
+	bool Write(MESSAGE* pMessage)
+	{
+		while (!m_Channel.Write(pMessage))
+			YieldProcessor();
+		return true;
+	}
+
+	// false once the peer has been told to stop and the ring stays empty
+	bool Read(MESSAGE* pMessage)
+	{
+		while (!m_Channel.Read(pMessage))
+		{
+			if (!m_Channel.Wait(100) && m_Stop)
+				return false;
+		}
+		return true;
+	}
+
+	void Stop()
+	{
+		m_Stop = true;
+		m_Channel.Wake();
+	}
+
+private:
+	ShmChannel&		  m_Channel;
+	std::atomic<bool> m_Stop{ false };
+};
+
+class TcpLink : public EchoLink
+{
+public:
+	explicit TcpLink(SOCKET linkSocket) : m_Socket(linkSocket) {}
+
+	bool Write(MESSAGE* pMessage) { return Transfer((char*)pMessage, sizeof(HEADER) + (unsigned short)pMessage->GetPayloadSize(), true); }
+
+	// false once the peer has closed
+	bool Read(MESSAGE* pMessage)
+	{
+		if (!Transfer((char*)pMessage, sizeof(HEADER), false))
+			return false;
+
+		return Transfer((char*)pMessage + sizeof(HEADER), (unsigned short)pMessage->GetPayloadSize(), false);
+	}
+
+private:
+	bool Transfer(char* pData, int size, bool sending)
+	{
+		while (size > 0)
+		{
+			const int done = sending ? send(m_Socket, pData, size, 0) : recv(m_Socket, pData, size, 0);
+			if (done <= 0)
+				return false;
+
+			pData += done;
+			size -= done;
+		}
+		return true;
+	}
+
+private:
+	SOCKET m_Socket;
+};
+
+void EchoLoop(EchoLink& link, MESSAGE* pMessage)
+{
+	while (link.Read(pMessage))
+		link.Write(pMessage);
+}
+
+// depth frames go out before the first echo is read, 1 is a plain round trip
+double MeasureEcho(EchoLink& link, MESSAGE* pMessage, int depth)
+{
+	const long long bytesPerOp = (long long)(sizeof(HEADER) + (unsigned short)pMessage->GetPayloadSize()) * depth;
+	const long long iterations = (std::max)(SHM_BENCH_BYTES / bytesPerOp, 10000LL);
+
+	return MeasureNsPerOp(iterations, [&](long long) {
+		for (int i = 0; i < depth; ++i)
+			link.Write(pMessage);
+		for (int i = 0; i < depth; ++i)
+			link.Read(pMessage);
+	}) / depth;
+}
+
+// a connected pair over 127.0.0.1 with Nagle off, as the server runs by default
+bool ConnectTcpPair(SOCKET& clientSocket, SOCKET& serverSocket)
+{
+	SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+		return false;
+
+	SOCKADDR_IN addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = 0;
+	InetPtonA(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+	int addrLen = sizeof(addr);
+	if (bind(listenSocket, (SOCKADDR*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(listenSocket, 1) == SOCKET_ERROR ||
+		getsockname(listenSocket, (SOCKADDR*)&addr, &addrLen) == SOCKET_ERROR)
+	{
+		closesocket(listenSocket);
+		return false;
+	}
+
+	clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (clientSocket == INVALID_SOCKET || connect(clientSocket, (SOCKADDR*)&addr, sizeof(addr)) == SOCKET_ERROR)
+	{
+		closesocket(clientSocket);
+		closesocket(listenSocket);
+		return false;
+	}
+
+	serverSocket = accept(listenSocket, nullptr, nullptr);
+	closesocket(listenSocket);
+	if (serverSocket == INVALID_SOCKET)
+	{
+		closesocket(clientSocket);
+		return false;
+	}
+
+	for (SOCKET linkSocket : { clientSocket, serverSocket })
+	{
+		BOOL noDelay = TRUE;
+		int	 bufferSize = SHM_BENCH_SOCKET_BUFFER;
+		setsockopt(linkSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+		setsockopt(linkSocket, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+		setsockopt(linkSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+	}
+
+	return true;
+}
+
+MESSAGE* MakeFrame(ThreadLocalMemoryPool<MESSAGE>& pool, int payloadSize)
+{
+	static const char payload[MAX_PAYLOAD_SIZE] = {};
+
+	MESSAGE* pMessage = pool.Allocate();
+	pMessage->Reset();
+	pMessage->put(payload, payloadSize);
+	return pMessage;
+}
+
+void BenchPayload(EchoLink& shmLink, EchoLink& tcpLink, ThreadLocalMemoryPool<MESSAGE>& pool, int payloadSize)
+{
+	MESSAGE*		  pMessage = MakeFrame(pool, payloadSize);
+	const int		  frameSize = (int)sizeof(HEADER) + payloadSize;
+	const int		  depth = (std::max)(SHM_BENCH_STREAM_BYTES / frameSize, 1);
+	const std::string suffix = " " + std::to_string(payloadSize) + "B";
+
+	PrintResult(("round trip, shm" + suffix).c_str(), MeasureEcho(shmLink, pMessage, 1));
+	PrintResult(("round trip, tcp 127.0.0.1" + suffix).c_str(), MeasureEcho(tcpLink, pMessage, 1));
+	PrintResult(("streamed echo, shm" + suffix).c_str(), MeasureEcho(shmLink, pMessage, depth), frameSize);
+	PrintResult(("streamed echo, tcp 127.0.0.1" + suffix).c_str(), MeasureEcho(tcpLink, pMessage, depth), frameSize);
+
+	pool.Free(pMessage);
+}
+} // namespace
+
+// the same echo over a shared memory link and a loopback socket
+void RunShmBench()
+{
+	PrintGroup("shm");
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return;
+
+	char name[SHM_NAME_SIZE];
+	std::snprintf(name, sizeof(name), "Local\\NetBenchShm_%lu", GetCurrentProcessId());
+
+	ShmChannel clientChannel;
+	ShmChannel peerChannel;
+	SOCKET	   clientSocket = INVALID_SOCKET;
+	SOCKET	   peerSocket = INVALID_SOCKET;
+	if (!clientChannel.Create(name, SHM_RING_SIZE) || !peerChannel.Open(name) || !ConnectTcpPair(clientSocket, peerSocket))
+	{
+		std::printf("  shm : link setup failed\n");
+		WSACleanup();
+		return;
+	}
+
+	ThreadLocalMemoryPool<MESSAGE> pool(4);
+
+	// the peers' frames come from this thread, so they go back to its queue
+	MESSAGE* pShmPeerFrame = pool.Allocate();
+	MESSAGE* pTcpPeerFrame = pool.Allocate();
+
+	ShmLink clientShm(clientChannel);
+	ShmLink peerShm(peerChannel);
+	TcpLink clientTcp(clientSocket);
+	TcpLink peerTcp(peerSocket);
+
+	std::thread shmPeer([&]() { EchoLoop(peerShm, pShmPeerFrame); });
+	std::thread tcpPeer([&]() { EchoLoop(peerTcp, pTcpPeerFrame); });
+
+	const int payloadSizes[] = { 64, 1024, 16384 };
+	for (int payloadSize : payloadSizes)
+		BenchPayload(clientShm, clientTcp, pool, payloadSize);
+
+	peerShm.Stop();
+	shutdown(clientSocket, SD_BOTH);
+	shmPeer.join();
+	tcpPeer.join();
+
+	closesocket(clientSocket);
+	closesocket(peerSocket);
+	pool.Free(pShmPeerFrame);
+	pool.Free(pTcpPeerFrame);
+
+	WSACleanup();
+}
@@ -0,0 +1,249 @@
+#include "NetServer.h"
+#include "Bench.h"
+
+#include <random>
+
+namespace
+{
+constexpr short STRESS_PORT = 27932;
+constexpr int	STRESS_SECONDS = 30;
+constexpr int	STRESS_CLIENT_THREADS = 8;
+constexpr int	STRESS_HAMMER_THREADS = 4;
+constexpr int	STRESS_FRAME_PAYLOAD = 32;
+constexpr int	STRESS_FRAMES_PER_CONNECTION = 4;
+constexpr DWORD STRESS_DRAIN_TIMEOUT_MS = 10000;
+constexpr int	STRESS_STALE_SESSION_CNT = 4096; // left sessionUIDs the hammer keeps trying
+
+// set around every API call the hammer makes, OnClientLeave must never see it
+thread_local bool t_InApiCall = false;
+
+class StressServer : public NetServer
+{
+public:
+	StressServer()
+	: m_JoinCnt(0)
+	, m_LeaveCnt(0)
+	, m_RecvCnt(0)
+	, m_ErrorCnt(0)
+	{
+	}
+
+	// a live sessionUID most of the time, otherwise one that has already left
+	bool PickSession(std::mt19937& random, SESSION_UID& sessionUID)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		std::vector<SESSION_UID>&	vecPick = (random() % 4 != 0 || m_vecStale.empty()) ? m_vecLive : m_vecStale;
+		if (vecPick.empty())
+			return false;
+
+		sessionUID = vecPick[random() % vecPick.size()];
+		return true;
+	}
+
+	long long GetJoinCount() const { return m_JoinCnt; }
+	long long GetLeaveCount() const { return m_LeaveCnt; }
+	long long GetRecvCount() const { return m_RecvCnt; }
+	long long GetErrorCount() const { return m_ErrorCnt; }
+
+private:
+	bool OnConnectionRequest(char* pClientIP, short port) { return true; }
+
+	void OnClientJoin(SESSION_UID sessionUID)
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		if (!m_mapLive.emplace(sessionUID, m_vecLive.size()).second)
+			Fail("second join", sessionUID);
+
+		m_vecLive.push_back(sessionUID);
+		++m_JoinCnt;
+	}
+
+	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if (m_mapLive.find(sessionUID) == m_mapLive.end())
+				Fail("recv outside join and leave", sessionUID);
+		}
+
+		++m_RecvCnt;
+		FreeMessage(pMessage);
+	}
+
+	void OnClientLeave(SESSION_UID sessionUID)
+	{
+		if (t_InApiCall)
+			Fail("leave inside an API call", sessionUID);
+
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto						it = m_mapLive.find(sessionUID);
+		if (it == m_mapLive.end())
+		{
+			Fail("leave without a join", sessionUID);
+			return;
+		}
+
+		// swap remove, the moved sessionUID takes over the slot
+		const size_t slot = it->second;
+		m_vecLive[slot] = m_vecLive.back();
+		m_mapLive[m_vecLive[slot]] = slot;
+		m_vecLive.pop_back();
+		m_mapLive.erase(sessionUID);
+
+		if (m_vecStale.size() < STRESS_STALE_SESSION_CNT)
+			m_vecStale.push_back(sessionUID);
+		else
+			m_vecStale[m_LeaveCnt % STRESS_STALE_SESSION_CNT] = sessionUID;
+
+		++m_LeaveCnt;
+	}
+
+	void Fail(const char* what, SESSION_UID sessionUID)
+	{
+		if (m_ErrorCnt++ < 10)
+			std::cout << "  stress : " << what << " : " << sessionUID << std::endl;
+	}
+
+private:
+	std::mutex								m_Lock;
+	std::unordered_map<SESSION_UID, size_t> m_mapLive; // sessionUID to its slot in m_vecLive
+	std::vector<SESSION_UID>				m_vecLive;
+	std::vector<SESSION_UID>				m_vecStale;
+	std::atomic<long long>					m_JoinCnt;
+	std::atomic<long long>					m_LeaveCnt;
+	std::atomic<long long>					m_RecvCnt;
+	std::atomic<long long>					m_ErrorCnt;
+};
+
+void ClientLoop(short port, const std::atomic<bool>& stop, std::atomic<long long>& connectCnt)
+{
+	std::mt19937 random(GetCurrentThreadId());
+
+	char frame[sizeof(HEADER) + STRESS_FRAME_PAYLOAD];
+	std::memset(frame, 'c', sizeof(frame));
+
+	HEADER header;
+	header.type = PACKET_TYPE::USER;
+	header.length = STRESS_FRAME_PAYLOAD;
+	std::memcpy(frame, &header, sizeof(header));
+
+	SOCKADDR_IN serverAddr;
+	ZeroMemory(&serverAddr, sizeof(serverAddr));
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons(port);
+	InetPtonA(AF_INET, "127.0.0.1", &serverAddr.sin_addr);
+
+	while (!stop)
+	{
+		SOCKET clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (clientSocket == INVALID_SOCKET)
+			continue;
+
+		if (connect(clientSocket, (SOCKADDR*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+		{
+			closesocket(clientSocket);
+			Sleep(1);
+			continue;
+		}
+
+		++connectCnt;
+
+		const int frameCnt = random() % (STRESS_FRAMES_PER_CONNECTION + 1);
+		for (int i = 0; i < frameCnt; ++i)
+			send(clientSocket, frame, sizeof(frame), 0);
+
+		// sometimes hang up at once, sometimes after the server has had time to answer
+		if (random() % 2 == 0)
+			Sleep(random() % 3);
+
+		// an abortive close half the time, the server sees a reset instead of a FIN
+		if (random() % 2 == 0)
+		{
+			linger abortive = { 1, 0 };
+			setsockopt(clientSocket, SOL_SOCKET, SO_LINGER, (const char*)&abortive, sizeof(abortive));
+		}
+
+		closesocket(clientSocket);
+	}
+}
+
+void HammerLoop(StressServer& server, const std::atomic<bool>& stop, std::atomic<long long>& callCnt)
+{
+	std::mt19937 random(GetCurrentThreadId());
+
+	while (!stop)
+	{
+		SESSION_UID sessionUID;
+		if (!server.PickSession(random, sessionUID))
+		{
+			YieldProcessor();
+			continue;
+		}
+
+		t_InApiCall = true;
+		switch (random() % 8)
+		{
+		case 0:
+			server.Disconnect(sessionUID);
+			break;
+		case 1:
+			server.Flush(sessionUID);
+			break;
+		default:
+		{
+			MESSAGE* pMessage = server.AllocateMessage();
+			if (pMessage != nullptr)
+			{
+				pMessage->put(&sessionUID, sizeof(sessionUID));
+				server.Send(sessionUID, pMessage, random() % 2 == 0 ? SEND_PRIORITY::HIGH : SEND_PRIORITY::BULK, random() % 4 == 0);
+			}
+			break;
+		}
+		}
+		t_InApiCall = false;
+
+		++callCnt;
+	}
+}
+} // namespace
+
+// Send, Flush and Disconnect on live and stale sessionUIDs against connections closing
+void RunStressBench()
+{
+	PrintGroup("stress");
+
+	// NetServer can't be stopped, the server is left running until the process exits
+	StressServer* pServer = new StressServer;
+	pServer->EnableSharedMemory(false);
+	if (!pServer->Start("127.0.0.1", STRESS_PORT, 4, false, 1000))
+	{
+		std::cout << "  stress : server start fail" << std::endl;
+		return;
+	}
+
+	std::atomic<bool>	   stop{ false };
+	std::atomic<long long> connectCnt{ 0 };
+	std::atomic<long long> callCnt{ 0 };
+
+	std::vector<std::thread> vecThread;
+	for (int i = 0; i < STRESS_CLIENT_THREADS; ++i)
+		vecThread.emplace_back([&]() { ClientLoop(STRESS_PORT, stop, connectCnt); });
+	for (int i = 0; i < STRESS_HAMMER_THREADS; ++i)
+		vecThread.emplace_back([&]() { HammerLoop(*pServer, stop, callCnt); });
+
+	Sleep(STRESS_SECONDS * 1000);
+	stop = true;
+
+	for (std::thread& thread : vecThread)
+		thread.join();
+
+	// every client has hung up, each join must be matched by a leave once the server has caught up
+	const ULONGLONG deadline = GetTickCount64() + STRESS_DRAIN_TIMEOUT_MS;
+	while (pServer->GetJoinCount() != pServer->GetLeaveCount() && GetTickCount64() < deadline)
+		Sleep(10);
+
+	const bool passed = pServer->GetErrorCount() == 0 && pServer->GetJoinCount() == pServer->GetLeaveCount();
+
+	std::cout << "  " << (passed ? "passed" : "FAILED") << " : " << connectCnt << " connects, " << pServer->GetJoinCount() << " joins, "
+			  << pServer->GetLeaveCount() << " leaves, " << pServer->GetRecvCount() << " recvs, " << callCnt << " api calls, " << pServer->GetErrorCount() << " errors" << std::endl;
+}
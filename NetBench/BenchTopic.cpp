@@ -0,0 +1,139 @@
+#include "Bench.h"
+#include "MpscQueue.h"
+#include "ThreadLocalMemoryPool.h"
+#include "TopicTable.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr long long TOPIC_MEMBER_OPS = 2000000; // members served per measurement
+constexpr TOPIC_ID	BENCH_TOPIC = 7;
+
+// NetServer's FRAME_REF, which lives with the server
+struct SHARED_REF
+{
+	std::atomic<SHARED_REF*> pNext;
+	MESSAGE*				 pFrame;
+};
+
+// what the server keeps per member for a publish : the bulk lane a per member Send copy goes to,
+// and the shared lane a published frame is referenced from
+struct MEMBER_QUEUE
+{
+	MpscQueue<MESSAGE>	  sendQ;
+	MpscQueue<SHARED_REF> sendSharedQ;
+};
+
+// static, the shards are cache line aligned
+TopicTable g_Topics;
+
+// the loop applications had : a copy of the payload per member, queued and freed once sent
+double MeasureCopyFanOut(ThreadLocalMemoryPool<MESSAGE>& pool, std::vector<MEMBER_QUEUE>& vecQueue, const std::vector<char>& payload)
+{
+	const int memberCnt = (int)vecQueue.size();
+
+	return MeasureNsPerOp(TOPIC_MEMBER_OPS / memberCnt, [&](long long) {
+		for (MEMBER_QUEUE& queue : vecQueue)
+		{
+			MESSAGE* pMessage = pool.Allocate();
+			pMessage->Reset();
+			pMessage->put(payload.data(), (int)payload.size());
+			queue.sendQ.Push(pMessage);
+		}
+
+		// the send completions
+		for (MEMBER_QUEUE& queue : vecQueue)
+			pool.Free(queue.sendQ.Pop());
+	}) / memberCnt;
+}
+
+// Publish : the member list is taken once, the frame is encoded once and every member gets a reference
+double MeasureSharedFanOut(ThreadLocalMemoryPool<MESSAGE>& pool, ThreadLocalMemoryPool<SHARED_REF>& refPool, std::vector<MEMBER_QUEUE>& vecQueue, const std::vector<char>& payload)
+{
+	const int memberCnt = (int)vecQueue.size();
+
+	// MESSAGE::shareCount is the server's, the same count kept beside the frame
+	std::atomic<int> shareCount{ 0 };
+
+	return MeasureNsPerOp(TOPIC_MEMBER_OPS / memberCnt, [&](long long) {
+		TOPIC_MEMBERS members = g_Topics.GetMembers(BENCH_TOPIC);
+
+		MESSAGE* pFrame = pool.Allocate();
+		pFrame->Reset();
+		pFrame->put(payload.data(), (int)payload.size());
+		shareCount.store((int)members->size(), std::memory_order_relaxed);
+
+		for (size_t i = 0; i < members->size(); ++i)
+		{
+			SHARED_REF* pRef = refPool.Allocate();
+			pRef->pFrame = pFrame;
+			vecQueue[(size_t)(*members)[i]].sendSharedQ.Push(pRef);
+		}
+
+		for (MEMBER_QUEUE& queue : vecQueue)
+		{
+			SHARED_REF* pRef = queue.sendSharedQ.Pop();
+			if (shareCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				pool.Free(pRef->pFrame);
+
+			refPool.Free(pRef);
+		}
+	}) / memberCnt;
+}
+
+void BenchFanOut(int memberCnt)
+{
+	ThreadLocalMemoryPool<MESSAGE>	  messagePool(64);
+	ThreadLocalMemoryPool<SHARED_REF> refPool(1024);
+
+	// the member's index stands in for its SESSION_UID
+	std::vector<MEMBER_QUEUE> vecQueue(memberCnt);
+	for (int i = 0; i < memberCnt; ++i)
+		g_Topics.Subscribe(BENCH_TOPIC, (SESSION_UID)i);
+
+	const int payloadSizes[] = { 64, 1024 };
+	for (int payloadSize : payloadSizes)
+	{
+		std::vector<char> payload(payloadSize, 't');
+		const std::string suffix = " " + std::to_string(payloadSize) + "B x " + std::to_string(memberCnt);
+
+		PrintResult(("fan out per member, copy" + suffix).c_str(), MeasureCopyFanOut(messagePool, vecQueue, payload));
+		PrintResult(("fan out per member, shared" + suffix).c_str(), MeasureSharedFanOut(messagePool, refPool, vecQueue, payload));
+	}
+
+	for (int i = 0; i < memberCnt; ++i)
+		g_Topics.Unsubscribe(BENCH_TOPIC, (SESSION_UID)i);
+}
+
+// Subscribe copies the member list, GetMembers copies a pointer under the shard lock
+void BenchMembership()
+{
+	const int memberCnt = 1000;
+	for (int i = 0; i < memberCnt; ++i)
+		g_Topics.Subscribe(BENCH_TOPIC + 1, (SESSION_UID)i);
+
+	double getNs = MeasureNsPerOp(TOPIC_MEMBER_OPS, [](long long) { Consume(g_Topics.GetMembers(BENCH_TOPIC + 1).get()); });
+
+	double churnNs = MeasureNsPerOp(TOPIC_MEMBER_OPS / 100, [memberCnt](long long i) {
+		const SESSION_UID sessionUID = memberCnt + (SESSION_UID)(i % 16);
+		g_Topics.Subscribe(BENCH_TOPIC + 1, sessionUID);
+		g_Topics.Unsubscribe(BENCH_TOPIC + 1, sessionUID);
+	});
+
+	PrintResult("TopicTable::GetMembers", getNs);
+	PrintResult("TopicTable subscribe+unsubscribe, 1000 members", churnNs);
+}
+} // namespace
+
+// the fan out runs on one thread, the chunks Publish posts to other workers split it further
+void RunTopicBench()
+{
+	PrintGroup("topic");
+
+	BenchFanOut(100);
+	BenchFanOut(1000);
+	BenchMembership();
+}
@@ -0,0 +1,57 @@
+#include "Bench.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+struct BENCH_GROUP
+{
+	const char* name;
+	void (*run)();
+};
+
+const BENCH_GROUP BENCH_GROUPS[] = {
+	{ "core", RunCoreBench },
+	{ "integrity", RunIntegrityBench },
+	{ "crypto", RunCryptoBench },
+	{ "layout", RunLayoutBench },
+	{ "fairness", RunFairnessBench },
+	{ "topic", RunTopicBench },
+	{ "chain", RunChainBench },
+	{ "coroutine", RunCoroutineBench },
+	{ "shm", RunShmBench },
+	{ "stress", RunStressBench },
+	{ "loopback", RunLoopbackBench },
+	{ "sendbuffer", RunSendBufferBench },
+};
+} // namespace
+
+// NetBench [group ...] runs the named groups, no argument runs all of them
+int main(int argc, char* argv[])
+{
+	bool found = argc == 1;
+	for (const BENCH_GROUP& group : BENCH_GROUPS)
+	{
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; ++i)
+			selected = selected || std::strcmp(argv[i], group.name) == 0;
+
+		if (!selected)
+			continue;
+
+		found = true;
+		group.run();
+	}
+
+	if (!found)
+	{
+		std::cout << "groups :";
+		for (const BENCH_GROUP& group : BENCH_GROUPS)
+			std::cout << " " << group.name;
+		std::cout << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
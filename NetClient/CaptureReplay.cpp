@@ -0,0 +1,107 @@
+#include "CaptureReplay.h"
+#include "TrafficCapture.h"
+
+#include <unordered_map>
+
+namespace
+{
+double GetElapsedSeconds(const LARGE_INTEGER& start, const LARGE_INTEGER& frequency)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)(now.QuadPart - start.QuadPart) / frequency.QuadPart;
+}
+} // namespace
+
+bool RunCaptureReplay(const char* pathPrefix, const char* ip, short port, int connectionCount, double speed)
+{
+	CaptureReader reader;
+	if (!reader.Open(pathPrefix))
+	{
+		std::cout << "no capture at " << pathPrefix << std::endl;
+		return false;
+	}
+
+	if (connectionCount < 1)
+		connectionCount = 1;
+
+	// NetClient never joins its threads, so the clients are left to the process exit
+	std::vector<ReplayClient*> vecClient;
+	for (int i = 0; i < connectionCount; ++i)
+	{
+		ReplayClient* pClient = new ReplayClient;
+		if (!pClient->Connect(ip, port, false))
+		{
+			std::cout << "replay connect fail : " << i << std::endl;
+			return false;
+		}
+
+		vecClient.push_back(pClient);
+	}
+
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER start;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	std::unordered_map<SESSION_UID, int> mapConnection;
+	LONGLONG							 firstTick = 0;
+	long long							 sentCount = 0;
+
+	CAPTURE_RECORD record;
+	const char*	   pFrame = nullptr;
+	int			   frameSize = 0;
+	while (reader.Next(record, pFrame, frameSize))
+	{
+		if (record.direction != CAPTURE_DIRECTION::RECV)
+			continue;
+
+		if (firstTick == 0)
+			firstTick = record.tick;
+
+		if (speed > 0)
+		{
+			double due = (double)(record.tick - firstTick) / reader.GetTickFrequency() / speed;
+			while (true)
+			{
+				double wait = due - GetElapsedSeconds(start, frequency);
+				if (wait <= 0)
+					break;
+
+				if (wait > 0.002)
+					Sleep(1);
+				else
+					YieldProcessor();
+			}
+		}
+
+		auto it = mapConnection.find(record.sessionUID);
+		if (it == mapConnection.end())
+			it = mapConnection.insert(std::make_pair(record.sessionUID, (int)(mapConnection.size() % connectionCount))).first;
+
+		ReplayClient& client = *vecClient[it->second];
+
+		MESSAGE* pMessage = client.AllocateMessage();
+		if (pMessage == nullptr)
+			continue;
+
+		pMessage->put(pFrame + sizeof(HEADER), frameSize - (int)sizeof(HEADER));
+		client.Send(pMessage);
+
+		++sentCount;
+	}
+
+	double elapsed = GetElapsedSeconds(start, frequency);
+
+	long long recvCount = 0;
+	for (ReplayClient* pClient : vecClient)
+		recvCount += pClient->GetRecvCount();
+
+	std::cout << "replayed " << sentCount << " messages from " << mapConnection.size() << " sessions in " << elapsed << " sec ("
+			  << (elapsed > 0 ? sentCount / elapsed : 0) << " msg/s), received " << recvCount << std::endl;
+
+	for (ReplayClient* pClient : vecClient)
+		pClient->Disconnect();
+
+	return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "NetClient.h"
+
+class ReplayClient : public NetClient
+{
+public:
+	ReplayClient()
+	: m_RecvCount(0)
+	{
+	}
+
+	long long GetRecvCount() const { return m_RecvCount; }
+
+private:
+	void OnConnect() {}
+	void OnDisconnect() {}
+
+	void OnRecv(MESSAGE* pMessage)
+	{
+		++m_RecvCount;
+		FreeMessage(pMessage);
+	}
+
+private:
+	std::atomic<long long> m_RecvCount;
+};
+
+// speed 1 keeps the captured pacing, 0 sends as fast as possible
+bool RunCaptureReplay(const char* pathPrefix, const char* ip, short port, int connectionCount, double speed);
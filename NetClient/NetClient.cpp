@@ -1,13 +1,72 @@
 #include "NetClient.h"
+#include "CaptureReplay.h"
+#include "RpcRoundTrip.h"
 #include "GlobalValue.h"
+#include "SystemPacket.h"
+#include "MessageFramer.h"
 
 #define PRINT_ERROR() PrintError(WSAGetLastError(), __LINE__);
 
 NetClient::NetClient()
 : m_MessagePool(3000)
+, m_RecvChain([this]() { return AllocateMessage(); }, [this](MESSAGE* pMessage) { FreeMessage(pMessage); })
 , m_hIocp(INVALID_HANDLE_VALUE)
 , m_AlreadyInitialized(false)
+, m_LargeFrameThreshold(LARGE_FRAME_THRESHOLD)
+, m_UdpConnected(false)
+, m_ShmSendActive(false)
+, m_ShmRecvActive(false)
+, m_pShmSwitchMessage(nullptr)
+, m_pShmCarry(nullptr)
+, m_UseIntegrity(true)
+, m_IntegrityRecv(false)
+, m_IntegritySend(false)
+, m_pIntegritySwitchMessage(nullptr)
+, m_UseEncryption(true)
+, m_DecryptRecv(false)
+, m_EncryptSend(false)
+, m_pCryptoSwitchMessage(nullptr)
 {
+	ZeroMemory(&m_UdpServerAddress, sizeof(m_UdpServerAddress));
+
+	m_UdpAllocate = [this]() { return AllocateMessage(); };
+	m_UdpFree = [this](MESSAGE* pMessage) { FreeMessage(pMessage); };
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_UdpBind>([this](SESSION*, SystemPacketHeader* pPacket) {
+		OnUdpBind(pPacket);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_ShmOffer>([this](SESSION*, SystemPacketHeader* pPacket) {
+		OnShmOffer(pPacket);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_ShmSwitch>([this](SESSION*, SystemPacketHeader*) {
+		{
+			std::lock_guard<std::mutex> shmLock(m_ShmLock);
+			m_ShmRecvActive = true;
+		}
+		m_ShmActiveCond.notify_one();
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_IntegrityOffer>([this](SESSION*, SystemPacketHeader*) {
+		OnIntegrityOffer();
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_IntegritySwitch>([this](SESSION*, SystemPacketHeader*) {
+		m_IntegrityRecv = true;
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_CryptoOffer>([this](SESSION*, SystemPacketHeader* pPacket) {
+		OnCryptoOffer(pPacket);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_CryptoSwitch>([this](SESSION*, SystemPacketHeader*) {
+		m_DecryptRecv = true;
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_RpcResponse>([this](SESSION*, SystemPacketHeader* pPacket) {
+		OnRpcResponse(pPacket);
+	});
 }
 
 bool NetClient::Connect(const char* ip, short port, bool tcpNagleOn)
@@ -73,6 +132,33 @@ bool NetClient::Connect(const char* ip, short port, bool tcpNagleOn)
 	return true;
 }
 
+bool NetClient::ConnectLoopback(LoopbackNetwork* pNetwork)
+{
+	if (!Initialize())
+		return false;
+
+	if (pNetwork == nullptr)
+		return false;
+
+	LoopbackPipe* pPipe = pNetwork->Connect();
+	if (pPipe == nullptr)
+		return false;
+
+	pPipe->Attach(m_hIocp, NULL);
+
+	GetSession().Reset();
+	GetSession().sessionSocket = INVALID_SOCKET;
+	GetSession().pLoopback = pPipe;
+
+	GetSession().SetReleaseState(false);
+
+	OnConnect();
+
+	PostRecv();
+
+	return true;
+}
+
 bool NetClient::Send(MESSAGE* pMessage)
 {
 	if (pMessage == nullptr)
@@ -85,6 +171,13 @@ bool NetClient::Send(MESSAGE* pMessage)
 		return false;
 	}
 
+	// straight into the ring only with nothing queued ahead of it
+	if (m_ShmSendActive && m_pShmCarry == nullptr && GetSession().sendQ.empty() && m_ShmChannel.Write(pMessage))
+	{
+		FreeMessage(pMessage);
+		return true;
+	}
+
 	GetSession().sendQ.push(pMessage);
 	return true;
 }
@@ -96,8 +189,52 @@ bool NetClient::Disconnect()
 	if (GetSession().IsReleased())
 		return false;
 
-	shutdown(GetSession().sessionSocket, SD_BOTH);
+	ShutdownSession();
+
+	return true;
+}
+
+bool NetClient::ConnectUdp(const char* ip, short port)
+{
+	if (!Initialize())
+		return false;
+
+	if (ip == nullptr || m_UdpConnected)
+		return false;
+
+	if (!m_UdpSocket.Open("0.0.0.0", 0))
+		return false;
+
+	SOCKADDR_IN addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	InetPtonA(AF_INET, ip, &addr.sin_addr);
+	addr.sin_port = htons(port);
+
+	m_UdpPeer.Lock();
+	m_UdpServerAddress = addr;
+	if (m_UdpPeer.GetSessionUID() != 0)
+		m_UdpPeer.SetAddress(m_UdpServerAddress);
+	m_UdpPeer.Unlock();
+
+	m_UdpConnected = true;
+	m_UdpThread = std::thread([this]() { UdpThread(); });
+
+	return true;
+}
+
+bool NetClient::SendDatagram(MESSAGE* pMessage, DELIVERY delivery)
+{
+	if (pMessage == nullptr)
+		return false;
+
+	if (!m_UdpPeer.IsBound() || !UdpPeer::CanCarry(pMessage))
+	{
+		FreeMessage(pMessage);
+		return false;
+	}
 
+	m_UdpPeer.Queue(pMessage, delivery);
 	return true;
 }
 
@@ -163,6 +300,8 @@ void NetClient::SendThread()
 		Sleep(1);
 
 		PostSend();
+
+		m_RpcCalls.Expire(GetTickCount64());
 	}
 }
 
@@ -170,25 +309,41 @@ void NetClient::PostRecv()
 {
 	RingBuffer& recvQ = GetSession().recvQ;
 
-	int freeSize = (int)recvQ.free_space();
-	int directEnqueueSize = (int)recvQ.direct_enqueue_size();
-
 	int	bufCount = 1;
 	WSABUF recvBuf[2];
-	recvBuf[0].buf = recvQ.head_pointer();
-	recvBuf[0].len = directEnqueueSize;
-	if (directEnqueueSize < freeSize)
+	if (GetSession().pLargeMessage != nullptr)
+	{
+		MESSAGE* pMessage = GetSession().pLargeMessage;
+		recvBuf[0].buf = (char*)pMessage + GetSession().largeReceivedSize;
+		recvBuf[0].len = sizeof(pMessage->header) + pMessage->header.length - GetSession().largeReceivedSize;
+	}
+	else
 	{
-		recvBuf[1].buf = recvQ.start_pointer();
-		recvBuf[1].len = freeSize - directEnqueueSize;
-		++bufCount;
+		int freeSize = (int)recvQ.free_space();
+		int directEnqueueSize = (int)recvQ.direct_enqueue_size();
+
+		recvBuf[0].buf = recvQ.head_pointer();
+		recvBuf[0].len = directEnqueueSize;
+		if (directEnqueueSize < freeSize)
+		{
+			recvBuf[1].buf = recvQ.start_pointer();
+			recvBuf[1].len = freeSize - directEnqueueSize;
+			++bufCount;
+		}
 	}
 
 	GetSession().ResetRecvOverlapped();
 	PreventRelease();
 
-	DWORD flags = 0;
-	int   result = WSARecv(GetSession().sessionSocket, recvBuf, bufCount, nullptr, &flags, &GetSession().recvOverlapped, nullptr);
+	int result;
+	if (GetSession().pLoopback != nullptr)
+		result = GetSession().pLoopback->Recv(recvBuf, bufCount, &GetSession().recvOverlapped);
+	else
+	{
+		DWORD flags = 0;
+		result = WSARecv(GetSession().sessionSocket, recvBuf, bufCount, nullptr, &flags, &GetSession().recvOverlapped, nullptr);
+	}
+
 	if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
 	{
 		PRINT_ERROR();
@@ -198,6 +353,12 @@ void NetClient::PostRecv()
 
 void NetClient::PostSend()
 {
+	if (m_ShmSendActive)
+	{
+		PostShmSend();
+		return;
+	}
+
 	// when sendPendingQ is not empty, send Process is not over
 	if (!GetSession().sendPendingQ.empty() || GetSession().sendQ.empty())
 		return;
@@ -214,6 +375,22 @@ void NetClient::PostSend()
 			return;
 		}
 
+		if (!SealFrame(pMessage))
+		{
+			PrintError(ERROR_BUFFER_OVERFLOW, __LINE__);
+			ShutdownSession();
+
+			if (m_pShmSwitchMessage == pMessage)
+				m_pShmSwitchMessage = nullptr;
+			if (m_pIntegritySwitchMessage == pMessage)
+				m_pIntegritySwitchMessage = nullptr;
+			if (m_pCryptoSwitchMessage == pMessage)
+				m_pCryptoSwitchMessage = nullptr;
+
+			FreeMessage(pMessage);
+			return;
+		}
+
 		sendBuf[wsaBufIdx].buf = (char*)pMessage;
 		sendBuf[wsaBufIdx].len = sizeof(pMessage->header) + pMessage->header.length;
 
@@ -221,6 +398,25 @@ void NetClient::PostSend()
 
 		GetSession().sendPendingQ.push(pMessage);
 
+		if (pMessage == m_pShmSwitchMessage)
+		{
+			m_pShmSwitchMessage = nullptr;
+			m_ShmSendActive = true;
+			break;
+		}
+
+		if (pMessage == m_pIntegritySwitchMessage)
+		{
+			m_pIntegritySwitchMessage = nullptr;
+			m_IntegritySend = true;
+		}
+
+		if (pMessage == m_pCryptoSwitchMessage)
+		{
+			m_pCryptoSwitchMessage = nullptr;
+			m_EncryptSend = true;
+		}
+
 		if (wsaBufIdx >= MAX_WSABUF_SIZE)
 			break;
 	}
@@ -228,8 +424,15 @@ void NetClient::PostSend()
 	GetSession().ResetSendOverlapped();
 	PreventRelease();
 
-	DWORD flags = 0;
-	int   result = WSASend(GetSession().sessionSocket, sendBuf, wsaBufIdx, nullptr, flags, &GetSession().sendOverlapped, nullptr);
+	int result;
+	if (GetSession().pLoopback != nullptr)
+		result = GetSession().pLoopback->Send(sendBuf, wsaBufIdx, &GetSession().sendOverlapped);
+	else
+	{
+		DWORD flags = 0;
+		result = WSASend(GetSession().sessionSocket, sendBuf, wsaBufIdx, nullptr, flags, &GetSession().sendOverlapped, nullptr);
+	}
+
 	if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
 	{
 		PRINT_ERROR();
@@ -239,46 +442,127 @@ void NetClient::PostSend()
 
 void NetClient::AfterRecvProcess(DWORD transferredBytes)
 {
+	if (GetSession().pLargeMessage != nullptr)
+	{
+		if (AfterLargeRecvProcess(transferredBytes))
+			PostRecv();
+		return;
+	}
+
 	RingBuffer& recvQ = GetSession().recvQ;
 	recvQ.move_head(transferredBytes);
 
 	while (true)
 	{
-		HEADER header;
-
-		const size_t headerSize = sizeof(header);
-		const size_t useSize = recvQ.size_in_use();
-		if (useSize <= sizeof(header))
-			break;
-
-		if (recvQ.peek((char*)&header, headerSize) == false)
+		HEADER		 header;
+		FRAME_STATUS status = PeekFrame(recvQ, header);
+		if (status == FRAME_STATUS::INVALID)
 		{
 			PRINT_ERROR();
 			break;
 		}
 
-		if (header.length >= RINGBUFFER_SIZE - headerSize)
+		if (status == FRAME_STATUS::INCOMPLETE)
 		{
-			PRINT_ERROR();
+			if (m_LargeFrameThreshold > 0 && header.length >= m_LargeFrameThreshold)
+				BeginLargeRecv(recvQ.size_in_use());
 			break;
 		}
 
-		if ((short)(useSize - headerSize) < header.length)
-			break;
-
 		MESSAGE* pMessage = AllocateMessage();
 		if (pMessage == nullptr)
 			return;
 
-		recvQ.peek((char*)pMessage, headerSize + header.length);
-		recvQ.move_tail(headerSize + header.length);
+		PopFrame(recvQ, header, pMessage);
 
-		OnRecv(pMessage);
+		if (!ProcessFrame(pMessage))
+			return;
 	}
 
 	PostRecv();
 }
 
+// false when the frame doesn't open, it is freed
+bool NetClient::ProcessFrame(MESSAGE* pMessage)
+{
+	if (!OpenFrame(pMessage))
+	{
+		PrintError(ERROR_INVALID_DATA, __LINE__);
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	if (pMessage->header.type == PACKET_TYPE::SYSTEM)
+	{
+		m_SystemPacketProcessor.RunProcessor(&GetSession(), pMessage);
+		FreeMessage(pMessage);
+		return true;
+	}
+
+	DeliverRecv(pMessage);
+	return true;
+}
+
+void NetClient::DeliverRecv(MESSAGE* pMessage)
+{
+	if (pMessage->header.type == PACKET_TYPE::USER_CONTINUED)
+	{
+		m_RecvChain.Append(pMessage);
+		return;
+	}
+
+	if (m_RecvChain.GetFirst() == nullptr)
+	{
+		OnRecv(pMessage);
+		return;
+	}
+
+	m_RecvChain.Append(pMessage);
+	OnRecvChain(m_RecvChain);
+	m_RecvChain.Clear();
+}
+
+void NetClient::OnRecvChain(MessageChain& chain)
+{
+	MESSAGE* pLast = nullptr;
+	MESSAGE* pMessage = chain.Detach(pLast);
+	while (pMessage != nullptr)
+	{
+		// take the link before OnRecv owns the frame
+		MESSAGE* pNext = MessageChain::GetNext(pMessage);
+		OnRecv(pMessage);
+		pMessage = pNext;
+	}
+}
+
+void NetClient::BeginLargeRecv(size_t bufferedSize)
+{
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	RingBuffer& recvQ = GetSession().recvQ;
+	recvQ.peek((char*)pMessage, bufferedSize);
+	recvQ.move_tail(bufferedSize);
+
+	GetSession().pLargeMessage = pMessage;
+	GetSession().largeReceivedSize = (int)bufferedSize;
+}
+
+bool NetClient::AfterLargeRecvProcess(DWORD transferredBytes)
+{
+	MESSAGE* pMessage = GetSession().pLargeMessage;
+
+	GetSession().largeReceivedSize += transferredBytes;
+	if (GetSession().largeReceivedSize < (int)sizeof(pMessage->header) + pMessage->header.length)
+		return true;
+
+	GetSession().pLargeMessage = nullptr;
+	GetSession().largeReceivedSize = 0;
+
+	return ProcessFrame(pMessage);
+}
+
 void NetClient::AfterSendProcess()
 {
 	MESSAGE* pMessage = nullptr;
@@ -293,14 +577,19 @@ void NetClient::AfterSendProcess()
 
 void NetClient::ReleaseSession()
 {
-	std::lock_guard<std::mutex> lock(GetSession().lock);
+	std::unique_lock<std::mutex> lock(GetSession().lock);
 
 	if (GetSession().IsReleased())
 		return;
 
 	GetSession().SetReleaseState(true);
 
-	closesocket(GetSession().sessionSocket);
+	if (GetSession().pLoopback != nullptr)
+		GetSession().pLoopback->Close();
+	else
+		closesocket(GetSession().sessionSocket);
+
+	GetSession().pLoopback = nullptr;
 
 	MESSAGE* pMessage = nullptr;
 	while (GetSession().sendQ.try_pop(pMessage))
@@ -319,7 +608,49 @@ void NetClient::ReleaseSession()
 		FreeMessage(pMessage);
 	}
 
+	FreeMessage(GetSession().pLargeMessage);
+	GetSession().pLargeMessage = nullptr;
+
+	m_RecvChain.Clear();
+
+	m_UdpPeer.Clear(m_UdpFree);
+
+	if (m_ShmRecvActive.exchange(false))
+		m_ShmChannel.Wake();
+
+	{
+		std::lock_guard<std::mutex> shmLock(m_ShmLock);
+		m_ShmSendActive = false;
+		m_ShmChannel.Close();
+	}
+
+	FreeMessage(m_pShmCarry);
+	m_pShmCarry = nullptr;
+	m_pShmSwitchMessage = nullptr;
+
+	m_IntegrityRecv = false;
+	m_IntegritySend = false;
+	m_pIntegritySwitchMessage = nullptr;
+
+	m_DecryptRecv = false;
+	m_EncryptSend = false;
+	m_pCryptoSwitchMessage = nullptr;
+	SecureZeroMemory(&m_RecvCrypto, sizeof(m_RecvCrypto));
+	SecureZeroMemory(&m_SendCrypto, sizeof(m_SendCrypto));
+
 	OnDisconnect();
+	lock.unlock();
+
+	// outside the lock
+	m_RpcCalls.FailAll(RPC_STATUS::DISCONNECTED);
+}
+
+void NetClient::ShutdownSession()
+{
+	if (GetSession().pLoopback != nullptr)
+		GetSession().pLoopback->Shutdown();
+	else
+		shutdown(GetSession().sessionSocket, SD_BOTH);
 }
 
 bool NetClient::PreventRelease()
@@ -344,6 +675,231 @@ bool NetClient::UnlockPrevent()
 	return true;
 }
 
+void NetClient::UdpThread()
+{
+	char datagram[UDP_MAX_DATAGRAM_SIZE];
+
+	while (true)
+	{
+		if (m_UdpSocket.Wait(1))
+		{
+			m_UdpSocket.Receive([this](const SOCKADDR_IN&, const char* pData, int size) {
+				m_UdpPeer.Lock();
+				if (m_UdpPeer.IsBound())
+					m_UdpPeer.OnDatagram(pData, size, m_UdpAllocate, m_UdpFree, m_vecUdpDelivered);
+				m_UdpPeer.Unlock();
+
+				for (MESSAGE* pMessage : m_vecUdpDelivered)
+					OnRecv(pMessage);
+
+				m_vecUdpDelivered.clear();
+			});
+		}
+
+		m_UdpPeer.Lock();
+
+		ULONGLONG now = GetTickCount64();
+		for (int batch = 0; batch < UDP_MAX_BATCH && m_UdpPeer.IsBound(); ++batch)
+		{
+			int size = m_UdpPeer.BuildDatagram(datagram, sizeof(datagram), now, m_UdpFree);
+			if (size == 0)
+				break;
+
+			m_UdpSocket.SendTo(m_UdpPeer.GetAddress(), datagram, size);
+		}
+
+		m_UdpPeer.Unlock();
+
+		m_UdpSocket.FlushDelayed();
+	}
+}
+
+void NetClient::OnUdpBind(SystemPacketHeader* pPacket)
+{
+	SystemPacket_UdpBind* pBind = static_cast<SystemPacket_UdpBind*>(pPacket);
+
+	m_UdpPeer.Reset(pBind->m_SessionUID, pBind->m_Token, m_UdpFree);
+
+	m_UdpPeer.Lock();
+	if (m_UdpConnected)
+		m_UdpPeer.SetAddress(m_UdpServerAddress);
+	m_UdpPeer.Unlock();
+}
+
+void NetClient::ShmThread()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(m_ShmLock);
+		m_ShmActiveCond.wait(lock, [this]() { return m_ShmRecvActive.load(); });
+
+		if (m_ShmChannel.IsEmpty())
+		{
+			m_ShmChannel.Wait(INFINITE);
+			continue;
+		}
+
+		MESSAGE* pMessage = AllocateMessage();
+		if (pMessage == nullptr)
+			continue;
+
+		if (!m_ShmChannel.Read(pMessage))
+		{
+			FreeMessage(pMessage);
+			continue;
+		}
+
+		lock.unlock();
+
+		if (pMessage->header.type == PACKET_TYPE::SYSTEM)
+		{
+			m_SystemPacketProcessor.RunProcessor(&GetSession(), pMessage);
+			FreeMessage(pMessage);
+			continue;
+		}
+
+		DeliverRecv(pMessage);
+	}
+}
+
+void NetClient::OnShmOffer(SystemPacketHeader* pPacket)
+{
+	SystemPacket_ShmOffer* pOffer = static_cast<SystemPacket_ShmOffer*>(pPacket);
+	pOffer->m_Name[SHM_NAME_SIZE - 1] = 0;
+
+	{
+		std::lock_guard<std::mutex> shmLock(m_ShmLock);
+		if (m_ShmChannel.IsOpen() || !m_ShmChannel.Open(pOffer->m_Name))
+			return;
+	}
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_ShmReady packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	std::lock_guard<std::mutex> lock(GetSession().lock);
+	if (GetSession().IsReleased())
+	{
+		FreeMessage(pMessage);
+		return;
+	}
+
+	m_pShmSwitchMessage = pMessage;
+	GetSession().sendQ.push(pMessage);
+}
+
+void NetClient::PostShmSend()
+{
+	std::lock_guard<std::mutex> lock(GetSession().lock);
+	if (GetSession().IsReleased())
+		return;
+
+	MESSAGE* pMessage = m_pShmCarry;
+	m_pShmCarry = nullptr;
+
+	while (pMessage != nullptr || GetSession().sendQ.try_pop(pMessage))
+	{
+		if (!m_ShmChannel.Write(pMessage))
+		{
+			m_pShmCarry = pMessage;
+			return;
+		}
+
+		FreeMessage(pMessage);
+		pMessage = nullptr;
+	}
+}
+
+void NetClient::OnIntegrityOffer()
+{
+	if (!m_UseIntegrity)
+		return;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_IntegrityReady packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	std::lock_guard<std::mutex> lock(GetSession().lock);
+	if (GetSession().IsReleased())
+	{
+		FreeMessage(pMessage);
+		return;
+	}
+
+	m_pIntegritySwitchMessage = pMessage;
+	GetSession().sendQ.push(pMessage);
+}
+
+void NetClient::OnCryptoOffer(SystemPacketHeader* pPacket)
+{
+	if (!m_UseEncryption)
+		return;
+
+	SystemPacket_CryptoOffer* pOffer = static_cast<SystemPacket_CryptoOffer*>(pPacket);
+	SystemPacket_CryptoReady  packet;
+
+	unsigned char privateKey[X25519_KEY_SIZE];
+	unsigned char sharedSecret[X25519_KEY_SIZE];
+	bool		  agreed = X25519GenerateKeyPair(privateKey, packet.m_PublicKey) && X25519SharedSecret(privateKey, pOffer->m_PublicKey, sharedSecret);
+	SecureZeroMemory(privateKey, sizeof(privateKey));
+
+	if (!agreed)
+		return;
+
+	DeriveSessionKeys(sharedSecret, m_SendCrypto.key, m_RecvCrypto.key);
+	SecureZeroMemory(sharedSecret, sizeof(sharedSecret));
+
+	m_SendCrypto.counter = 0;
+	m_RecvCrypto.counter = 0;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	std::lock_guard<std::mutex> lock(GetSession().lock);
+	if (GetSession().IsReleased())
+	{
+		FreeMessage(pMessage);
+		return;
+	}
+
+	m_pCryptoSwitchMessage = pMessage;
+	GetSession().sendQ.push(pMessage);
+}
+
+bool NetClient::SealFrame(MESSAGE* pMessage)
+{
+	if (m_IntegritySend && !pMessage->SealIntegrity())
+		return false;
+
+	if (m_EncryptSend && !pMessage->Encrypt(m_SendCrypto))
+		return false;
+
+	return true;
+}
+
+bool NetClient::OpenFrame(MESSAGE* pMessage)
+{
+	if (m_DecryptRecv && !pMessage->Decrypt(m_RecvCrypto))
+		return false;
+
+	if (m_IntegrityRecv && !pMessage->CheckIntegrity())
+		return false;
+
+	return true;
+}
+
 bool NetClient::Initialize()
 {
 	if (m_AlreadyInitialized == true)
@@ -363,6 +919,7 @@ bool NetClient::Initialize()
 		m_vecWorkerThread.push_back(std::thread([this]() { WorkerThread(); }));
 
 	m_SendThread = std::thread([this]() { SendThread(); });
+	m_ShmThread = std::thread([this]() { ShmThread(); });
 
 	m_AlreadyInitialized = true;
 
@@ -434,8 +991,23 @@ void DisconnectThread()
 	}
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+	// --replay <capture path prefix> [connections] [speed, 0 for max]
+	if (argc > 2 && std::strcmp(argv[1], "--replay") == 0)
+	{
+		int	   connectionCount = argc > 3 ? std::atoi(argv[3]) : 1;
+		double speed = argc > 4 ? std::atof(argv[4]) : 1.0;
+		return RunCaptureReplay(argv[2], "127.0.0.1", 27931, connectionCount, speed) ? 0 : 1;
+	}
+
+	// --rpc-test [calls] checks rpc against a NetServer on this host once the link is on shared memory
+	if (argc > 1 && std::strcmp(argv[1], "--rpc-test") == 0)
+	{
+		int callCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+		return RunRpcRoundTrip("127.0.0.1", 27931, callCount) ? 0 : 1;
+	}
+
 	startTime = std::chrono::high_resolution_clock::now();
 	bool f = nl.Connect("127.0.0.1", 27931, false);
 	if (f == false)
@@ -443,6 +1015,8 @@ int main()
 		std::cout << "Connect Fail~" << std::endl;
 	}
 
+	nl.ConnectUdp("127.0.0.1", 27931);
+
 	std::thread th1([]() { SendingThread(); });
 	std::thread th2([]() { DisconnectThread(); });
 
@@ -6,6 +6,8 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <future>
 #include <concurrent_unordered_map.h>
 #include <concurrent_queue.h>
 
@@ -13,6 +15,14 @@
 #include "ThreadLocalMemoryPool.h"
 #include "RingBuffer.h"
 #include "Protocol.h"
+#include "GlobalValue.h"
+#include "UdpTransport.h"
+#include "ShmTransport.h"
+#include "LoopbackTransport.h"
+#include "X25519.h"
+#include "SystemPacketProcessor.h"
+#include "RpcCallTable.h"
+#include "MessageChain.h"
 
 class SESSION
 {
@@ -29,7 +39,10 @@ public:
 		ZeroMemory(&recvOverlapped, sizeof(recvOverlapped));
 		ZeroMemory(&sendOverlapped, sizeof(sendOverlapped));
 		recvQ.Reset();
+		pLargeMessage = nullptr;
+		largeReceivedSize = 0;
 		ioCount = 0;
+		pLoopback = nullptr;
 	}
 
 public:
@@ -47,14 +60,22 @@ public:
 	void SetReleaseState(bool release) { releaseFlag = release; }
 
 public:
-	SOCKET									sessionSocket;
-	bool									releaseFlag;
-	OVERLAPPED								recvOverlapped;
-	OVERLAPPED								sendOverlapped;
-	RingBuffer								recvQ;
-	std::atomic<int>						ioCount;
-	std::mutex								lock;
+	// grouped by writer, same as the server side SESSION
+	alignas(CACHE_LINE_SIZE) SOCKET	sessionSocket;
+	bool							releaseFlag;
+	LoopbackPipe*					pLoopback;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<int> ioCount;
+
+	alignas(CACHE_LINE_SIZE) OVERLAPPED	recvOverlapped;
+	RingBuffer							recvQ;
+	MESSAGE*							pLargeMessage;
+	int									largeReceivedSize;
+
+	alignas(CACHE_LINE_SIZE) std::mutex		lock;
 	Concurrency::concurrent_queue<MESSAGE*> sendQ;
+
+	alignas(CACHE_LINE_SIZE) OVERLAPPED		sendOverlapped;
 	Concurrency::concurrent_queue<MESSAGE*> sendPendingQ;
 };
 
@@ -63,9 +84,31 @@ class NetClient
 public:
 	NetClient();
 	bool Connect(const char* ip, short port, bool tcpNagleOn);
+
+	bool ConnectLoopback(LoopbackNetwork* pNetwork);
 	bool Send(MESSAGE* pMessage);
 	bool Disconnect();
 
+	bool ConnectUdp(const char* ip, short port);
+	bool SendDatagram(MESSAGE* pMessage, DELIVERY delivery);
+	void SetUdpLossSimulation(int lossPercent, int delayMs) { m_UdpSocket.SetLossSimulation(lossPercent, delayMs); }
+
+	// 0 turns it off
+	void SetLargeFrameThreshold(int threshold) { m_LargeFrameThreshold = threshold; }
+
+	// on by default
+	void EnableIntegrity(bool enable) { m_UseIntegrity = enable; }
+
+	// on by default, the server's key is not authenticated
+	void EnableEncryption(bool enable) { m_UseEncryption = enable; }
+
+	// the callback runs exactly once
+	bool					Call(int method, const void* pBody, int bodySize, DWORD timeoutMs, RPC_CALLBACK callback);
+	std::future<RPC_RESULT> Call(int method, const void* pBody, int bodySize, DWORD timeoutMs);
+
+	// both directions have moved from TCP to the shared memory rings
+	bool IsSharedMemoryActive() const { return m_ShmSendActive && m_ShmRecvActive; }
+
 	MESSAGE* AllocateMessage();
 	bool	 FreeMessage(MESSAGE* pMessage);
 
@@ -73,14 +116,32 @@ public:
 	virtual void OnRecv(MESSAGE* pMessage) = 0;
 	virtual void OnDisconnect() = 0;
 
+	// frees what is left in the chain on return. by default each fragment goes to OnRecv
+	virtual void OnRecvChain(MessageChain& chain);
+
 private:
 	void WorkerThread();
 	void SendThread();
 	void PostRecv();
 	void PostSend();
 	void AfterRecvProcess(DWORD transferredBytes);
+	bool ProcessFrame(MESSAGE* pMessage);
+	void DeliverRecv(MESSAGE* pMessage);
 	void AfterSendProcess();
-
+	void BeginLargeRecv(size_t bufferedSize);
+	bool AfterLargeRecvProcess(DWORD transferredBytes);
+	void UdpThread();
+	void OnUdpBind(SystemPacketHeader* pPacket);
+	void ShmThread();
+	void OnShmOffer(SystemPacketHeader* pPacket);
+	void PostShmSend();
+	void OnIntegrityOffer();
+	void OnCryptoOffer(SystemPacketHeader* pPacket);
+	void OnRpcResponse(SystemPacketHeader* pPacket);
+	bool SealFrame(MESSAGE* pMessage);
+	bool OpenFrame(MESSAGE* pMessage);
+
+	void ShutdownSession();
 	void ReleaseSession();
 	bool PreventRelease();
 	bool UnlockPrevent();
@@ -95,9 +156,46 @@ private:
 	SESSION m_Session;
 	HANDLE  m_hIocp;
 	bool	m_AlreadyInitialized;
+	int		m_LargeFrameThreshold;
 
 	std::vector<std::thread> m_vecWorkerThread;
 	std::thread				 m_SendThread;
 
 	ThreadLocalMemoryPool<MESSAGE> m_MessagePool;
+
+	SystemPacketProcessor m_SystemPacketProcessor;
+
+	MessageChain m_RecvChain;
+
+	RpcCallTable m_RpcCalls;
+
+	UdpSocket			   m_UdpSocket;
+	UdpPeer				   m_UdpPeer;
+	SOCKADDR_IN			   m_UdpServerAddress;
+	std::atomic<bool>	   m_UdpConnected;
+	std::thread			   m_UdpThread;
+	UdpPeer::ALLOCATE_FUNC m_UdpAllocate;
+	UdpPeer::FREE_FUNC	   m_UdpFree;
+	std::vector<MESSAGE*>  m_vecUdpDelivered;
+
+	ShmChannel				m_ShmChannel;
+	std::mutex				m_ShmLock;
+	std::condition_variable m_ShmActiveCond;
+	std::thread				m_ShmThread;
+	std::atomic<bool> m_ShmSendActive;
+	std::atomic<bool> m_ShmRecvActive;
+	MESSAGE*		  m_pShmSwitchMessage;
+	MESSAGE*		  m_pShmCarry;
+
+	bool	 m_UseIntegrity;
+	bool	 m_IntegrityRecv;
+	bool	 m_IntegritySend;
+	MESSAGE* m_pIntegritySwitchMessage;
+
+	bool	   m_UseEncryption;
+	bool	   m_DecryptRecv;
+	bool	   m_EncryptSend;
+	AEAD_STATE m_RecvCrypto;
+	AEAD_STATE m_SendCrypto;
+	MESSAGE*   m_pCryptoSwitchMessage;
 };
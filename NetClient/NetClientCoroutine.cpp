@@ -0,0 +1,25 @@
+#include "NetClientCoroutine.h"
+
+bool CoNetClient::ConnectAwaiter::await_suspend(coro::coroutine_handle<> handle)
+{
+	this->handle = handle;
+
+	// no pool thread, the caller goes on with result false
+	return TrySubmitThreadpoolCallback(OnConnectWork, this, nullptr) != FALSE;
+}
+
+void CALLBACK CoNetClient::OnConnectWork(PTP_CALLBACK_INSTANCE pInstance, PVOID pContext)
+{
+	ConnectAwaiter* pAwaiter = static_cast<ConnectAwaiter*>(pContext);
+	CoNetClient*	pClient = pAwaiter->pClient;
+
+	// frames left from the previous connection are dropped
+	MESSAGE* pMessage = nullptr;
+	while ((pMessage = pClient->m_Inbox.TakeQueued()) != nullptr)
+		pClient->FreeMessage(pMessage);
+
+	pClient->m_Inbox.Reopen();
+
+	pAwaiter->result = pClient->NetClient::Connect(pAwaiter->ip, pAwaiter->port, pAwaiter->tcpNagleOn);
+	pAwaiter->handle.resume();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "NetClient.h"
+#include "Coroutine.h"
+
+// Recv resumes on the worker that completed the recv, Connect on a thread pool thread
+class CoNetClient : public NetClient
+{
+public:
+	struct ConnectAwaiter
+	{
+		CoNetClient*			 pClient;
+		const char*				 ip;
+		short					 port;
+		bool					 tcpNagleOn;
+		bool					 result;
+		coro::coroutine_handle<> handle;
+
+		bool await_ready() { return false; }
+		bool await_suspend(coro::coroutine_handle<> handle);
+		bool await_resume() { return result; }
+	};
+
+	ConnectAwaiter Connect(const char* ip, short port, bool tcpNagleOn) { return ConnectAwaiter{ this, ip, port, tcpNagleOn, false, nullptr }; }
+
+	// nullptr once disconnected
+	MessageInbox::RecvAwaiter Recv() { return m_Inbox.Recv(); }
+	ReadyAwaiter<bool>		  Send(MESSAGE* pMessage) { return ReadyAwaiter<bool>{ NetClient::Send(pMessage) }; }
+
+private:
+	void OnConnect() {}
+	void OnRecv(MESSAGE* pMessage) { m_Inbox.Deliver(pMessage); }
+	void OnDisconnect() { m_Inbox.Close(); }
+
+	static void CALLBACK OnConnectWork(PTP_CALLBACK_INSTANCE pInstance, PVOID pContext);
+
+private:
+	MessageInbox m_Inbox;
+};
@@ -0,0 +1,66 @@
+#include "NetClient.h"
+#include "SystemPacket.h"
+
+// registered before the request is queued
+bool NetClient::Call(int method, const void* pBody, int bodySize, DWORD timeoutMs, RPC_CALLBACK callback)
+{
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return false;
+
+	const RPC_CALL_ID callId = m_RpcCalls.Add(std::move(callback), timeoutMs);
+
+	SystemPacket_RpcRequest packet;
+	packet.m_CallId = callId;
+	packet.m_Method = method;
+	packet.SetSize(sizeof(packet) + bodySize);
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	if (!pMessage->put(&packet, sizeof(packet)) || (bodySize > 0 && !pMessage->put(pBody, bodySize)))
+	{
+		m_RpcCalls.Remove(callId);
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	// Send frees the frame when it fails
+	if (!Send(pMessage))
+	{
+		m_RpcCalls.Remove(callId);
+		return false;
+	}
+
+	return true;
+}
+
+// the future is always set, with DISCONNECTED if the request couldn't be sent
+std::future<RPC_RESULT> NetClient::Call(int method, const void* pBody, int bodySize, DWORD timeoutMs)
+{
+	auto					pPromise = std::make_shared<std::promise<RPC_RESULT>>();
+	std::future<RPC_RESULT> result = pPromise->get_future();
+
+	bool called = Call(method, pBody, bodySize, timeoutMs, [pPromise](RPC_STATUS status, const char* pReply, int replySize) {
+		RPC_RESULT reply;
+		reply.status = status;
+		if (pReply != nullptr)
+			reply.body.assign(pReply, pReply + replySize);
+
+		pPromise->set_value(std::move(reply));
+	});
+
+	if (!called)
+		pPromise->set_value(RPC_RESULT{ RPC_STATUS::DISCONNECTED, {} });
+
+	return result;
+}
+
+void NetClient::OnRpcResponse(SystemPacketHeader* pPacket)
+{
+	SystemPacket_RpcResponse* pResponse = static_cast<SystemPacket_RpcResponse*>(pPacket);
+
+	const int bodySize = pResponse->GetSize() - (int)sizeof(SystemPacket_RpcResponse);
+	if (bodySize < 0)
+		return;
+
+	m_RpcCalls.Complete(pResponse->m_CallId, pResponse->m_Status, (const char*)(pResponse + 1), bodySize);
+}
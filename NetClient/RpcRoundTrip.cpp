@@ -0,0 +1,98 @@
+#include "RpcRoundTrip.h"
+
+#include <cstring>
+#include <string>
+
+namespace
+{
+constexpr DWORD RPC_TEST_SWITCH_TIMEOUT_MS = 5000;
+constexpr DWORD RPC_TEST_CALL_TIMEOUT_MS = 2000;
+
+class RpcTestClient : public NetClient
+{
+public:
+	RpcTestClient()
+	: m_RecvCount(0)
+	{
+	}
+
+	long long GetRecvCount() const { return m_RecvCount; }
+
+private:
+	void OnConnect() {}
+	void OnDisconnect() {}
+
+	void OnRecv(MESSAGE* pMessage)
+	{
+		++m_RecvCount;
+		FreeMessage(pMessage);
+	}
+
+private:
+	std::atomic<long long> m_RecvCount;
+};
+
+bool WaitUntil(const std::function<bool()>& condition, DWORD timeoutMs)
+{
+	const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	while (!condition())
+	{
+		if (GetTickCount64() >= deadline)
+			return false;
+
+		Sleep(10);
+	}
+
+	return true;
+}
+} // namespace
+
+bool RunRpcRoundTrip(const char* ip, short port, int callCount)
+{
+	// NetClient never joins its threads, so the client is left to the process exit
+	RpcTestClient* pClient = new RpcTestClient;
+	if (!pClient->Connect(ip, port, false))
+	{
+		std::cout << "rpc test connect fail" << std::endl;
+		return false;
+	}
+
+	if (!WaitUntil([pClient]() { return pClient->IsSharedMemoryActive(); }, RPC_TEST_SWITCH_TIMEOUT_MS))
+	{
+		std::cout << "rpc test : the link never moved to shared memory" << std::endl;
+		return false;
+	}
+
+	for (int i = 0; i < callCount; ++i)
+	{
+		const std::string body = "rpc round trip " + std::to_string(i);
+
+		RPC_RESULT result = pClient->Call(RPC_ECHO_METHOD, body.data(), (int)body.size(), RPC_TEST_CALL_TIMEOUT_MS).get();
+		if (result.status != RPC_STATUS::OK)
+		{
+			std::cout << "rpc test call " << i << " failed : " << (int)result.status << std::endl;
+			return false;
+		}
+
+		if (result.body.size() != body.size() || std::memcmp(result.body.data(), body.data(), body.size()) != 0)
+		{
+			std::cout << "rpc test call " << i << " came back with a different body" << std::endl;
+			return false;
+		}
+	}
+
+	MESSAGE* pMessage = pClient->AllocateMessage();
+	if (pMessage == nullptr)
+		return false;
+
+	const int value = callCount;
+	pMessage->put(&value, sizeof(value));
+	if (!pClient->Send(pMessage) || !WaitUntil([pClient]() { return pClient->GetRecvCount() > 0; }, RPC_TEST_CALL_TIMEOUT_MS))
+	{
+		std::cout << "rpc test : the user frame was not echoed" << std::endl;
+		return false;
+	}
+
+	std::cout << "rpc test : " << callCount << " calls over shared memory ok" << std::endl;
+	return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "NetClient.h"
+
+// method the test server answers by replying with the request body as it came
+constexpr int RPC_ECHO_METHOD = 1;
+
+// callCount echo calls and one user frame over the shared memory ring
+bool RunRpcRoundTrip(const char* ip, short port, int callCount);
@@ -0,0 +1,398 @@
+#include "ChaCha20Poly1305.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr unsigned int CHACHA20_CONSTANT[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 }; // "expand 32-byte k"
+constexpr int		   CHACHA20_BLOCK_SIZE = 64;
+constexpr int		   CHACHA20_DOUBLE_ROUNDS = 10;
+
+unsigned int Load32(const unsigned char* pSource)
+{
+	return (unsigned int)pSource[0] | ((unsigned int)pSource[1] << 8) | ((unsigned int)pSource[2] << 16) | ((unsigned int)pSource[3] << 24);
+}
+
+void Store32(unsigned char* pDest, unsigned int value)
+{
+	pDest[0] = (unsigned char)value;
+	pDest[1] = (unsigned char)(value >> 8);
+	pDest[2] = (unsigned char)(value >> 16);
+	pDest[3] = (unsigned char)(value >> 24);
+}
+
+void Store64(unsigned char* pDest, unsigned long long value)
+{
+	Store32(pDest, (unsigned int)value);
+	Store32(pDest + 4, (unsigned int)(value >> 32));
+}
+
+unsigned int Rotate(unsigned int value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+void QuarterRound(unsigned int* x, int a, int b, int c, int d)
+{
+	x[a] += x[b];
+	x[d] = Rotate(x[d] ^ x[a], 16);
+	x[c] += x[d];
+	x[b] = Rotate(x[b] ^ x[c], 12);
+	x[a] += x[b];
+	x[d] = Rotate(x[d] ^ x[a], 8);
+	x[c] += x[d];
+	x[b] = Rotate(x[b] ^ x[c], 7);
+}
+
+void DoubleRounds(unsigned int* x)
+{
+	for (int round = 0; round < CHACHA20_DOUBLE_ROUNDS; ++round)
+	{
+		QuarterRound(x, 0, 4, 8, 12);
+		QuarterRound(x, 1, 5, 9, 13);
+		QuarterRound(x, 2, 6, 10, 14);
+		QuarterRound(x, 3, 7, 11, 15);
+		QuarterRound(x, 0, 5, 10, 15);
+		QuarterRound(x, 1, 6, 11, 12);
+		QuarterRound(x, 2, 7, 8, 13);
+		QuarterRound(x, 3, 4, 9, 14);
+	}
+}
+
+// state words : constant, key, block counter, nonce
+void InitState(unsigned int* state, const unsigned char* pKey, unsigned int blockCounter, unsigned long long nonce)
+{
+	for (int i = 0; i < 4; ++i)
+		state[i] = CHACHA20_CONSTANT[i];
+
+	for (int i = 0; i < 8; ++i)
+		state[4 + i] = Load32(pKey + i * 4);
+
+	state[12] = blockCounter;
+	state[13] = 0;
+	state[14] = (unsigned int)nonce;
+	state[15] = (unsigned int)(nonce >> 32);
+}
+
+void Block(const unsigned int* state, unsigned char* pOut)
+{
+	unsigned int x[16];
+	std::memcpy(x, state, sizeof(x));
+
+	DoubleRounds(x);
+
+	for (int i = 0; i < 16; ++i)
+		Store32(pOut + i * 4, x[i] + state[i]);
+}
+
+#if defined(_M_X64) || defined(_M_IX86)
+__m128i RotateVector(__m128i value, int bits)
+{
+	return _mm_or_si128(_mm_slli_epi32(value, bits), _mm_srli_epi32(value, 32 - bits));
+}
+
+void QuarterRoundVector(__m128i* v, int a, int b, int c, int d)
+{
+	v[a] = _mm_add_epi32(v[a], v[b]);
+	v[d] = RotateVector(_mm_xor_si128(v[d], v[a]), 16);
+	v[c] = _mm_add_epi32(v[c], v[d]);
+	v[b] = RotateVector(_mm_xor_si128(v[b], v[c]), 12);
+	v[a] = _mm_add_epi32(v[a], v[b]);
+	v[d] = RotateVector(_mm_xor_si128(v[d], v[a]), 8);
+	v[c] = _mm_add_epi32(v[c], v[d]);
+	v[b] = RotateVector(_mm_xor_si128(v[b], v[c]), 7);
+}
+
+// four consecutive blocks, lane n of every vector belongs to block n
+void XorFourBlocks(unsigned int* state, unsigned char* pData)
+{
+	__m128i origin[16];
+	__m128i v[16];
+	for (int i = 0; i < 16; ++i)
+		origin[i] = _mm_set1_epi32((int)state[i]);
+
+	origin[12] = _mm_add_epi32(origin[12], _mm_set_epi32(3, 2, 1, 0));
+
+	for (int i = 0; i < 16; ++i)
+		v[i] = origin[i];
+
+	for (int round = 0; round < CHACHA20_DOUBLE_ROUNDS; ++round)
+	{
+		QuarterRoundVector(v, 0, 4, 8, 12);
+		QuarterRoundVector(v, 1, 5, 9, 13);
+		QuarterRoundVector(v, 2, 6, 10, 14);
+		QuarterRoundVector(v, 3, 7, 11, 15);
+		QuarterRoundVector(v, 0, 5, 10, 15);
+		QuarterRoundVector(v, 1, 6, 11, 12);
+		QuarterRoundVector(v, 2, 7, 8, 13);
+		QuarterRoundVector(v, 3, 4, 9, 14);
+	}
+
+	for (int i = 0; i < 16; ++i)
+		v[i] = _mm_add_epi32(v[i], origin[i]);
+
+	// transpose each group of four words back into block order
+	for (int group = 0; group < 4; ++group)
+	{
+		__m128i* w = v + group * 4;
+		__m128i	 t0 = _mm_unpacklo_epi32(w[0], w[1]);
+		__m128i	 t1 = _mm_unpacklo_epi32(w[2], w[3]);
+		__m128i	 t2 = _mm_unpackhi_epi32(w[0], w[1]);
+		__m128i	 t3 = _mm_unpackhi_epi32(w[2], w[3]);
+
+		__m128i blockWords[4] = { _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3) };
+		for (int block = 0; block < 4; ++block)
+		{
+			__m128i* pCursor = (__m128i*)(pData + block * CHACHA20_BLOCK_SIZE + group * 16);
+			_mm_storeu_si128(pCursor, _mm_xor_si128(_mm_loadu_si128(pCursor), blockWords[block]));
+		}
+	}
+
+	state[12] += 4;
+}
+#endif
+
+void ChaCha20Xor(const unsigned char* pKey, unsigned int blockCounter, unsigned long long nonce, unsigned char* pData, size_t size)
+{
+	unsigned int state[16];
+	InitState(state, pKey, blockCounter, nonce);
+
+#if defined(_M_X64) || defined(_M_IX86)
+	for (; size >= CHACHA20_BLOCK_SIZE * 4; size -= CHACHA20_BLOCK_SIZE * 4, pData += CHACHA20_BLOCK_SIZE * 4)
+		XorFourBlocks(state, pData);
+#endif
+
+	unsigned char keyStream[CHACHA20_BLOCK_SIZE];
+	while (size > 0)
+	{
+		Block(state, keyStream);
+		++state[12];
+
+		size_t blockSize = size < CHACHA20_BLOCK_SIZE ? size : CHACHA20_BLOCK_SIZE;
+		for (size_t i = 0; i < blockSize; ++i)
+			pData[i] ^= keyStream[i];
+
+		pData += blockSize;
+		size -= blockSize;
+	}
+}
+
+class Poly1305
+{
+public:
+	explicit Poly1305(const unsigned char* pKey)
+	: m_Leftover(0)
+	{
+		m_R[0] = Load32(pKey + 0) & 0x3ffffff;
+		m_R[1] = (Load32(pKey + 3) >> 2) & 0x3ffff03;
+		m_R[2] = (Load32(pKey + 6) >> 4) & 0x3ffc0ff;
+		m_R[3] = (Load32(pKey + 9) >> 6) & 0x3f03fff;
+		m_R[4] = (Load32(pKey + 12) >> 8) & 0x00fffff;
+
+		for (int i = 0; i < 5; ++i)
+			m_H[i] = 0;
+
+		for (int i = 0; i < 4; ++i)
+			m_Pad[i] = Load32(pKey + 16 + i * 4);
+	}
+
+	void Update(const unsigned char* pData, size_t size)
+	{
+		if (m_Leftover > 0)
+		{
+			while (size > 0 && m_Leftover < 16)
+			{
+				m_Buffer[m_Leftover++] = *pData++;
+				--size;
+			}
+
+			if (m_Leftover < 16)
+				return;
+
+			Blocks(m_Buffer, 16, 1 << 24);
+			m_Leftover = 0;
+		}
+
+		size_t fullSize = size & ~(size_t)15;
+		Blocks(pData, fullSize, 1 << 24);
+		pData += fullSize;
+		size -= fullSize;
+
+		while (size-- > 0)
+			m_Buffer[m_Leftover++] = *pData++;
+	}
+
+	// the AEAD pads every section to 16 bytes
+	void PadToBlock()
+	{
+		static const unsigned char zero[16] = {};
+		if (m_Leftover > 0)
+			Update(zero, 16 - m_Leftover);
+	}
+
+	void Finish(unsigned char* pTag)
+	{
+		if (m_Leftover > 0)
+		{
+			m_Buffer[m_Leftover++] = 1;
+			while (m_Leftover < 16)
+				m_Buffer[m_Leftover++] = 0;
+
+			Blocks(m_Buffer, 16, 0);
+		}
+
+		unsigned int h0 = m_H[0], h1 = m_H[1], h2 = m_H[2], h3 = m_H[3], h4 = m_H[4];
+		unsigned int carry;
+
+		carry = h1 >> 26; h1 &= 0x3ffffff; h2 += carry;
+		carry = h2 >> 26; h2 &= 0x3ffffff; h3 += carry;
+		carry = h3 >> 26; h3 &= 0x3ffffff; h4 += carry;
+		carry = h4 >> 26; h4 &= 0x3ffffff; h0 += carry * 5;
+		carry = h0 >> 26; h0 &= 0x3ffffff; h1 += carry;
+
+		// h - p, kept only if it did not go negative
+		unsigned int g0 = h0 + 5;	  carry = g0 >> 26; g0 &= 0x3ffffff;
+		unsigned int g1 = h1 + carry; carry = g1 >> 26; g1 &= 0x3ffffff;
+		unsigned int g2 = h2 + carry; carry = g2 >> 26; g2 &= 0x3ffffff;
+		unsigned int g3 = h3 + carry; carry = g3 >> 26; g3 &= 0x3ffffff;
+		unsigned int g4 = h4 + carry - (1 << 26);
+
+		unsigned int mask = (g4 >> 31) - 1;
+		h0 = (h0 & ~mask) | (g0 & mask);
+		h1 = (h1 & ~mask) | (g1 & mask);
+		h2 = (h2 & ~mask) | (g2 & mask);
+		h3 = (h3 & ~mask) | (g3 & mask);
+		h4 = (h4 & ~mask) | (g4 & mask);
+
+		h0 = h0 | (h1 << 26);
+		h1 = (h1 >> 6) | (h2 << 20);
+		h2 = (h2 >> 12) | (h3 << 14);
+		h3 = (h3 >> 18) | (h4 << 8);
+
+		unsigned long long sum;
+		sum = (unsigned long long)h0 + m_Pad[0];				Store32(pTag + 0, (unsigned int)sum);
+		sum = (unsigned long long)h1 + m_Pad[1] + (sum >> 32); Store32(pTag + 4, (unsigned int)sum);
+		sum = (unsigned long long)h2 + m_Pad[2] + (sum >> 32); Store32(pTag + 8, (unsigned int)sum);
+		sum = (unsigned long long)h3 + m_Pad[3] + (sum >> 32); Store32(pTag + 12, (unsigned int)sum);
+	}
+
+private:
+	void Blocks(const unsigned char* pData, size_t size, unsigned int highBit)
+	{
+		const unsigned int r0 = m_R[0], r1 = m_R[1], r2 = m_R[2], r3 = m_R[3], r4 = m_R[4];
+		const unsigned int s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+
+		unsigned int h0 = m_H[0], h1 = m_H[1], h2 = m_H[2], h3 = m_H[3], h4 = m_H[4];
+
+		for (; size >= 16; size -= 16, pData += 16)
+		{
+			h0 += Load32(pData + 0) & 0x3ffffff;
+			h1 += (Load32(pData + 3) >> 2) & 0x3ffffff;
+			h2 += (Load32(pData + 6) >> 4) & 0x3ffffff;
+			h3 += (Load32(pData + 9) >> 6) & 0x3ffffff;
+			h4 += (Load32(pData + 12) >> 8) | highBit;
+
+			unsigned long long d0 = (unsigned long long)h0 * r0 + (unsigned long long)h1 * s4 + (unsigned long long)h2 * s3 + (unsigned long long)h3 * s2 + (unsigned long long)h4 * s1;
+			unsigned long long d1 = (unsigned long long)h0 * r1 + (unsigned long long)h1 * r0 + (unsigned long long)h2 * s4 + (unsigned long long)h3 * s3 + (unsigned long long)h4 * s2;
+			unsigned long long d2 = (unsigned long long)h0 * r2 + (unsigned long long)h1 * r1 + (unsigned long long)h2 * r0 + (unsigned long long)h3 * s4 + (unsigned long long)h4 * s3;
+			unsigned long long d3 = (unsigned long long)h0 * r3 + (unsigned long long)h1 * r2 + (unsigned long long)h2 * r1 + (unsigned long long)h3 * r0 + (unsigned long long)h4 * s4;
+			unsigned long long d4 = (unsigned long long)h0 * r4 + (unsigned long long)h1 * r3 + (unsigned long long)h2 * r2 + (unsigned long long)h3 * r1 + (unsigned long long)h4 * r0;
+
+			unsigned int carry;
+			carry = (unsigned int)(d0 >> 26); h0 = (unsigned int)d0 & 0x3ffffff;
+			d1 += carry; carry = (unsigned int)(d1 >> 26); h1 = (unsigned int)d1 & 0x3ffffff;
+			d2 += carry; carry = (unsigned int)(d2 >> 26); h2 = (unsigned int)d2 & 0x3ffffff;
+			d3 += carry; carry = (unsigned int)(d3 >> 26); h3 = (unsigned int)d3 & 0x3ffffff;
+			d4 += carry; carry = (unsigned int)(d4 >> 26); h4 = (unsigned int)d4 & 0x3ffffff;
+			h0 += carry * 5; carry = h0 >> 26; h0 &= 0x3ffffff;
+			h1 += carry;
+		}
+
+		m_H[0] = h0;
+		m_H[1] = h1;
+		m_H[2] = h2;
+		m_H[3] = h3;
+		m_H[4] = h4;
+	}
+
+private:
+	unsigned int  m_R[5];
+	unsigned int  m_H[5];
+	unsigned int  m_Pad[4];
+	unsigned char m_Buffer[16];
+	size_t		  m_Leftover;
+};
+
+void ComputeTag(const unsigned char* pKey, unsigned long long nonce, const void* pAad, size_t aadSize, const unsigned char* pCipher, size_t size, unsigned char* pTag)
+{
+	// the one time Poly1305 key is block 0 of the keystream, the payload starts at block 1
+	unsigned int  state[16];
+	unsigned char polyKey[CHACHA20_BLOCK_SIZE];
+	InitState(state, pKey, 0, nonce);
+	Block(state, polyKey);
+
+	unsigned char lengths[16];
+	Store64(lengths, aadSize);
+	Store64(lengths + 8, size);
+
+	Poly1305 poly(polyKey);
+	poly.Update(static_cast<const unsigned char*>(pAad), aadSize);
+	poly.PadToBlock();
+	poly.Update(pCipher, size);
+	poly.PadToBlock();
+	poly.Update(lengths, sizeof(lengths));
+	poly.Finish(pTag);
+}
+} // namespace
+
+void ChaCha20Poly1305Seal(const unsigned char* pKey, unsigned long long nonce, const void* pAad, size_t aadSize, void* pData, size_t size, unsigned char* pTag)
+{
+	unsigned char* pCursor = static_cast<unsigned char*>(pData);
+
+	ChaCha20Xor(pKey, 1, nonce, pCursor, size);
+	ComputeTag(pKey, nonce, pAad, aadSize, pCursor, size, pTag);
+}
+
+bool ChaCha20Poly1305Open(const unsigned char* pKey, unsigned long long nonce, const void* pAad, size_t aadSize, void* pData, size_t size, const unsigned char* pTag)
+{
+	unsigned char* pCursor = static_cast<unsigned char*>(pData);
+
+	unsigned char expected[POLY1305_TAG_SIZE];
+	ComputeTag(pKey, nonce, pAad, aadSize, pCursor, size, expected);
+
+	// constant time
+	unsigned char diff = 0;
+	for (int i = 0; i < POLY1305_TAG_SIZE; ++i)
+		diff |= expected[i] ^ pTag[i];
+
+	if (diff != 0)
+		return false;
+
+	ChaCha20Xor(pKey, 1, nonce, pCursor, size);
+	return true;
+}
+
+void DeriveSessionKeys(const unsigned char* pSharedSecret, unsigned char* pClientToServerKey, unsigned char* pServerToClientKey)
+{
+	// HChaCha20 with a zero nonce : the rounds without the feed forward, words 0-3 and 12-15
+	unsigned int state[16];
+	InitState(state, pSharedSecret, 0, 0);
+	DoubleRounds(state);
+
+	unsigned char masterKey[CHACHA20_KEY_SIZE];
+	for (int i = 0; i < 4; ++i)
+	{
+		Store32(masterKey + i * 4, state[i]);
+		Store32(masterKey + 16 + i * 4, state[12 + i]);
+	}
+
+	unsigned char keyStream[CHACHA20_BLOCK_SIZE];
+	InitState(state, masterKey, 0, 0);
+	Block(state, keyStream);
+
+	std::memcpy(pClientToServerKey, keyStream, CHACHA20_KEY_SIZE);
+	std::memcpy(pServerToClientKey, keyStream + CHACHA20_KEY_SIZE, CHACHA20_KEY_SIZE);
+}
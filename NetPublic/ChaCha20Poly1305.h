@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+constexpr int CHACHA20_KEY_SIZE = 32;
+constexpr int POLY1305_TAG_SIZE = 16;
+
+// the nonce is the frame counter, TCP keeps both ends in step
+struct AEAD_STATE
+{
+	unsigned char	   key[CHACHA20_KEY_SIZE];
+	unsigned long long counter;
+};
+
+// RFC 8439, in place. the 96 bit nonce is built from a 64 bit counter
+void ChaCha20Poly1305Seal(const unsigned char* pKey, unsigned long long nonce, const void* pAad, size_t aadSize, void* pData, size_t size, unsigned char* pTag);
+bool ChaCha20Poly1305Open(const unsigned char* pKey, unsigned long long nonce, const void* pAad, size_t aadSize, void* pData, size_t size, const unsigned char* pTag);
+
+// HChaCha20 then one ChaCha20 block
+void DeriveSessionKeys(const unsigned char* pSharedSecret, unsigned char* pClientToServerKey, unsigned char* pServerToClientKey);
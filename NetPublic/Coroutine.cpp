@@ -0,0 +1,174 @@
+#include "Coroutine.h"
+
+namespace
+{
+constexpr int FRAME_CLASS_COUNT = 8; // 64 bytes to 8KB, larger frames go straight to the heap
+constexpr int FRAME_MIN_SHIFT = 6;
+constexpr int FRAME_CACHE_LIMIT = 1024; // per class and thread, the rest is returned to the heap
+
+struct FREE_FRAME
+{
+	FREE_FRAME* pNext;
+};
+
+struct FRAME_CACHE
+{
+	FREE_FRAME* pHead[FRAME_CLASS_COUNT] = {};
+	int			count[FRAME_CLASS_COUNT] = {};
+
+	~FRAME_CACHE()
+	{
+		for (int sizeClass = 0; sizeClass < FRAME_CLASS_COUNT; ++sizeClass)
+		{
+			while (pHead[sizeClass] != nullptr)
+			{
+				FREE_FRAME* pFrame = pHead[sizeClass];
+				pHead[sizeClass] = pFrame->pNext;
+				::operator delete(pFrame);
+			}
+		}
+	}
+};
+
+thread_local FRAME_CACHE t_FrameCache;
+
+int GetSizeClass(size_t size)
+{
+	int sizeClass = 0;
+	while (sizeClass < FRAME_CLASS_COUNT && ((size_t)1 << (sizeClass + FRAME_MIN_SHIFT)) < size)
+		++sizeClass;
+
+	return sizeClass;
+}
+} // namespace
+
+void* CoroutineFramePool::Allocate(size_t size)
+{
+	const int sizeClass = GetSizeClass(size);
+	if (sizeClass == FRAME_CLASS_COUNT)
+		return ::operator new(size);
+
+	FRAME_CACHE& cache = t_FrameCache;
+	FREE_FRAME*	 pFrame = cache.pHead[sizeClass];
+	if (pFrame == nullptr)
+		return ::operator new((size_t)1 << (sizeClass + FRAME_MIN_SHIFT));
+
+	cache.pHead[sizeClass] = pFrame->pNext;
+	--cache.count[sizeClass];
+	return pFrame;
+}
+
+void CoroutineFramePool::Free(void* pFrame, size_t size)
+{
+	const int	 sizeClass = GetSizeClass(size);
+	FRAME_CACHE& cache = t_FrameCache;
+	if (sizeClass == FRAME_CLASS_COUNT || cache.count[sizeClass] >= FRAME_CACHE_LIMIT)
+	{
+		::operator delete(pFrame);
+		return;
+	}
+
+	FREE_FRAME* pFree = static_cast<FREE_FRAME*>(pFrame);
+	pFree->pNext = cache.pHead[sizeClass];
+	cache.pHead[sizeClass] = pFree;
+	++cache.count[sizeClass];
+}
+
+void MessageInbox::Deliver(MESSAGE* pMessage)
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+	if (!m_Waiter)
+	{
+		m_Queue.push_back(pMessage);
+		return;
+	}
+
+	coro::coroutine_handle<> waiter = m_Waiter;
+	m_Waiter = nullptr;
+	*m_ppWaiterMessage = pMessage;
+	lock.unlock();
+
+	waiter.resume();
+}
+
+// a waiting Recv gets nullptr. frames still queued are left for TakeQueued
+void MessageInbox::Close()
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+	m_Closed = true;
+	if (!m_Waiter)
+		return;
+
+	coro::coroutine_handle<> waiter = m_Waiter;
+	m_Waiter = nullptr;
+	*m_ppWaiterMessage = nullptr;
+	lock.unlock();
+
+	waiter.resume();
+}
+
+void MessageInbox::Reopen()
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_Closed = false;
+}
+
+MESSAGE* MessageInbox::TakeQueued()
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	if (m_Queue.empty())
+		return nullptr;
+
+	MESSAGE* pMessage = m_Queue.front();
+	m_Queue.pop_front();
+	return pMessage;
+}
+
+bool MessageInbox::Wait(coro::coroutine_handle<> handle, MESSAGE** ppMessage)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	if (!m_Queue.empty())
+	{
+		*ppMessage = m_Queue.front();
+		m_Queue.pop_front();
+		return false;
+	}
+
+	if (m_Closed)
+	{
+		*ppMessage = nullptr;
+		return false;
+	}
+
+	m_Waiter = handle;
+	m_ppWaiterMessage = ppMessage;
+	return true;
+}
+
+bool CoSleep::await_suspend(coro::coroutine_handle<> handle)
+{
+	m_Handle = handle;
+
+	PTP_TIMER pTimer = CreateThreadpoolTimer(OnTimer, this, nullptr);
+	if (pTimer == nullptr)
+		return false;
+
+	// relative due time, in 100ns units
+	ULARGE_INTEGER dueTime;
+	dueTime.QuadPart = (ULONGLONG)(-(LONGLONG)m_DelayMs * 10000);
+
+	FILETIME fileDueTime;
+	fileDueTime.dwLowDateTime = dueTime.LowPart;
+	fileDueTime.dwHighDateTime = dueTime.HighPart;
+	SetThreadpoolTimer(pTimer, &fileDueTime, 0, 0);
+	return true;
+}
+
+void CALLBACK CoSleep::OnTimer(PTP_CALLBACK_INSTANCE pInstance, PVOID pContext, PTP_TIMER pTimer)
+{
+	// the awaiter lives in the suspended frame, take what is needed before resuming it
+	coro::coroutine_handle<> handle = static_cast<CoSleep*>(pContext)->m_Handle;
+	CloseThreadpoolTimer(pTimer);
+
+	handle.resume();
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+#include "Protocol.h"
+
+// VS2017 has only the Coroutines TS, users are compiled with /await
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+namespace coro = std;
+#else
+#include <experimental/coroutine>
+namespace coro = std::experimental;
+#endif
+
+// frames are recycled per thread in power of two size classes
+class CoroutineFramePool
+{
+public:
+	static void* Allocate(size_t size);
+	static void	 Free(void* pFrame, size_t size);
+};
+
+// eager, fire and forget
+struct NetTask
+{
+	struct promise_type
+	{
+		NetTask				get_return_object() { return NetTask(); }
+		coro::suspend_never initial_suspend() { return {}; }
+		coro::suspend_never final_suspend() noexcept { return {}; }
+		void				return_void() {}
+		void				unhandled_exception() { std::terminate(); }
+		static void*		operator new(size_t size) { return CoroutineFramePool::Allocate(size); }
+		static void			operator delete(void* pFrame, size_t size) { CoroutineFramePool::Free(pFrame, size); }
+	};
+};
+
+// lazy, resumes its awaiter when it finishes
+class CoTask
+{
+public:
+	struct promise_type
+	{
+		coro::coroutine_handle<> continuation;
+
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			void await_suspend(coro::coroutine_handle<promise_type> handle) noexcept { handle.promise().continuation.resume(); }
+			void await_resume() noexcept {}
+		};
+
+		CoTask				get_return_object() { return CoTask(coro::coroutine_handle<promise_type>::from_promise(*this)); }
+		coro::suspend_always initial_suspend() { return {}; }
+		FinalAwaiter		 final_suspend() noexcept { return {}; }
+		void				 return_void() {}
+		void				 unhandled_exception() { std::terminate(); }
+		static void*		 operator new(size_t size) { return CoroutineFramePool::Allocate(size); }
+		static void			 operator delete(void* pFrame, size_t size) { CoroutineFramePool::Free(pFrame, size); }
+	};
+
+	CoTask(CoTask&& other) : m_Handle(other.m_Handle) { other.m_Handle = nullptr; }
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+	~CoTask()
+	{
+		if (m_Handle)
+			m_Handle.destroy();
+	}
+
+	bool await_ready() { return false; }
+	void await_suspend(coro::coroutine_handle<> awaiter)
+	{
+		m_Handle.promise().continuation = awaiter;
+		m_Handle.resume();
+	}
+	void await_resume() {}
+
+private:
+	explicit CoTask(coro::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+	coro::coroutine_handle<promise_type> m_Handle;
+};
+
+template <typename T>
+struct ReadyAwaiter
+{
+	T result;
+
+	bool await_ready() { return true; }
+	void await_suspend(coro::coroutine_handle<>) {}
+	T	 await_resume() { return result; }
+};
+
+// a waiting Recv is resumed inline on the delivering worker
+class MessageInbox
+{
+public:
+	struct RecvAwaiter
+	{
+		MessageInbox* pInbox;
+		MESSAGE*	  pMessage;
+
+		bool	 await_ready() { return false; }
+		bool	 await_suspend(coro::coroutine_handle<> handle) { return pInbox->Wait(handle, &pMessage); }
+		MESSAGE* await_resume() { return pMessage; }
+	};
+
+	// nullptr once the connection is gone
+	RecvAwaiter Recv() { return RecvAwaiter{ this, nullptr }; }
+
+	void	 Deliver(MESSAGE* pMessage);
+	void	 Close();
+	void	 Reopen();
+	MESSAGE* TakeQueued();
+
+private:
+	bool Wait(coro::coroutine_handle<> handle, MESSAGE** ppMessage);
+
+private:
+	std::mutex				 m_Lock;
+	std::deque<MESSAGE*>	 m_Queue;
+	coro::coroutine_handle<> m_Waiter;
+	MESSAGE**				 m_ppWaiterMessage = nullptr;
+	bool					 m_Closed = false;
+};
+
+// resumes on a thread pool thread
+class CoSleep
+{
+public:
+	explicit CoSleep(DWORD delayMs) : m_DelayMs(delayMs) {}
+
+	bool await_ready() { return m_DelayMs == 0; }
+	bool await_suspend(coro::coroutine_handle<> handle);
+	void await_resume() {}
+
+private:
+	static void CALLBACK OnTimer(PTP_CALLBACK_INSTANCE pInstance, PVOID pContext, PTP_TIMER pTimer);
+
+private:
+	DWORD					 m_DelayMs;
+	coro::coroutine_handle<> m_Handle;
+};
@@ -0,0 +1,216 @@
+#include "Crc32c.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#include <nmmintrin.h>
+#elif defined(_M_ARM64)
+#include <windows.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+constexpr unsigned int CRC32C_POLYNOMIAL = 0x82F63B78; // reflected 0x1EDC6F41
+
+// slicing by 8 : entry[k][b] is the crc of byte b followed by k zero bytes
+struct CRC32C_TABLE
+{
+	CRC32C_TABLE()
+	{
+		for (unsigned int index = 0; index < 256; ++index)
+		{
+			unsigned int crc = index;
+			for (int bit = 0; bit < 8; ++bit)
+				crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+
+			entry[0][index] = crc;
+		}
+
+		for (unsigned int index = 0; index < 256; ++index)
+		{
+			for (int slice = 1; slice < 8; ++slice)
+				entry[slice][index] = entry[0][entry[slice - 1][index] & 0xFF] ^ (entry[slice - 1][index] >> 8);
+		}
+	}
+
+	unsigned int entry[8][256];
+};
+
+bool DetectHardware()
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	return (cpuInfo[2] & (1 << 20)) != 0; // SSE4.2
+#elif defined(_M_ARM64)
+	return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != FALSE;
+#else
+	return false;
+#endif
+}
+
+bool HasHardware()
+{
+	static const bool hasHardware = DetectHardware();
+	return hasHardware;
+}
+
+unsigned int UpdateTable(unsigned int crc, const unsigned char* pCursor, size_t size)
+{
+	static const CRC32C_TABLE table;
+
+	// little endian, as every target this builds for
+	for (; size >= 8; size -= 8, pCursor += 8)
+	{
+		unsigned int low;
+		unsigned int high;
+		std::memcpy(&low, pCursor, sizeof(low));
+		std::memcpy(&high, pCursor + 4, sizeof(high));
+		low ^= crc;
+
+		crc = table.entry[7][low & 0xFF] ^ table.entry[6][(low >> 8) & 0xFF] ^ table.entry[5][(low >> 16) & 0xFF] ^ table.entry[4][low >> 24]
+			^ table.entry[3][high & 0xFF] ^ table.entry[2][(high >> 8) & 0xFF] ^ table.entry[1][(high >> 16) & 0xFF] ^ table.entry[0][high >> 24];
+	}
+
+	while (size-- > 0)
+		crc = table.entry[0][(crc ^ *pCursor++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(_M_X64) || defined(_M_ARM64)
+constexpr size_t HARDWARE_LANE_SIZE = 256;
+
+unsigned int HardwareStep(unsigned int crc, const unsigned char* pCursor)
+{
+	unsigned long long word;
+	std::memcpy(&word, pCursor, sizeof(word));
+#if defined(_M_X64)
+	return (unsigned int)_mm_crc32_u64(crc, word);
+#else
+	return __crc32cd(crc, word);
+#endif
+}
+
+// three lanes joined by shifting each crc over the next lane's zero bytes
+struct CRC32C_SHIFT_TABLE
+{
+	CRC32C_SHIFT_TABLE()
+	{
+		static const unsigned char zeros[HARDWARE_LANE_SIZE] = {};
+
+		unsigned int basis[32];
+		for (int bit = 0; bit < 32; ++bit)
+		{
+			unsigned int crc = 1u << bit;
+			for (size_t offset = 0; offset < HARDWARE_LANE_SIZE; offset += 8)
+				crc = HardwareStep(crc, zeros + offset);
+
+			basis[bit] = crc;
+		}
+
+		for (int slice = 0; slice < 4; ++slice)
+		{
+			for (unsigned int index = 0; index < 256; ++index)
+			{
+				unsigned int crc = 0;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					if (index & (1u << bit))
+						crc ^= basis[slice * 8 + bit];
+				}
+
+				entry[slice][index] = crc;
+			}
+		}
+	}
+
+	// the crc as if HARDWARE_LANE_SIZE zero bytes followed
+	unsigned int Shift(unsigned int crc) const
+	{
+		return entry[0][crc & 0xFF] ^ entry[1][(crc >> 8) & 0xFF] ^ entry[2][(crc >> 16) & 0xFF] ^ entry[3][crc >> 24];
+	}
+
+	unsigned int entry[4][256];
+};
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+unsigned int UpdateHardware(unsigned int crc, const unsigned char* pCursor, size_t size)
+{
+#if defined(_M_X64) || defined(_M_ARM64)
+	static const CRC32C_SHIFT_TABLE shiftTable;
+
+	for (; size >= 3 * HARDWARE_LANE_SIZE; size -= 3 * HARDWARE_LANE_SIZE, pCursor += 3 * HARDWARE_LANE_SIZE)
+	{
+		unsigned int crcA = crc;
+		unsigned int crcB = 0;
+		unsigned int crcC = 0;
+		for (size_t offset = 0; offset < HARDWARE_LANE_SIZE; offset += 8)
+		{
+			crcA = HardwareStep(crcA, pCursor + offset);
+			crcB = HardwareStep(crcB, pCursor + HARDWARE_LANE_SIZE + offset);
+			crcC = HardwareStep(crcC, pCursor + 2 * HARDWARE_LANE_SIZE + offset);
+		}
+
+		crc = shiftTable.Shift(shiftTable.Shift(crcA) ^ crcB) ^ crcC;
+	}
+#endif
+
+#if defined(_M_X64)
+	unsigned long long crc64 = crc;
+	for (; size >= 8; size -= 8, pCursor += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, pCursor, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (unsigned int)crc64;
+#elif defined(_M_IX86)
+	for (; size >= 4; size -= 4, pCursor += 4)
+	{
+		unsigned int word;
+		std::memcpy(&word, pCursor, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+	}
+#else
+	for (; size >= 8; size -= 8, pCursor += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, pCursor, sizeof(word));
+		crc = __crc32cd(crc, word);
+	}
+#endif
+
+	for (; size > 0; --size, ++pCursor)
+	{
+#if defined(_M_ARM64)
+		crc = __crc32cb(crc, *pCursor);
+#else
+		crc = _mm_crc32_u8(crc, *pCursor);
+#endif
+	}
+
+	return crc;
+}
+#endif
+} // namespace
+
+unsigned int ComputeCrc32c(const void* pData, size_t size)
+{
+	const unsigned char* pCursor = static_cast<const unsigned char*>(pData);
+	unsigned int		 crc = 0xFFFFFFFF;
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+	if (HasHardware())
+		return ~UpdateHardware(crc, pCursor, size);
+#endif
+
+	return ~UpdateTable(crc, pCursor, size);
+}
+
+bool IsCrc32cHardwareAccelerated()
+{
+	return HasHardware();
+}
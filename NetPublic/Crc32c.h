@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// CRC32C (Castagnoli)
+unsigned int ComputeCrc32c(const void* pData, size_t size);
+bool		 IsCrc32cHardwareAccelerated();
@@ -2,5 +2,17 @@
 
 constexpr int  TOTAL_MESSAGE_COUNT_IN_MEMORY_POOL = 5000;
 constexpr int  MAX_WSABUF_SIZE = 30;
+constexpr int  BULK_SEND_SHARE = 8;
+constexpr int  CACHE_LINE_SIZE = 64;
+constexpr int  LARGE_FRAME_THRESHOLD = 4096;
+constexpr int  RECV_BUDGET = 64;
+constexpr int  FANOUT_CHUNK_SIZE = 256;
+constexpr int  MAX_DEQUEUE_BATCH = 64;
+constexpr int  SPIN_MIN_US = 2;
+constexpr int  SESSION_SEGMENT_SHIFT = 8;
+constexpr int  SESSION_SEGMENT_SIZE = 1 << SESSION_SEGMENT_SHIFT;
+constexpr int  MAX_SESSION_SEGMENT_COUNT = 1024;
+constexpr int  MAX_SESSION_COUNT = SESSION_SEGMENT_SIZE * MAX_SESSION_SEGMENT_COUNT;
+constexpr int  SHM_NAME_SIZE = 64;
 constexpr long RELEASE_TRUE = 1;
 constexpr long RELEASE_FALSE = 0;
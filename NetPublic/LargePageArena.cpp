@@ -0,0 +1,179 @@
+#include <windows.h>
+#include "LargePageArena.h"
+
+static constexpr size_t CARVE_REGION_SIZE = 2 * 1024 * 1024;
+
+LargePageArena::LargePageArena()
+: m_LargePageSize(0)
+, m_PageSize(4096)
+, m_LargePageBytes(0)
+, m_TotalBytes(0)
+{
+}
+
+LargePageArena::~LargePageArena()
+{
+	for (auto region : m_vecRegion)
+		VirtualFree(region, 0, MEM_RELEASE);
+}
+
+bool LargePageArena::Initialize()
+{
+	std::call_once(m_InitFlag, [this]() {
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		m_PageSize = systemInfo.dwPageSize;
+
+		if (EnableLockMemoryPrivilege())
+			m_LargePageSize = GetLargePageMinimum();
+	});
+
+	return true;
+}
+
+void* LargePageArena::Allocate(size_t size, int numaNode)
+{
+	if (size == 0)
+		return nullptr;
+
+	Initialize();
+
+	void* ptr = AllocateRegion(size, numaNode);
+	if (ptr == nullptr)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_vecRegion.push_back(ptr);
+
+	return ptr;
+}
+
+// the caller records the region in m_vecRegion
+void* LargePageArena::AllocateRegion(size_t size, int numaNode)
+{
+	DWORD preferredNode = numaNode == NUMA_NODE_ANY ? NUMA_NO_PREFERRED_NODE : (DWORD)numaNode;
+
+	void* ptr = nullptr;
+	if (m_LargePageSize != 0)
+	{
+		size_t largeSize = (size + m_LargePageSize - 1) / m_LargePageSize * m_LargePageSize;
+		ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, preferredNode);
+		if (ptr != nullptr)
+		{
+			m_LargePageBytes += largeSize;
+			m_TotalBytes += largeSize;
+		}
+	}
+
+	if (ptr == nullptr)
+	{
+		ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferredNode);
+		if (ptr == nullptr)
+			return nullptr;
+
+		Prefault(ptr, size);
+		m_TotalBytes += size;
+	}
+
+	return ptr;
+}
+
+void* LargePageArena::Carve(size_t size, size_t alignment, int numaNode)
+{
+	if (size == 0)
+		return nullptr;
+
+	Initialize();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	const size_t carveIndex = (size_t)(numaNode + 1);
+	if (carveIndex >= m_vecCarve.size())
+		m_vecCarve.resize(carveIndex + 1, CARVE_REGION{ nullptr, 0 });
+
+	CARVE_REGION& region = m_vecCarve[carveIndex];
+
+	size_t padding = (alignment - (size_t)region.pNext % alignment) % alignment;
+	if (region.pNext == nullptr || padding + size > region.remain)
+	{
+		const size_t regionUnit = m_LargePageSize != 0 ? m_LargePageSize : CARVE_REGION_SIZE;
+		const size_t regionSize = (size + regionUnit - 1) / regionUnit * regionUnit;
+
+		void* ptr = AllocateRegion(regionSize, numaNode);
+		if (ptr == nullptr)
+			return nullptr;
+
+		m_vecRegion.push_back(ptr);
+		region.pNext = static_cast<char*>(ptr);
+		region.remain = regionSize;
+		padding = 0; // regions are page aligned
+	}
+
+	void* ptr = region.pNext + padding;
+	region.pNext += padding + size;
+	region.remain -= padding + size;
+	return ptr;
+}
+
+int LargePageArena::GetNumaNodeCount()
+{
+	ULONG highestNode = 0;
+	if (!GetNumaHighestNodeNumber(&highestNode))
+		return 1;
+
+	return (int)highestNode + 1;
+}
+
+int LargePageArena::GetCurrentNumaNode()
+{
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+
+	USHORT node = 0;
+	if (!GetNumaProcessorNodeEx(&processor, &node))
+		return NUMA_NODE_ANY;
+
+	return node;
+}
+
+bool LargePageArena::BindThreadToNumaNode(int numaNode)
+{
+	if (numaNode == NUMA_NODE_ANY)
+		return false;
+
+	GROUP_AFFINITY affinity;
+	ZeroMemory(&affinity, sizeof(affinity));
+	if (!GetNumaNodeProcessorMaskEx((USHORT)numaNode, &affinity))
+		return false;
+
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+bool LargePageArena::EnableLockMemoryPrivilege()
+{
+	HANDLE hToken = nullptr;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+		return false;
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	bool result = false;
+	if (LookupPrivilegeValueA(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+	{
+		// AdjustTokenPrivileges succeeds even when the privilege is not held
+		if (AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr))
+			result = GetLastError() == ERROR_SUCCESS;
+	}
+
+	CloseHandle(hToken);
+	return result;
+}
+
+void LargePageArena::Prefault(void* ptr, size_t size)
+{
+	volatile char* pPage = static_cast<volatile char*>(ptr);
+	for (size_t offset = 0; offset < size; offset += m_PageSize)
+		pPage[offset] = 0;
+}
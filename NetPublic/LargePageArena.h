@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+constexpr int NUMA_NODE_ANY = -1;
+
+// large page backed blocks, falls back to normal pages. touched up front
+class LargePageArena
+{
+	struct CARVE_REGION
+	{
+		char*  pNext;
+		size_t remain;
+	};
+
+public:
+	LargePageArena();
+	~LargePageArena();
+
+	bool Initialize();
+
+	void* Allocate(size_t size, int numaNode = NUMA_NODE_ANY);
+
+	// alignment must be a power of two
+	void* Carve(size_t size, size_t alignment, int numaNode = NUMA_NODE_ANY);
+
+	size_t GetLargePageBytes() const { return m_LargePageBytes; }
+	size_t GetTotalBytes() const { return m_TotalBytes; }
+	size_t GetLargePageSize() const { return m_LargePageSize; }
+
+	static int  GetNumaNodeCount();
+	static int  GetCurrentNumaNode();
+	static bool BindThreadToNumaNode(int numaNode);
+
+private:
+	void* AllocateRegion(size_t size, int numaNode);
+	bool  EnableLockMemoryPrivilege();
+	void  Prefault(void* ptr, size_t size);
+
+private:
+	std::once_flag m_InitFlag;
+	size_t		   m_LargePageSize;
+	size_t		   m_PageSize;
+
+	std::atomic<size_t> m_LargePageBytes;
+	std::atomic<size_t> m_TotalBytes;
+
+	std::mutex				  m_lock;
+	std::vector<void*>		  m_vecRegion;
+	std::vector<CARVE_REGION> m_vecCarve; // guarded by m_lock
+};
@@ -0,0 +1,327 @@
+#include "LoopbackTransport.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+void LoopbackPipe::Attach(HANDLE hIocp, ULONG_PTR completionKey)
+{
+	m_hIocp = hIocp;
+	m_CompletionKey = completionKey;
+}
+
+// one recv at a time
+int LoopbackPipe::Recv(WSABUF* pBufs, int bufCount, OVERLAPPED* pOverlapped)
+{
+	std::lock_guard<std::mutex> lock(m_pConnection->lock);
+
+	LOOPBACK_STREAM& stream = m_pConnection->streams[1 - m_Side];
+	if (stream.pRecvOverlapped != nullptr || bufCount > (int)(sizeof(stream.recvBufs) / sizeof(stream.recvBufs[0])))
+	{
+		WSASetLastError(WSAEINVAL);
+		return SOCKET_ERROR;
+	}
+
+	for (int i = 0; i < bufCount; ++i)
+		stream.recvBufs[i] = pBufs[i];
+
+	stream.recvBufCount = bufCount;
+	stream.pRecvOverlapped = pOverlapped;
+
+	m_pNetwork->Deliver(m_pConnection, 1 - m_Side);
+	return 0;
+}
+
+// the completion is held back while the other end is bufferSize behind
+int LoopbackPipe::Send(const WSABUF* pBufs, int bufCount, OVERLAPPED* pOverlapped)
+{
+	std::lock_guard<std::mutex> lock(m_pConnection->lock);
+
+	LOOPBACK_STREAM& stream = m_pConnection->streams[m_Side];
+	if (stream.closed)
+	{
+		WSASetLastError(WSAECONNRESET);
+		return SOCKET_ERROR;
+	}
+
+	if (stream.pSendOverlapped != nullptr)
+	{
+		WSASetLastError(WSAEINVAL);
+		return SOCKET_ERROR;
+	}
+
+	DWORD sendBytes = 0;
+	for (int i = 0; i < bufCount; ++i)
+		sendBytes += pBufs[i].len;
+
+	m_pNetwork->Write(m_pConnection, m_Side, pBufs, bufCount);
+
+	stream.pSendOverlapped = pOverlapped;
+	stream.sendBytes = sendBytes;
+
+	m_pNetwork->Deliver(m_pConnection, m_Side);
+	m_pNetwork->CompleteSend(m_pConnection, m_Side);
+	return 0;
+}
+
+// like shutdown(SD_BOTH)
+void LoopbackPipe::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(m_pConnection->lock);
+
+	for (int side = 0; side < 2; ++side)
+	{
+		LOOPBACK_STREAM& stream = m_pConnection->streams[side];
+		stream.closed = true;
+		stream.inFlight.clear();
+		stream.inFlightBytes = 0;
+
+		m_pNetwork->Deliver(m_pConnection, side);
+		m_pNetwork->CompleteSend(m_pConnection, side);
+	}
+}
+
+void LoopbackPipe::Close()
+{
+	Shutdown();
+	m_pNetwork->Release(m_pConnection, m_Side);
+}
+
+LoopbackNetwork::LoopbackNetwork(const LOOPBACK_CONFIG& config)
+: m_Config(config)
+, m_ConnectionCnt(0)
+, m_Shutdown(false)
+, m_Running(false)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_TickFrequency = frequency.QuadPart;
+
+	if (IsSimulated())
+	{
+		m_Running = true;
+		m_DeliveryThread = std::thread([this]() { DeliveryThread(); });
+	}
+}
+
+LoopbackNetwork::~LoopbackNetwork()
+{
+	Shutdown();
+
+	m_Running = false;
+	if (m_DeliveryThread.joinable())
+		m_DeliveryThread.join();
+
+	for (LOOPBACK_CONNECTION* pConnection : m_vecConnections)
+		delete pConnection;
+}
+
+LoopbackPipe* LoopbackNetwork::Connect()
+{
+	LOOPBACK_CONNECTION* pConnection = new (std::nothrow) LOOPBACK_CONNECTION;
+	if (pConnection == nullptr)
+		return nullptr;
+
+	for (int side = 0; side < 2; ++side)
+	{
+		LoopbackPipe& pipe = pConnection->ends[side];
+		pipe.m_pNetwork = this;
+		pipe.m_pConnection = pConnection;
+		pipe.m_Side = side;
+		pipe.m_hIocp = nullptr;
+		pipe.m_CompletionKey = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	if (m_Shutdown)
+	{
+		delete pConnection;
+		return nullptr;
+	}
+
+	pConnection->lossRandom.seed(m_Config.seed + m_ConnectionCnt++);
+
+	m_vecConnections.push_back(pConnection);
+	m_Backlog.push_back(&pConnection->ends[1]);
+	m_AcceptCondition.notify_one();
+
+	return &pConnection->ends[0];
+}
+
+LoopbackPipe* LoopbackNetwork::Accept()
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+	m_AcceptCondition.wait(lock, [this]() { return m_Shutdown || !m_Backlog.empty(); });
+	if (m_Backlog.empty())
+		return nullptr;
+
+	LoopbackPipe* pPipe = m_Backlog.front();
+	m_Backlog.pop_front();
+	return pPipe;
+}
+
+void LoopbackNetwork::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_Shutdown = true;
+	m_AcceptCondition.notify_all();
+}
+
+// the connection's lock is held
+void LoopbackNetwork::Write(LOOPBACK_CONNECTION* pConnection, int side, const WSABUF* pBufs, int bufCount)
+{
+	LOOPBACK_STREAM& stream = pConnection->streams[side];
+	if (!IsSimulated())
+	{
+		for (int i = 0; i < bufCount; ++i)
+			stream.data.insert(stream.data.end(), pBufs[i].buf, pBufs[i].buf + pBufs[i].len);
+		return;
+	}
+
+	LOOPBACK_CHUNK chunk;
+	for (int i = 0; i < bufCount; ++i)
+		chunk.data.insert(chunk.data.end(), pBufs[i].buf, pBufs[i].buf + pBufs[i].len);
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	LONGLONG sentTick = now.QuadPart;
+	if (m_Config.bytesPerSecond > 0)
+	{
+		stream.linkFreeTick = (std::max)(stream.linkFreeTick, now.QuadPart) + (LONGLONG)chunk.data.size() * m_TickFrequency / m_Config.bytesPerSecond;
+		sentTick = stream.linkFreeTick;
+	}
+
+	LONGLONG deliverTick = sentTick + (LONGLONG)m_Config.latencyUs * m_TickFrequency / 1000000;
+	if (m_Config.lossPercent > 0 && (int)(pConnection->lossRandom() % 100) < m_Config.lossPercent)
+		deliverTick += (LONGLONG)m_Config.retransmitDelayUs * m_TickFrequency / 1000000;
+
+	// a retransmitted chunk holds back the ones behind it
+	deliverTick = (std::max)(deliverTick, stream.lastDeliverTick);
+	stream.lastDeliverTick = deliverTick;
+
+	chunk.deliverTick = deliverTick;
+	stream.inFlightBytes += chunk.data.size();
+	stream.inFlight.push_back(std::move(chunk));
+}
+
+// the connection's lock is held
+void LoopbackNetwork::Deliver(LOOPBACK_CONNECTION* pConnection, int side)
+{
+	LOOPBACK_STREAM& stream = pConnection->streams[side];
+	if (stream.pRecvOverlapped == nullptr)
+		return;
+
+	size_t available = stream.data.size() - stream.readOffset;
+	if (available == 0 && !stream.closed)
+		return;
+
+	DWORD copied = 0;
+	for (int i = 0; i < stream.recvBufCount && available > 0; ++i)
+	{
+		const size_t size = (std::min)((size_t)stream.recvBufs[i].len, available);
+		std::memcpy(stream.recvBufs[i].buf, stream.data.data() + stream.readOffset, size);
+		stream.readOffset += size;
+		available -= size;
+		copied += (DWORD)size;
+	}
+
+	if (available == 0)
+	{
+		stream.data.clear();
+		stream.readOffset = 0;
+	}
+	else if (stream.readOffset > stream.data.size() / 2)
+	{
+		stream.data.erase(stream.data.begin(), stream.data.begin() + stream.readOffset);
+		stream.readOffset = 0;
+	}
+
+	OVERLAPPED* pOverlapped = stream.pRecvOverlapped;
+	stream.pRecvOverlapped = nullptr;
+
+	const LoopbackPipe& receiver = pConnection->ends[1 - side];
+	PostQueuedCompletionStatus(receiver.m_hIocp, copied, receiver.m_CompletionKey, pOverlapped);
+
+	CompleteSend(pConnection, side);
+}
+
+// the connection's lock is held
+void LoopbackNetwork::CompleteSend(LOOPBACK_CONNECTION* pConnection, int side)
+{
+	LOOPBACK_STREAM& stream = pConnection->streams[side];
+	if (stream.pSendOverlapped == nullptr)
+		return;
+
+	const size_t bufferedBytes = stream.data.size() - stream.readOffset + stream.inFlightBytes;
+	if (!stream.closed && bufferedBytes > (size_t)m_Config.bufferSize)
+		return;
+
+	OVERLAPPED* pOverlapped = stream.pSendOverlapped;
+	stream.pSendOverlapped = nullptr;
+
+	const LoopbackPipe& sender = pConnection->ends[side];
+	PostQueuedCompletionStatus(sender.m_hIocp, stream.sendBytes, sender.m_CompletionKey, pOverlapped);
+}
+
+void LoopbackNetwork::Release(LOOPBACK_CONNECTION* pConnection, int side)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	bool released;
+	{
+		std::lock_guard<std::mutex> connectionLock(pConnection->lock);
+		pConnection->endClosed[side] = true;
+		released = pConnection->endClosed[1 - side];
+	}
+
+	if (!released)
+		return;
+
+	m_vecConnections.erase(std::remove(m_vecConnections.begin(), m_vecConnections.end(), pConnection), m_vecConnections.end());
+	delete pConnection;
+}
+
+void LoopbackNetwork::DeliveryThread()
+{
+	const LONGLONG sleepTicks = m_TickFrequency / 1000;
+
+	while (m_Running)
+	{
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+
+		LONGLONG nextDueTick = LLONG_MAX;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			for (LOOPBACK_CONNECTION* pConnection : m_vecConnections)
+			{
+				std::lock_guard<std::mutex> connectionLock(pConnection->lock);
+				for (int side = 0; side < 2; ++side)
+				{
+					LOOPBACK_STREAM& stream = pConnection->streams[side];
+
+					bool delivered = false;
+					while (!stream.inFlight.empty() && stream.inFlight.front().deliverTick <= now.QuadPart)
+					{
+						LOOPBACK_CHUNK& chunk = stream.inFlight.front();
+						stream.data.insert(stream.data.end(), chunk.data.begin(), chunk.data.end());
+						stream.inFlightBytes -= chunk.data.size();
+						stream.inFlight.pop_front();
+						delivered = true;
+					}
+
+					if (delivered)
+						Deliver(pConnection, side);
+
+					if (!stream.inFlight.empty())
+						nextDueTick = (std::min)(nextDueTick, stream.inFlight.front().deliverTick);
+				}
+			}
+		}
+
+		if (nextDueTick - now.QuadPart < sleepTicks)
+			std::this_thread::yield();
+		else
+			Sleep(1);
+	}
+}
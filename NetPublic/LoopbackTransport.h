@@ -0,0 +1,115 @@
+#pragma once
+#include <winsock2.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// all 0 delivers at once in the sending thread
+struct LOOPBACK_CONFIG
+{
+	int			 latencyUs = 0;				// one way
+	int			 bytesPerSecond = 0;		// per direction, 0 is unlimited
+	int			 lossPercent = 0;			// a lost send arrives retransmitDelayUs late
+	int			 retransmitDelayUs = 200000;
+	int			 bufferSize = 1 << 20;		// per direction
+	unsigned int seed = 1;
+};
+
+class LoopbackNetwork;
+struct LOOPBACK_CONNECTION;
+
+// Recv and Send return like WSARecv and WSASend and complete through the attached port
+class LoopbackPipe
+{
+	friend class LoopbackNetwork;
+
+public:
+	void Attach(HANDLE hIocp, ULONG_PTR completionKey);
+	int	 Recv(WSABUF* pBufs, int bufCount, OVERLAPPED* pOverlapped);
+	int	 Send(const WSABUF* pBufs, int bufCount, OVERLAPPED* pOverlapped);
+	void Shutdown();
+
+	// like closesocket
+	void Close();
+
+private:
+	LoopbackNetwork*	 m_pNetwork;
+	LOOPBACK_CONNECTION* m_pConnection;
+	int					 m_Side;
+	HANDLE				 m_hIocp;
+	ULONG_PTR			 m_CompletionKey;
+};
+
+struct LOOPBACK_CHUNK
+{
+	LONGLONG		  deliverTick;
+	std::vector<char> data;
+};
+
+struct LOOPBACK_STREAM
+{
+	std::vector<char>		   data; // from readOffset on
+	size_t					   readOffset = 0;
+	std::deque<LOOPBACK_CHUNK> inFlight;
+	size_t					   inFlightBytes = 0;
+	LONGLONG				   linkFreeTick = 0;
+	LONGLONG				   lastDeliverTick = 0;
+	bool					   closed = false;
+
+	WSABUF		recvBufs[2];
+	int			recvBufCount = 0;
+	OVERLAPPED* pRecvOverlapped = nullptr;
+	OVERLAPPED* pSendOverlapped = nullptr; // held while over bufferSize
+	DWORD		sendBytes = 0;
+};
+
+struct LOOPBACK_CONNECTION
+{
+	std::mutex		lock;
+	LoopbackPipe	ends[2]; // 0 is the connecting side
+	LOOPBACK_STREAM streams[2];
+	bool			endClosed[2] = { false, false };
+	std::mt19937	lossRandom;
+};
+
+class LoopbackNetwork
+{
+	friend class LoopbackPipe;
+
+public:
+	explicit LoopbackNetwork(const LOOPBACK_CONFIG& config = LOOPBACK_CONFIG());
+	~LoopbackNetwork();
+
+	LoopbackPipe* Connect();
+
+	// nullptr once shut down
+	LoopbackPipe* Accept();
+	void		  Shutdown();
+
+private:
+	bool IsSimulated() const { return m_Config.latencyUs > 0 || m_Config.bytesPerSecond > 0 || m_Config.lossPercent > 0; }
+
+	void Write(LOOPBACK_CONNECTION* pConnection, int side, const WSABUF* pBufs, int bufCount);
+	void Deliver(LOOPBACK_CONNECTION* pConnection, int side);
+	void CompleteSend(LOOPBACK_CONNECTION* pConnection, int side);
+	void Release(LOOPBACK_CONNECTION* pConnection, int side);
+	void DeliveryThread();
+
+private:
+	LOOPBACK_CONFIG m_Config;
+	LONGLONG		m_TickFrequency;
+
+	std::mutex						  m_Lock; // taken before a connection's lock
+	std::condition_variable			  m_AcceptCondition;
+	std::vector<LOOPBACK_CONNECTION*> m_vecConnections;
+	std::deque<LoopbackPipe*>		  m_Backlog;
+	unsigned int					  m_ConnectionCnt;
+	bool							  m_Shutdown;
+
+	std::atomic<bool> m_Running;
+	std::thread		  m_DeliveryThread;
+};
@@ -0,0 +1,104 @@
+#include "MessageChain.h"
+
+MessageChain::MessageChain(ALLOCATE_FUNC allocateMessage, FREE_FUNC freeMessage)
+: m_Allocate(std::move(allocateMessage))
+, m_Free(std::move(freeMessage))
+, m_pFirst(nullptr)
+, m_pLast(nullptr)
+, m_Size(0)
+, m_FragmentCount(0)
+{
+}
+
+MessageChain::MessageChain(MessageChain&& other)
+: m_Allocate(std::move(other.m_Allocate))
+, m_Free(std::move(other.m_Free))
+, m_pFirst(other.m_pFirst)
+, m_pLast(other.m_pLast)
+, m_Size(other.m_Size)
+, m_FragmentCount(other.m_FragmentCount)
+{
+	other.m_pFirst = nullptr;
+	other.m_pLast = nullptr;
+	other.m_Size = 0;
+	other.m_FragmentCount = 0;
+}
+
+MessageChain::~MessageChain()
+{
+	Clear();
+}
+
+bool MessageChain::put(const void* payload, int size)
+{
+	const char* pData = static_cast<const char*>(payload);
+
+	while (size > 0)
+	{
+		int freeSize = m_pLast != nullptr ? CHAIN_FRAGMENT_SIZE - m_pLast->header.length : 0;
+		if (freeSize == 0)
+		{
+			MESSAGE* pMessage = m_Allocate();
+			if (pMessage == nullptr)
+				return false;
+
+			pMessage->Reset();
+			Append(pMessage);
+			freeSize = CHAIN_FRAGMENT_SIZE;
+		}
+
+		const int copySize = size < freeSize ? size : freeSize;
+		m_pLast->put(pData, copySize);
+		m_Size += copySize;
+
+		pData += copySize;
+		size -= copySize;
+	}
+
+	return true;
+}
+
+void MessageChain::Append(MESSAGE* pMessage)
+{
+	pMessage->pNext.store(nullptr, std::memory_order_relaxed);
+
+	if (m_pLast != nullptr)
+		m_pLast->pNext.store(pMessage, std::memory_order_relaxed);
+	else
+		m_pFirst = pMessage;
+
+	m_pLast = pMessage;
+	m_Size += pMessage->header.length;
+	++m_FragmentCount;
+}
+
+MESSAGE* MessageChain::Detach(MESSAGE*& pLast)
+{
+	MESSAGE* pFirst = m_pFirst;
+	pLast = m_pLast;
+
+	for (MESSAGE* pMessage = pFirst; pMessage != nullptr; pMessage = GetNext(pMessage))
+		pMessage->header.type = pMessage != pLast ? PACKET_TYPE::USER_CONTINUED : PACKET_TYPE::USER;
+
+	m_pFirst = nullptr;
+	m_pLast = nullptr;
+	m_Size = 0;
+	m_FragmentCount = 0;
+	return pFirst;
+}
+
+void MessageChain::Clear()
+{
+	MESSAGE* pMessage = m_pFirst;
+	while (pMessage != nullptr)
+	{
+		MESSAGE* pNext = GetNext(pMessage);
+		m_Free(pMessage);
+		pMessage = pNext;
+	}
+
+	m_pFirst = nullptr;
+	m_pLast = nullptr;
+	m_Size = 0;
+	m_FragmentCount = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <climits>
+#include <functional>
+
+#include "Protocol.h"
+
+// header.length is a short on the wire, and a fragment keeps room for the integrity trailer or the
+// Poly1305 tag so it can still be sealed in place
+constexpr int CHAIN_FRAGMENT_SIZE = SHRT_MAX - INTEGRITY_TRAILER_SIZE - POLY1305_TAG_SIZE;
+
+// fragments linked through pNext, all but the last sent as USER_CONTINUED. not thread safe
+class MessageChain
+{
+public:
+	using ALLOCATE_FUNC = std::function<MESSAGE*()>;
+	using FREE_FUNC = std::function<void(MESSAGE*)>;
+
+	MessageChain(ALLOCATE_FUNC allocateMessage, FREE_FUNC freeMessage);
+	MessageChain(MessageChain&& other);
+	MessageChain(const MessageChain&) = delete;
+	MessageChain& operator=(const MessageChain&) = delete;
+	~MessageChain();
+
+	// false if the pool ran dry
+	bool put(const void* payload, int size);
+
+	void Append(MESSAGE* pMessage);
+
+	int		 GetSize() const { return m_Size; }
+	int		 GetFragmentCount() const { return m_FragmentCount; }
+	MESSAGE* GetFirst() const { return m_pFirst; }
+
+	static MESSAGE* GetNext(MESSAGE* pMessage) { return pMessage->pNext.load(std::memory_order_relaxed); }
+
+	// leaves the chain empty
+	MESSAGE* Detach(MESSAGE*& pLast);
+
+	void Clear();
+
+private:
+	ALLOCATE_FUNC m_Allocate;
+	FREE_FUNC	  m_Free;
+	MESSAGE*	  m_pFirst;
+	MESSAGE*	  m_pLast;
+	int			  m_Size;
+	int			  m_FragmentCount;
+};
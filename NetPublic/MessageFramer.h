@@ -0,0 +1,41 @@
+#pragma once
+#include "Protocol.h"
+#include "RingBuffer.h"
+
+enum class FRAME_STATUS
+{
+	READY,
+	INCOMPLETE,
+	INVALID
+};
+
+// header.length is valid for READY, and for INCOMPLETE once a header has arrived
+inline FRAME_STATUS PeekFrame(RingBuffer& recvQ, HEADER& header)
+{
+	header.length = 0;
+
+	const size_t headerSize = sizeof(header);
+	const size_t useSize = recvQ.size_in_use();
+	if (useSize <= headerSize)
+		return FRAME_STATUS::INCOMPLETE;
+
+	if (!recvQ.peek((char*)&header, headerSize))
+		return FRAME_STATUS::INVALID;
+
+	if (header.length < 0 || header.length >= RINGBUFFER_SIZE - headerSize)
+		return FRAME_STATUS::INVALID;
+
+	// compared unsigned, more than 32K buffered must not wrap to a negative count
+	if (useSize - headerSize < (size_t)header.length)
+		return FRAME_STATUS::INCOMPLETE;
+
+	return FRAME_STATUS::READY;
+}
+
+inline void PopFrame(RingBuffer& recvQ, const HEADER& header, MESSAGE* pMessage)
+{
+	const size_t frameSize = sizeof(header) + header.length;
+
+	recvQ.peek((char*)pMessage, frameSize);
+	recvQ.move_tail(frameSize);
+}
@@ -0,0 +1,155 @@
+#include "MessageTracer.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+thread_local void* t_pTraceBuffer = nullptr;
+
+struct TRACE_POINT_INFO
+{
+	const char* name;
+	char		phase;
+};
+
+const TRACE_POINT_INFO TRACE_POINT_INFOS[] = {
+	{ "recv", 'b' },
+	{ "OnRecv enter", 'n' },
+	{ "recv", 'e' },
+	{ "send", 'b' },
+	{ "PostSend", 'n' },
+	{ "send", 'e' },
+};
+} // namespace
+
+MessageTracer::MessageTracer()
+: m_SampleEvery(0)
+, m_NextTraceId(0)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_TickFrequency = frequency.QuadPart;
+}
+
+MessageTracer::~MessageTracer()
+{
+	for (TRACE_BUFFER* pBuffer : m_vecBuffers)
+		delete pBuffer;
+}
+
+void MessageTracer::Start(int sampleEvery)
+{
+	m_SampleEvery = sampleEvery > 0 ? sampleEvery : 0;
+}
+
+unsigned int MessageTracer::Sample()
+{
+	thread_local int t_Countdown = 0;
+
+	const int sampleEvery = m_SampleEvery.load(std::memory_order_relaxed);
+	if (sampleEvery <= 0 || --t_Countdown > 0)
+		return 0;
+
+	t_Countdown = sampleEvery;
+
+	// 0 means untraced
+	unsigned int traceId = ++m_NextTraceId;
+	if (traceId == 0)
+		traceId = ++m_NextTraceId;
+
+	return traceId;
+}
+
+void MessageTracer::Record(unsigned int traceId, TRACE_POINT point, SESSION_UID sessionUID)
+{
+	TRACE_BUFFER* pBuffer = GetThreadBuffer();
+	if (pBuffer == nullptr)
+		return;
+
+	LARGE_INTEGER tick;
+	QueryPerformanceCounter(&tick);
+
+	// published after the event
+	const size_t writeCount = pBuffer->writeCount.load(std::memory_order_relaxed);
+	TRACE_EVENT& event = pBuffer->events[writeCount % TRACE_BUFFER_EVENTS];
+	event.tick = tick.QuadPart;
+	event.sessionUID = sessionUID;
+	event.traceId = traceId;
+	event.point = point;
+	pBuffer->writeCount.store(writeCount + 1, std::memory_order_release);
+}
+
+MessageTracer::TRACE_BUFFER* MessageTracer::GetThreadBuffer()
+{
+	TRACE_BUFFER* pBuffer = static_cast<TRACE_BUFFER*>(t_pTraceBuffer);
+	if (pBuffer != nullptr && pBuffer->pOwner == this)
+		return pBuffer;
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	const DWORD threadId = GetCurrentThreadId();
+	for (TRACE_BUFFER* pOwned : m_vecBuffers)
+	{
+		if (pOwned->threadId == threadId)
+		{
+			t_pTraceBuffer = pOwned;
+			return pOwned;
+		}
+	}
+
+	pBuffer = new (std::nothrow) TRACE_BUFFER;
+	if (pBuffer == nullptr)
+		return nullptr;
+
+	pBuffer->pOwner = this;
+	pBuffer->threadId = threadId;
+	pBuffer->writeCount = 0;
+	m_vecBuffers.push_back(pBuffer);
+
+	t_pTraceBuffer = pBuffer;
+	return pBuffer;
+}
+
+bool MessageTracer::Dump(const char* path)
+{
+	FILE* pFile = nullptr;
+	if (fopen_s(&pFile, path, "w") != 0 || pFile == nullptr)
+		return false;
+
+	std::vector<TRACE_EVENT> vecEvents;
+	vecEvents.reserve(TRACE_BUFFER_EVENTS);
+
+	std::fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	for (TRACE_BUFFER* pBuffer : m_vecBuffers)
+	{
+		const size_t endCount = pBuffer->writeCount.load(std::memory_order_acquire);
+		const size_t beginCount = endCount > TRACE_BUFFER_EVENTS ? endCount - TRACE_BUFFER_EVENTS : 0;
+
+		vecEvents.clear();
+		for (size_t i = beginCount; i < endCount; ++i)
+			vecEvents.push_back(pBuffer->events[i % TRACE_BUFFER_EVENTS]);
+
+		// drop what the owner may have overwritten during the copy
+		const size_t lateCount = pBuffer->writeCount.load(std::memory_order_acquire);
+		const size_t validCount = lateCount > TRACE_BUFFER_EVENTS ? lateCount - TRACE_BUFFER_EVENTS : 0;
+		const size_t skipCount = validCount > beginCount ? (std::min)(validCount - beginCount, vecEvents.size()) : 0;
+
+		for (size_t i = skipCount; i < vecEvents.size(); ++i)
+		{
+			const TRACE_EVENT&		event = vecEvents[i];
+			const TRACE_POINT_INFO& info = TRACE_POINT_INFOS[(int)event.point];
+			const double			timestampUs = (double)event.tick * 1000000.0 / m_TickFrequency;
+
+			std::fprintf(pFile, "%s{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"%c\",\"id\":\"0x%x\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"session\":%lld}}",
+						 first ? "" : ",\n", info.name, info.phase, event.traceId, timestampUs, GetCurrentProcessId(), pBuffer->threadId, event.sessionUID);
+			first = false;
+		}
+	}
+
+	std::fprintf(pFile, "\n]}\n");
+	return std::fclose(pFile) == 0;
+}
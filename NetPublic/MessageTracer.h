@@ -0,0 +1,64 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "Protocol.h"
+
+constexpr int TRACE_BUFFER_EVENTS = 16384; // per thread, the oldest events are overwritten
+
+enum class TRACE_POINT : char
+{
+	RECV_FRAMED, // the frame was cut out of recvQ
+	ONRECV_ENTER,
+	ONRECV_EXIT,
+	SEND_QUEUED, // pushed into a send lane
+	POST_SEND,	 // gathered into a WSASend
+	SEND_COMPLETE
+};
+
+struct TRACE_EVENT
+{
+	LONGLONG	 tick;
+	SESSION_UID	 sessionUID;
+	unsigned int traceId;
+	TRACE_POINT	 point;
+};
+
+// each thread records into a buffer only it writes. Dump writes Chrome trace event JSON
+class MessageTracer
+{
+	struct TRACE_BUFFER
+	{
+		MessageTracer*		pOwner;
+		DWORD				threadId;
+		std::atomic<size_t> writeCount;
+		TRACE_EVENT			events[TRACE_BUFFER_EVENTS];
+	};
+
+public:
+	MessageTracer();
+	~MessageTracer();
+
+	// per thread. 0 stops, recorded events are kept
+	void Start(int sampleEvery);
+	void Stop() { m_SampleEvery = 0; }
+	bool IsEnabled() const { return m_SampleEvery.load(std::memory_order_relaxed) > 0; }
+
+	unsigned int Sample();
+	void		 Record(unsigned int traceId, TRACE_POINT point, SESSION_UID sessionUID);
+
+	// safe while tracing runs
+	bool Dump(const char* path);
+
+private:
+	TRACE_BUFFER* GetThreadBuffer();
+
+private:
+	std::atomic<int>		  m_SampleEvery;
+	std::atomic<unsigned int> m_NextTraceId;
+	LONGLONG				  m_TickFrequency;
+	std::mutex				  m_Lock; // the buffer list
+	std::vector<TRACE_BUFFER*> m_vecBuffers;
+};
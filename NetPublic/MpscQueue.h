@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <thread>
+
+// intrusive MPSC queue linked through T::pNext. the consumer detaches and reverses everything at once
+template <typename T>
+class MpscQueue
+{
+public:
+	void Push(T* pNode)
+	{
+		pNode->pNext.store(Unlinked(), std::memory_order_relaxed);
+		T* pPrev = m_pHead.exchange(pNode, std::memory_order_acq_rel);
+		pNode->pNext.store(pPrev, std::memory_order_release);
+	}
+
+	// pFirst to pLast already linked, nothing lands between them
+	void PushList(T* pFirst, T* pLast)
+	{
+		T* pReversed = nullptr;
+		T* pNode = pFirst;
+		while (pNode != nullptr)
+		{
+			T* pNext = pNode == pLast ? nullptr : pNode->pNext.load(std::memory_order_relaxed);
+			pNode->pNext.store(pReversed, std::memory_order_relaxed);
+			pReversed = pNode;
+			pNode = pNext;
+		}
+
+		pFirst->pNext.store(Unlinked(), std::memory_order_relaxed);
+		T* pPrev = m_pHead.exchange(pLast, std::memory_order_acq_rel);
+		pFirst->pNext.store(pPrev, std::memory_order_release);
+	}
+
+	// consumer only
+	T* Pop()
+	{
+		T* pNode = m_pBatch.load(std::memory_order_relaxed);
+		if (pNode == nullptr)
+		{
+			pNode = Detach();
+			if (pNode == nullptr)
+				return nullptr;
+		}
+
+		m_pBatch.store(pNode->pNext.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return pNode;
+	}
+
+	// exact for the consumer, a hint for anyone else
+	bool IsEmpty() const
+	{
+		return m_pBatch.load(std::memory_order_relaxed) == nullptr && m_pHead.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+	// the shared list is newest first
+	T* Detach()
+	{
+		T* pNode = m_pHead.exchange(nullptr, std::memory_order_acquire);
+
+		T* pReversed = nullptr;
+		while (pNode != nullptr)
+		{
+			// its producer is between the exchange and the store
+			T* pNext = pNode->pNext.load(std::memory_order_acquire);
+			while (pNext == Unlinked())
+			{
+				std::this_thread::yield();
+				pNext = pNode->pNext.load(std::memory_order_acquire);
+			}
+
+			pNode->pNext.store(pReversed, std::memory_order_relaxed);
+			pReversed = pNode;
+			pNode = pNext;
+		}
+
+		return pReversed;
+	}
+
+	static T* Unlinked() { return reinterpret_cast<T*>(1); }
+
+private:
+	std::atomic<T*> m_pHead{ nullptr };
+	std::atomic<T*> m_pBatch{ nullptr }; // atomic only for IsEmpty
+};
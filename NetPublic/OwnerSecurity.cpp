@@ -0,0 +1,90 @@
+#include "OwnerSecurity.h"
+#include <sddl.h>
+#include <string>
+#include <vector>
+
+#pragma comment(lib, "advapi32.lib")
+
+namespace
+{
+bool GetTokenUser(HANDLE hProcess, std::vector<char>& buffer)
+{
+	HANDLE hToken = nullptr;
+	if (!OpenProcessToken(hProcess, TOKEN_QUERY, &hToken))
+		return false;
+
+	DWORD size = 0;
+	GetTokenInformation(hToken, TokenUser, nullptr, 0, &size);
+
+	buffer.resize(size);
+	bool result = size > 0 && GetTokenInformation(hToken, TokenUser, buffer.data(), size, &size);
+
+	CloseHandle(hToken);
+	return result;
+}
+
+PSID GetSid(std::vector<char>& tokenUser)
+{
+	return reinterpret_cast<TOKEN_USER*>(tokenUser.data())->User.Sid;
+}
+} // namespace
+
+OwnerSecurity::OwnerSecurity()
+: m_pDescriptor(nullptr)
+{
+	ZeroMemory(&m_Attributes, sizeof(m_Attributes));
+}
+
+OwnerSecurity::~OwnerSecurity()
+{
+	if (m_pDescriptor != nullptr)
+		LocalFree(m_pDescriptor);
+}
+
+bool OwnerSecurity::Initialize()
+{
+	if (m_pDescriptor != nullptr)
+		return true;
+
+	std::vector<char> tokenUser;
+	if (!GetTokenUser(GetCurrentProcess(), tokenUser))
+		return false;
+
+	LPSTR pSidString = nullptr;
+	if (!ConvertSidToStringSidA(GetSid(tokenUser), &pSidString))
+		return false;
+
+	// protected, so nothing is inherited. the network deny comes first, it wins over the allow
+	std::string sddl = "D:P(D;;GA;;;NU)(A;;GA;;;";
+	sddl += pSidString;
+	sddl += ")";
+	LocalFree(pSidString);
+
+	if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1, &m_pDescriptor, nullptr))
+	{
+		m_pDescriptor = nullptr;
+		return false;
+	}
+
+	m_Attributes.nLength = sizeof(m_Attributes);
+	m_Attributes.lpSecurityDescriptor = m_pDescriptor;
+	m_Attributes.bInheritHandle = FALSE;
+	return true;
+}
+
+bool OwnerSecurity::IsOwnerProcess(DWORD processId)
+{
+	std::vector<char> ownUser;
+	if (!GetTokenUser(GetCurrentProcess(), ownUser))
+		return false;
+
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+	if (hProcess == nullptr)
+		return false;
+
+	std::vector<char> peerUser;
+	bool			  result = GetTokenUser(hProcess, peerUser) && EqualSid(GetSid(ownUser), GetSid(peerUser));
+
+	CloseHandle(hProcess);
+	return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <windows.h>
+
+// the DACL admits this process's account, nothing over the network
+class OwnerSecurity
+{
+public:
+	OwnerSecurity();
+	~OwnerSecurity();
+	OwnerSecurity(const OwnerSecurity&) = delete;
+	OwnerSecurity& operator=(const OwnerSecurity&) = delete;
+
+	bool				 Initialize();
+	SECURITY_ATTRIBUTES* Get() { return &m_Attributes; }
+
+	// the process runs as the same account as this one
+	static bool IsOwnerProcess(DWORD processId);
+
+private:
+	SECURITY_ATTRIBUTES	 m_Attributes;
+	PSECURITY_DESCRIPTOR m_pDescriptor;
+};
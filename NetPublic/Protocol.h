@@ -1,15 +1,28 @@
 #pragma once
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <atomic>
+
+#include "Crc32c.h"
+#include "ChaCha20Poly1305.h"
 
 static constexpr int MAX_PAYLOAD_SIZE = 65535;
+static constexpr int INTEGRITY_TRAILER_SIZE = 4;
+
+using SESSION_UID = long long;
 
 template <typename T>
 class ThreadLocalMemoryPool;
 
+template <typename T>
+class MpscQueue;
+
 enum class PACKET_TYPE : short
 {
 	SYSTEM,
-	USER
+	USER,
+	USER_CONTINUED // a MessageChain fragment, the next frame continues the same payload
 };
 
 #pragma pack(1)
@@ -24,6 +37,8 @@ class MESSAGE
 	friend class NetServer;
 	friend class NetClient;
 	friend class ThreadLocalMemoryPool<MESSAGE>;
+	friend class MpscQueue<MESSAGE>;
+	friend class MessageChain;
 
 private:
 	MESSAGE() = default;
@@ -39,12 +54,81 @@ public:
 		return true;
 	}
 
+	// CRC32C of header and payload, appended and counted in header.length
+	bool SealIntegrity()
+	{
+		// header.length is a short, the framer drops a negative one
+		const int payloadSize = (unsigned short)header.length;
+		if (payloadSize + INTEGRITY_TRAILER_SIZE > SHRT_MAX)
+			return false;
+
+		header.length = (short)(payloadSize + INTEGRITY_TRAILER_SIZE);
+
+		const unsigned int crc = ComputeCrc32c(this, sizeof(header) + payloadSize);
+		std::memcpy(payload + payloadSize, &crc, sizeof(crc));
+		return true;
+	}
+
+	bool CheckIntegrity()
+	{
+		const int payloadSize = (unsigned short)header.length - INTEGRITY_TRAILER_SIZE;
+		if (payloadSize < 0)
+			return false;
+
+		unsigned int crc;
+		std::memcpy(&crc, payload + payloadSize, sizeof(crc));
+		if (ComputeCrc32c(this, sizeof(header) + payloadSize) != crc)
+			return false;
+
+		header.length = (short)payloadSize;
+		return true;
+	}
+
+	// the tag is appended the same way, the header is associated data
+	bool Encrypt(AEAD_STATE& state)
+	{
+		const int payloadSize = (unsigned short)header.length;
+		if (payloadSize + POLY1305_TAG_SIZE > SHRT_MAX)
+			return false;
+
+		header.length = (short)(payloadSize + POLY1305_TAG_SIZE);
+
+		ChaCha20Poly1305Seal(state.key, state.counter++, &header, sizeof(header), payload, payloadSize, (unsigned char*)payload + payloadSize);
+		return true;
+	}
+
+	bool Decrypt(AEAD_STATE& state)
+	{
+		const int payloadSize = (unsigned short)header.length - POLY1305_TAG_SIZE;
+		if (payloadSize < 0)
+			return false;
+
+		if (!ChaCha20Poly1305Open(state.key, state.counter, &header, sizeof(header), payload, payloadSize, (const unsigned char*)payload + payloadSize))
+			return false;
+
+		++state.counter;
+		header.length = (short)payloadSize;
+		return true;
+	}
+
 	char* GetPayload() { return payload; }
 	short GetPayloadSize() { return header.length; }
-	void  Reset() { header.length = 0; }
+	void  Reset()
+	{
+		header.type = PACKET_TYPE::USER;
+		header.length = 0;
+		traceId = 0;
+	}
 
 private:
 	HEADER header;
 	char   payload[MAX_PAYLOAD_SIZE];
+
+	// not sent. the padding puts them on an 8 byte boundary, pool blocks are at least that aligned
+	char				  padding[5];
+	long long			  queuedTick; // stamped when the frame is queued for send
+	std::atomic<MESSAGE*> pNext;	  // send queue link, then the in-flight list
+	std::atomic<int>	  shareCount; // sessions a published frame is still queued or in flight for
+	unsigned int		  traceId;	  // 0 unless sampled by the tracer
 };
 #pragma pack()
@@ -7,12 +7,24 @@ RingBuffer::RingBuffer(size_t size)
 , m_tail(0)
 , m_used(0)
 , m_buffer(new char[size])
+, m_ownBuffer(true)
+{
+}
+
+RingBuffer::RingBuffer(char* pBuffer, size_t size)
+: m_size(size)
+, m_head(0)
+, m_tail(0)
+, m_used(0)
+, m_buffer(pBuffer)
+, m_ownBuffer(false)
 {
 }
 
 RingBuffer::~RingBuffer()
 {
-	delete[] m_buffer;
+	if (m_ownBuffer)
+		delete[] m_buffer;
 }
 
 bool RingBuffer::put(const char* pData, size_t size)
@@ -10,6 +10,7 @@ class RingBuffer
 {
 public:
 	explicit RingBuffer(size_t size);
+	RingBuffer(char* pBuffer, size_t size);
 	~RingBuffer();
 
 	bool   put(const char* pData, size_t size);
@@ -33,6 +34,7 @@ private:
 	size_t m_tail;
 	size_t m_used;
 	char*  m_buffer;
+	bool   m_ownBuffer;
 
 	std::mutex				m_mutex;
 	std::condition_variable m_cond;
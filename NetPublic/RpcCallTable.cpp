@@ -0,0 +1,87 @@
+#include "RpcCallTable.h"
+
+RPC_CALL_ID RpcCallTable::Add(RPC_CALLBACK callback, DWORD timeoutMs)
+{
+	// 0 is never handed out, so a zeroed packet can't match a call
+	RPC_CALL_ID callId = m_NextCallId++;
+	if (callId == 0)
+		callId = m_NextCallId++;
+
+	const ULONGLONG deadline = timeoutMs > 0 ? GetTickCount64() + timeoutMs : ULLONG_MAX;
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_mapCalls[callId] = PENDING_CALL{ std::move(callback), deadline };
+	if (deadline < m_NextDeadline)
+		m_NextDeadline = deadline;
+
+	return callId;
+}
+
+// the callback doesn't run
+bool RpcCallTable::Remove(RPC_CALL_ID callId)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	return m_mapCalls.erase(callId) > 0;
+}
+
+// false if the call already timed out or was never made
+bool RpcCallTable::Complete(RPC_CALL_ID callId, RPC_STATUS status, const char* pBody, int bodySize)
+{
+	RPC_CALLBACK callback;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		auto iter = m_mapCalls.find(callId);
+		if (iter == m_mapCalls.end())
+			return false;
+
+		callback = std::move(iter->second.callback);
+		m_mapCalls.erase(iter);
+	}
+
+	callback(status, pBody, bodySize);
+	return true;
+}
+
+void RpcCallTable::Expire(ULONGLONG now)
+{
+	if (now < m_NextDeadline)
+		return;
+
+	std::vector<RPC_CALLBACK> vecExpired;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+
+		ULONGLONG nextDeadline = ULLONG_MAX;
+		for (auto iter = m_mapCalls.begin(); iter != m_mapCalls.end();)
+		{
+			if (iter->second.deadline <= now)
+			{
+				vecExpired.push_back(std::move(iter->second.callback));
+				iter = m_mapCalls.erase(iter);
+				continue;
+			}
+
+			if (iter->second.deadline < nextDeadline)
+				nextDeadline = iter->second.deadline;
+			++iter;
+		}
+
+		m_NextDeadline = nextDeadline;
+	}
+
+	for (RPC_CALLBACK& callback : vecExpired)
+		callback(RPC_STATUS::TIMEOUT, nullptr, 0);
+}
+
+void RpcCallTable::FailAll(RPC_STATUS status)
+{
+	std::unordered_map<RPC_CALL_ID, PENDING_CALL> mapFailed;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		mapFailed.swap(m_mapCalls);
+		m_NextDeadline = ULLONG_MAX;
+	}
+
+	for (auto& call : mapFailed)
+		call.second.callback(status, nullptr, 0);
+}
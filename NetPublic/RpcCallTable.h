@@ -0,0 +1,52 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using RPC_CALL_ID = unsigned int;
+
+enum class RPC_STATUS : int
+{
+	OK,
+	NO_METHOD,
+	TIMEOUT,	  // a later reply is dropped
+	DISCONNECTED,
+	FAILED
+};
+
+// pBody is only valid during the call, and nullptr unless the peer replied
+using RPC_CALLBACK = std::function<void(RPC_STATUS status, const char* pBody, int bodySize)>;
+
+struct RPC_RESULT
+{
+	RPC_STATUS		  status;
+	std::vector<char> body;
+};
+
+// every callback runs exactly once, outside the lock
+class RpcCallTable
+{
+public:
+	// timeoutMs 0 waits until the reply or the disconnect
+	RPC_CALL_ID Add(RPC_CALLBACK callback, DWORD timeoutMs);
+	bool		Remove(RPC_CALL_ID callId);
+	bool		Complete(RPC_CALL_ID callId, RPC_STATUS status, const char* pBody, int bodySize);
+	void		Expire(ULONGLONG now);
+	void		FailAll(RPC_STATUS status);
+
+private:
+	struct PENDING_CALL
+	{
+		RPC_CALLBACK callback;
+		ULONGLONG	 deadline;
+	};
+
+	std::mutex								   m_Lock;
+	std::unordered_map<RPC_CALL_ID, PENDING_CALL> m_mapCalls;
+	std::atomic<RPC_CALL_ID>				   m_NextCallId{ 1 };
+	std::atomic<ULONGLONG>					   m_NextDeadline{ ULLONG_MAX };
+};
@@ -0,0 +1,285 @@
+#include "ShmTransport.h"
+#include "OwnerSecurity.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+constexpr DWORD SHM_HEADER_SIZE = sizeof(SHM_RING) * 2;
+
+HANDLE CreateRingEvent(const char* name, int ringIndex, SECURITY_ATTRIBUTES* pSecurity)
+{
+	char eventName[SHM_NAME_SIZE + 8];
+	std::snprintf(eventName, sizeof(eventName), "%s_%d", name, ringIndex);
+
+	// an event someone else made under our name is never used
+	if (pSecurity != nullptr)
+	{
+		HANDLE hEvent = CreateEventA(pSecurity, FALSE, FALSE, eventName);
+		if (hEvent != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			CloseHandle(hEvent);
+			return nullptr;
+		}
+		return hEvent;
+	}
+
+	return OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, eventName);
+}
+} // namespace
+
+ShmChannel::ShmChannel()
+: m_hMapping(nullptr)
+, m_pView(nullptr)
+, m_RingSize(0)
+, m_pSendRing(nullptr)
+, m_pSendData(nullptr)
+, m_hSendEvent(nullptr)
+, m_pRecvRing(nullptr)
+, m_pRecvData(nullptr)
+, m_hRecvEvent(nullptr)
+{
+}
+
+ShmChannel::~ShmChannel()
+{
+	Close();
+}
+
+bool ShmChannel::Create(const char* name, unsigned int ringSize)
+{
+	if (ringSize < SHM_MIN_RING_SIZE || (ringSize & (ringSize - 1)) != 0)
+		return false;
+
+	return Map(name, true, ringSize);
+}
+
+bool ShmChannel::Open(const char* name)
+{
+	return Map(name, false, 0);
+}
+
+bool ShmChannel::Map(const char* name, bool create, unsigned int ringSize)
+{
+	if (IsOpen() || name == nullptr)
+		return false;
+
+	OwnerSecurity security;
+	if (create && !security.Initialize())
+		return false;
+
+	SECURITY_ATTRIBUTES* pSecurity = create ? security.Get() : nullptr;
+
+	if (create)
+	{
+		DWORD mappingSize = SHM_HEADER_SIZE + ringSize * 2;
+		m_hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, pSecurity, PAGE_READWRITE, 0, mappingSize, name);
+		if (m_hMapping != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			Close();
+			return false;
+		}
+	}
+	else
+	{
+		m_hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+	}
+
+	if (m_hMapping == nullptr)
+		return false;
+
+	m_pView = MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (m_pView == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	SHM_RING* pRing = static_cast<SHM_RING*>(m_pView);
+	if (create)
+	{
+		// consumers start marked waiting, so the first frame signals
+		for (int ringIndex = 0; ringIndex < 2; ++ringIndex)
+		{
+			pRing[ringIndex].size = ringSize;
+			pRing[ringIndex].consumerWaiting = 1;
+		}
+	}
+	else
+	{
+		// read once, and must fit the mapped view
+		ringSize = pRing[0].size;
+
+		MEMORY_BASIC_INFORMATION viewInfo;
+		if (ringSize < SHM_MIN_RING_SIZE || (ringSize & (ringSize - 1)) != 0 || VirtualQuery(m_pView, &viewInfo, sizeof(viewInfo)) == 0 ||
+			viewInfo.RegionSize < SHM_HEADER_SIZE + (size_t)ringSize * 2)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_RingSize = ringSize;
+
+	char* pData = static_cast<char*>(m_pView) + SHM_HEADER_SIZE;
+
+	const int sendIndex = create ? 0 : 1;
+	const int recvIndex = 1 - sendIndex;
+
+	m_pSendRing = &pRing[sendIndex];
+	m_pSendData = pData + (size_t)ringSize * sendIndex;
+	m_hSendEvent = CreateRingEvent(name, sendIndex, pSecurity);
+
+	m_pRecvRing = &pRing[recvIndex];
+	m_pRecvData = pData + (size_t)ringSize * recvIndex;
+	m_hRecvEvent = CreateRingEvent(name, recvIndex, pSecurity);
+
+	if (m_hSendEvent == nullptr || m_hRecvEvent == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void ShmChannel::Close()
+{
+	if (m_pView != nullptr)
+		UnmapViewOfFile(m_pView);
+
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+
+	if (m_hSendEvent != nullptr)
+		CloseHandle(m_hSendEvent);
+
+	if (m_hRecvEvent != nullptr)
+		CloseHandle(m_hRecvEvent);
+
+	m_hMapping = nullptr;
+	m_pView = nullptr;
+	m_RingSize = 0;
+	m_pSendRing = nullptr;
+	m_pSendData = nullptr;
+	m_hSendEvent = nullptr;
+	m_pRecvRing = nullptr;
+	m_pRecvData = nullptr;
+	m_hRecvEvent = nullptr;
+}
+
+bool ShmChannel::Write(MESSAGE* pMessage)
+{
+	const unsigned int frameSize = sizeof(HEADER) + (unsigned short)pMessage->GetPayloadSize();
+
+	unsigned int head = m_pSendRing->head.load(std::memory_order_relaxed);
+	unsigned int tail = m_pSendRing->tail.load(std::memory_order_acquire);
+	if (m_RingSize - (head - tail) < frameSize)
+		return false;
+
+	CopyIn(m_pSendData, head, (const char*)pMessage, frameSize);
+	m_pSendRing->head.store(head + frameSize);
+
+	if (m_pSendRing->consumerWaiting.exchange(0) != 0)
+		SetEvent(m_hSendEvent);
+
+	return true;
+}
+
+bool ShmChannel::IsEmpty() const
+{
+	return m_pRecvRing->head.load(std::memory_order_acquire) == m_pRecvRing->tail.load(std::memory_order_relaxed);
+}
+
+int ShmChannel::PeekFrameSize() const
+{
+	unsigned int tail = m_pRecvRing->tail.load(std::memory_order_relaxed);
+	unsigned int head = m_pRecvRing->head.load(std::memory_order_acquire);
+	if (head - tail < sizeof(HEADER))
+		return 0;
+
+	HEADER header;
+	CopyOut(m_pRecvData, tail, (char*)&header, sizeof(header));
+
+	const unsigned int frameSize = sizeof(header) + (unsigned short)header.length;
+	if (head - tail < frameSize)
+		return 0;
+
+	return (int)frameSize;
+}
+
+bool ShmChannel::Read(MESSAGE* pMessage)
+{
+	unsigned int tail = m_pRecvRing->tail.load(std::memory_order_relaxed);
+	unsigned int head = m_pRecvRing->head.load(std::memory_order_acquire);
+	if (head - tail < sizeof(HEADER))
+		return false;
+
+	HEADER header;
+	CopyOut(m_pRecvData, tail, (char*)&header, sizeof(header));
+
+	const unsigned int frameSize = sizeof(header) + (unsigned short)header.length;
+	if (head - tail < frameSize)
+		return false;
+
+	CopyOut(m_pRecvData, tail, (char*)pMessage, frameSize);
+	m_pRecvRing->tail.store(tail + frameSize, std::memory_order_release);
+
+	return true;
+}
+
+bool ShmChannel::Wait(DWORD timeoutMs)
+{
+	for (int spin = 0; spin < SHM_SPIN_COUNT; ++spin)
+	{
+		if (!IsEmpty())
+			return true;
+
+		YieldProcessor();
+	}
+
+	if (!PrepareWait())
+		return true;
+
+	WaitForSingleObject(m_hRecvEvent, timeoutMs);
+	CancelWait();
+
+	return !IsEmpty();
+}
+
+bool ShmChannel::PrepareWait()
+{
+	// checked again after publishing the flag
+	m_pRecvRing->consumerWaiting.store(1);
+	if (!IsEmpty())
+	{
+		CancelWait();
+		return false;
+	}
+
+	return true;
+}
+
+void ShmChannel::CancelWait()
+{
+	m_pRecvRing->consumerWaiting.store(0);
+}
+
+void ShmChannel::CopyIn(char* pData, unsigned int offset, const char* pSource, unsigned int size)
+{
+	unsigned int index = offset & (m_RingSize - 1);
+	unsigned int firstSize = (std::min)(size, m_RingSize - index);
+
+	std::memcpy(pData + index, pSource, firstSize);
+	std::memcpy(pData, pSource + firstSize, size - firstSize);
+}
+
+void ShmChannel::CopyOut(const char* pData, unsigned int offset, char* pDest, unsigned int size) const
+{
+	unsigned int index = offset & (m_RingSize - 1);
+	unsigned int firstSize = (std::min)(size, m_RingSize - index);
+
+	std::memcpy(pDest, pData + index, firstSize);
+	std::memcpy(pDest + firstSize, pData, size - firstSize);
+}
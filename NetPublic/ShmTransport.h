@@ -0,0 +1,64 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+
+#include "Protocol.h"
+#include "GlobalValue.h"
+
+constexpr unsigned int SHM_RING_SIZE = 1 << 20;
+constexpr unsigned int SHM_MIN_RING_SIZE = 1 << 17; // always holds a whole frame
+constexpr int		   SHM_SPIN_COUNT = 4000;
+
+// head and tail wrap at 2^32, size is a power of two. the peer can write size, it is read once at map time
+struct SHM_RING
+{
+	unsigned int size;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> head; // written by the producer
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> tail; // written by the consumer
+	alignas(CACHE_LINE_SIZE) std::atomic<int>		   consumerWaiting;
+};
+
+// the creator sends on ring 0, the opener on ring 1. frames are stored as on the wire
+class ShmChannel
+{
+public:
+	ShmChannel();
+	~ShmChannel();
+
+	bool Create(const char* name, unsigned int ringSize);
+	bool Open(const char* name);
+	void Close();
+	bool IsOpen() const { return m_pView != nullptr; }
+
+	// false when the frame doesn't fit
+	bool Write(MESSAGE* pMessage);
+
+	bool   IsEmpty() const;
+	int	   PeekFrameSize() const; // 0 until a whole frame is in the ring
+	bool   Read(MESSAGE* pMessage);
+	bool   Wait(DWORD timeoutMs);
+	bool   PrepareWait();
+	void   CancelWait();
+	void   Wake() { SetEvent(m_hRecvEvent); }
+	HANDLE GetRecvEvent() const { return m_hRecvEvent; }
+
+private:
+	bool Map(const char* name, bool create, unsigned int ringSize);
+
+	void CopyIn(char* pData, unsigned int offset, const char* pSource, unsigned int size);
+	void CopyOut(const char* pData, unsigned int offset, char* pDest, unsigned int size) const;
+
+private:
+	HANDLE		 m_hMapping;
+	void*		 m_pView;
+	unsigned int m_RingSize;
+
+	SHM_RING* m_pSendRing;
+	char*	  m_pSendData;
+	HANDLE	  m_hSendEvent;
+
+	SHM_RING* m_pRecvRing;
+	char*	  m_pRecvData;
+	HANDLE	  m_hRecvEvent;
+};
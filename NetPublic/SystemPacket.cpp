@@ -6,3 +6,82 @@ SystemPacket_TestPacket::SystemPacket_TestPacket()
 	SetType(ePacketType_Test);
 	SetSize(sizeof(SystemPacket_TestPacket));
 }
+
+SystemPacket_UdpBind::SystemPacket_UdpBind()
+{
+	SetType(ePacketType_UdpBind);
+	SetSize(sizeof(SystemPacket_UdpBind));
+}
+
+SystemPacket_ShmOffer::SystemPacket_ShmOffer()
+{
+	SetType(ePacketType_ShmOffer);
+	SetSize(sizeof(SystemPacket_ShmOffer));
+	m_Name[0] = 0;
+}
+
+SystemPacket_ShmReady::SystemPacket_ShmReady()
+{
+	SetType(ePacketType_ShmReady);
+	SetSize(sizeof(SystemPacket_ShmReady));
+}
+
+SystemPacket_ShmSwitch::SystemPacket_ShmSwitch()
+{
+	SetType(ePacketType_ShmSwitch);
+	SetSize(sizeof(SystemPacket_ShmSwitch));
+}
+
+SystemPacket_IntegrityOffer::SystemPacket_IntegrityOffer()
+{
+	SetType(ePacketType_IntegrityOffer);
+	SetSize(sizeof(SystemPacket_IntegrityOffer));
+}
+
+SystemPacket_IntegrityReady::SystemPacket_IntegrityReady()
+{
+	SetType(ePacketType_IntegrityReady);
+	SetSize(sizeof(SystemPacket_IntegrityReady));
+}
+
+SystemPacket_IntegritySwitch::SystemPacket_IntegritySwitch()
+{
+	SetType(ePacketType_IntegritySwitch);
+	SetSize(sizeof(SystemPacket_IntegritySwitch));
+}
+
+SystemPacket_CryptoOffer::SystemPacket_CryptoOffer()
+{
+	SetType(ePacketType_CryptoOffer);
+	SetSize(sizeof(SystemPacket_CryptoOffer));
+	std::memset(m_PublicKey, 0, sizeof(m_PublicKey));
+}
+
+SystemPacket_CryptoReady::SystemPacket_CryptoReady()
+{
+	SetType(ePacketType_CryptoReady);
+	SetSize(sizeof(SystemPacket_CryptoReady));
+	std::memset(m_PublicKey, 0, sizeof(m_PublicKey));
+}
+
+SystemPacket_CryptoSwitch::SystemPacket_CryptoSwitch()
+{
+	SetType(ePacketType_CryptoSwitch);
+	SetSize(sizeof(SystemPacket_CryptoSwitch));
+}
+
+SystemPacket_RpcRequest::SystemPacket_RpcRequest()
+{
+	SetType(ePacketType_RpcRequest);
+	SetSize(sizeof(SystemPacket_RpcRequest));
+	m_CallId = 0;
+	m_Method = 0;
+}
+
+SystemPacket_RpcResponse::SystemPacket_RpcResponse()
+{
+	SetType(ePacketType_RpcResponse);
+	SetSize(sizeof(SystemPacket_RpcResponse));
+	m_CallId = 0;
+	m_Status = RPC_STATUS::OK;
+}
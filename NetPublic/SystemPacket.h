@@ -1,5 +1,9 @@
 #pragma once
 #include "SystemPacketHeader.h"
+#include "Protocol.h"
+#include "GlobalValue.h"
+#include "X25519.h"
+#include "RpcCallTable.h"
 
 class SystemPacket_TestPacket : public SystemPacketHeader
 {
@@ -9,3 +13,96 @@ public:
 	int m_iMind;
 	int m_iIndex;
 };
+
+// server -> client right after accept, the client echoes both fields in every UDP datagram
+class SystemPacket_UdpBind : public SystemPacketHeader
+{
+public:
+	SystemPacket_UdpBind();
+	SESSION_UID m_SessionUID;
+	int			m_Token;
+};
+
+// server -> client right after accept when both ends are on the same host
+class SystemPacket_ShmOffer : public SystemPacketHeader
+{
+public:
+	SystemPacket_ShmOffer();
+	char m_Name[SHM_NAME_SIZE];
+};
+
+// client -> server once the offered mapping is open, the last frame the client sends over TCP
+class SystemPacket_ShmReady : public SystemPacketHeader
+{
+public:
+	SystemPacket_ShmReady();
+};
+
+// server -> client, the last frame the server sends over TCP
+class SystemPacket_ShmSwitch : public SystemPacketHeader
+{
+public:
+	SystemPacket_ShmSwitch();
+};
+
+// server -> client right after accept when the server runs in integrity mode
+class SystemPacket_IntegrityOffer : public SystemPacketHeader
+{
+public:
+	SystemPacket_IntegrityOffer();
+};
+
+// client -> server, the last frame the client sends without a CRC32C trailer
+class SystemPacket_IntegrityReady : public SystemPacketHeader
+{
+public:
+	SystemPacket_IntegrityReady();
+};
+
+// server -> client, the last frame the server sends without a CRC32C trailer
+class SystemPacket_IntegritySwitch : public SystemPacketHeader
+{
+public:
+	SystemPacket_IntegritySwitch();
+};
+
+// server -> client right after accept when the server runs encrypted sessions, an ephemeral X25519 key
+class SystemPacket_CryptoOffer : public SystemPacketHeader
+{
+public:
+	SystemPacket_CryptoOffer();
+	unsigned char m_PublicKey[X25519_KEY_SIZE];
+};
+
+// client -> server, the client's ephemeral key and the last frame the client sends in plaintext
+class SystemPacket_CryptoReady : public SystemPacketHeader
+{
+public:
+	SystemPacket_CryptoReady();
+	unsigned char m_PublicKey[X25519_KEY_SIZE];
+};
+
+// server -> client, the last frame the server sends in plaintext
+class SystemPacket_CryptoSwitch : public SystemPacketHeader
+{
+public:
+	SystemPacket_CryptoSwitch();
+};
+
+// client -> server, the request body follows the packet in the same frame and the size covers both
+class SystemPacket_RpcRequest : public SystemPacketHeader
+{
+public:
+	SystemPacket_RpcRequest();
+	RPC_CALL_ID m_CallId;
+	int			m_Method;
+};
+
+// server -> client, the reply body follows the same way. replies come back in any order
+class SystemPacket_RpcResponse : public SystemPacketHeader
+{
+public:
+	SystemPacket_RpcResponse();
+	RPC_CALL_ID m_CallId;
+	RPC_STATUS	m_Status;
+};
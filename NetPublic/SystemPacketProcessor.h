@@ -20,6 +20,8 @@ public:
 		m_mapProcessors.insert(std::make_pair(packet.GetType(), [=](SESSION* pSession, SystemPacketHeader* pPacket) {
 			fProcessor(pSession, pPacket);
 		}));
+
+		return true;
 	}
 
 	bool RunProcessor(SESSION* pSession, MESSAGE* pMessage)
@@ -31,7 +33,14 @@ public:
 		if (pPayload == nullptr)
 			return false;
 
+		// packets with a body after them, such as RPC, are trusted with their size only within the frame
+		const int payloadSize = (unsigned short)pMessage->GetPayloadSize();
+		if (payloadSize < (int)sizeof(SystemPacketHeader))
+			return false;
+
 		SystemPacketHeader* pSystemPacket = reinterpret_cast<SystemPacketHeader*>(pPayload);
+		if (pSystemPacket->GetSize() < (int)sizeof(SystemPacketHeader) || pSystemPacket->GetSize() > payloadSize)
+			return false;
 
 		auto it = m_mapProcessors.find(pSystemPacket->GetType());
 		if (it == m_mapProcessors.end())
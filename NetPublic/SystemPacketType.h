@@ -4,4 +4,16 @@ enum ESystemPacketType
 {
 	ePacketType_Begin_1000 = 1000,
 	ePacketType_Test,
+	ePacketType_UdpBind,
+	ePacketType_ShmOffer,
+	ePacketType_ShmReady,
+	ePacketType_ShmSwitch,
+	ePacketType_IntegrityOffer,
+	ePacketType_IntegrityReady,
+	ePacketType_IntegritySwitch,
+	ePacketType_CryptoOffer,
+	ePacketType_CryptoReady,
+	ePacketType_CryptoSwitch,
+	ePacketType_RpcRequest,
+	ePacketType_RpcResponse,
 };
@@ -6,6 +6,7 @@
 #include <queue>
 #include <concurrent_unordered_map.h>
 #include <concurrent_queue.h>
+#include "LargePageArena.h"
 
 template <typename T>
 class ThreadLocalMemoryPool
@@ -23,39 +24,37 @@ private:
 public:
 	ThreadLocalMemoryPool(size_t block_count)
 	: block_count_(block_count)
+	, arena_(nullptr)
 	{
 		block_size_ = sizeof(BLOCK);
 	}
 
+	// chunks come from the arena on the allocating thread's node
+	void SetArena(LargePageArena* arena) { arena_ = arena; }
+
 	T* Allocate()
 	{
 		BLOCK* block = nullptr;
 		auto&  queue = block_queue();
 
-		while (true)
+		while (!queue.try_pop(block))
 		{
-			if (!queue.try_pop(block))
-			{
-				BLOCK* block_chunk = new (std::nothrow) BLOCK[block_count_];
-				if (block_chunk == nullptr)
-					return nullptr;
-
-				for (size_t i = 0; i < block_count_; ++i)
-				{
-					BLOCK* block = block_chunk + i;
-					block->pQueue = &queue;
-					queue.push(block);
-				}
-			}
-			else
-			{
-				break;
-			}
+			if (!push_chunk(queue))
+				return nullptr;
 		}
 
 		return &block->data;
 	}
 
+	bool Reserve()
+	{
+		auto& queue = block_queue();
+		if (!queue.empty())
+			return true;
+
+		return push_chunk(queue);
+	}
+
 	void Free(T* data)
 	{
 		if (data == nullptr)
@@ -66,10 +65,43 @@ public:
 	}
 
 private:
-	size_t block_count_;
-	size_t block_size_;
+	size_t			block_count_;
+	size_t			block_size_;
+	LargePageArena* arena_;
 
 private:
+	bool push_chunk(Concurrency::concurrent_queue<BLOCK*>& queue)
+	{
+		BLOCK* block_chunk = allocate_chunk();
+		if (block_chunk == nullptr)
+			return false;
+
+		for (size_t i = 0; i < block_count_; ++i)
+		{
+			BLOCK* block = block_chunk + i;
+			block->pQueue = &queue;
+			queue.push(block);
+		}
+
+		return true;
+	}
+
+	BLOCK* allocate_chunk()
+	{
+		if (arena_ == nullptr)
+			return new (std::nothrow) BLOCK[block_count_];
+
+		void* memory = arena_->Allocate(block_size_ * block_count_, LargePageArena::GetCurrentNumaNode());
+		if (memory == nullptr)
+			return nullptr;
+
+		BLOCK* block_chunk = static_cast<BLOCK*>(memory);
+		for (size_t i = 0; i < block_count_; ++i)
+			new (block_chunk + i) BLOCK;
+
+		return block_chunk;
+	}
+
 	Concurrency::concurrent_queue<BLOCK*>& block_queue()
 	{
 		static thread_local Concurrency::concurrent_queue<BLOCK*> queue;
@@ -0,0 +1,73 @@
+#pragma once
+#include <windows.h>
+
+// tokens in thousandths, refilled lazily. not thread safe
+class TokenBucket
+{
+public:
+	TokenBucket()
+	: m_Rate(0)
+	, m_Capacity(0)
+	, m_Tokens(0)
+	, m_LastTick(0)
+	{
+	}
+
+	// ratePerSecond 0 turns it off, burst 0 is one second's worth
+	void Reset(int ratePerSecond, int burst, ULONGLONG now)
+	{
+		m_Rate = ratePerSecond;
+		m_Capacity = (long long)(burst > 0 ? burst : ratePerSecond) * 1000;
+		m_Tokens = m_Capacity;
+		m_LastTick = now;
+	}
+
+	bool IsEnabled() const { return m_Rate > 0; }
+
+	// ms until amount is available. more than the burst is charged as a full bucket
+	DWORD GetWait(int amount, ULONGLONG now)
+	{
+		if (m_Rate <= 0)
+			return 0;
+
+		Refill(now);
+
+		long long deficit = Cost(amount) - m_Tokens;
+		if (deficit <= 0)
+			return 0;
+
+		return (DWORD)((deficit + m_Rate - 1) / m_Rate);
+	}
+
+	// call after GetWait returned 0
+	void Take(int amount)
+	{
+		if (m_Rate > 0)
+			m_Tokens -= Cost(amount);
+	}
+
+private:
+	void Refill(ULONGLONG now)
+	{
+		if (now <= m_LastTick)
+			return;
+
+		m_Tokens += (long long)(now - m_LastTick) * m_Rate;
+		if (m_Tokens > m_Capacity)
+			m_Tokens = m_Capacity;
+
+		m_LastTick = now;
+	}
+
+	long long Cost(int amount) const
+	{
+		long long cost = (long long)amount * 1000;
+		return cost < m_Capacity ? cost : m_Capacity;
+	}
+
+private:
+	int		  m_Rate;
+	long long m_Capacity;
+	long long m_Tokens;
+	ULONGLONG m_LastTick;
+};
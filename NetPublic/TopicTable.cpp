@@ -0,0 +1,57 @@
+#include "TopicTable.h"
+#include <algorithm>
+
+// false if the session already is a member
+bool TopicTable::Subscribe(TOPIC_ID topic, SESSION_UID sessionUID)
+{
+	SHARD&						lockedShard = GetShard(topic);
+	std::lock_guard<std::mutex> lock(lockedShard.lock);
+
+	TOPIC_MEMBERS& members = lockedShard.topics[topic];
+	if (members && std::find(members->begin(), members->end(), sessionUID) != members->end())
+		return false;
+
+	auto pNext = members ? std::make_shared<std::vector<SESSION_UID>>(*members) : std::make_shared<std::vector<SESSION_UID>>();
+	pNext->push_back(sessionUID);
+	members = std::move(pNext);
+	return true;
+}
+
+bool TopicTable::Unsubscribe(TOPIC_ID topic, SESSION_UID sessionUID)
+{
+	SHARD&						lockedShard = GetShard(topic);
+	std::lock_guard<std::mutex> lock(lockedShard.lock);
+
+	auto iter = lockedShard.topics.find(topic);
+	if (iter == lockedShard.topics.end())
+		return false;
+
+	const std::vector<SESSION_UID>& members = *iter->second;
+	auto							memberIter = std::find(members.begin(), members.end(), sessionUID);
+	if (memberIter == members.end())
+		return false;
+
+	if (members.size() == 1)
+	{
+		lockedShard.topics.erase(iter);
+		return true;
+	}
+
+	auto pNext = std::make_shared<std::vector<SESSION_UID>>(members);
+	(*pNext)[memberIter - members.begin()] = pNext->back();
+	pNext->pop_back();
+	iter->second = std::move(pNext);
+	return true;
+}
+
+TOPIC_MEMBERS TopicTable::GetMembers(TOPIC_ID topic) const
+{
+	const SHARD&				lockedShard = GetShard(topic);
+	std::lock_guard<std::mutex> lock(lockedShard.lock);
+
+	auto iter = lockedShard.topics.find(topic);
+	if (iter == lockedShard.topics.end())
+		return nullptr;
+
+	return iter->second;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Protocol.h"
+#include "GlobalValue.h"
+
+using TOPIC_ID = unsigned long long;
+
+// immutable, Publish walks it without a lock
+using TOPIC_MEMBERS = std::shared_ptr<const std::vector<SESSION_UID>>;
+
+// sharded by topic, members are copy on write
+class TopicTable
+{
+public:
+	bool		  Subscribe(TOPIC_ID topic, SESSION_UID sessionUID);
+	bool		  Unsubscribe(TOPIC_ID topic, SESSION_UID sessionUID);
+	TOPIC_MEMBERS GetMembers(TOPIC_ID topic) const;
+
+private:
+	static constexpr int SHARD_COUNT = 64;
+
+	struct alignas(CACHE_LINE_SIZE) SHARD
+	{
+		mutable std::mutex						  lock;
+		std::unordered_map<TOPIC_ID, TOPIC_MEMBERS> topics;
+	};
+
+	SHARD&		 GetShard(TOPIC_ID topic) { return m_Shards[(topic * 0x9E3779B97F4A7C15ULL) >> 58]; }
+	const SHARD& GetShard(TOPIC_ID topic) const { return m_Shards[(topic * 0x9E3779B97F4A7C15ULL) >> 58]; }
+
+private:
+	SHARD m_Shards[SHARD_COUNT];
+};
@@ -0,0 +1,310 @@
+#include "TrafficCapture.h"
+#include <cstdio>
+#include <cstring>
+
+TrafficCapture::TrafficCapture()
+: m_pCurrent(nullptr)
+, m_SegmentSize(CAPTURE_SEGMENT_SIZE)
+, m_SegmentIndex(0)
+, m_TickFrequency(0)
+{
+}
+
+TrafficCapture::~TrafficCapture()
+{
+	Close();
+
+	for (SEGMENT* pSegment : m_vecRetired)
+		delete pSegment;
+}
+
+bool TrafficCapture::Open(const char* pathPrefix, size_t segmentSize)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	if (IsOpen() || pathPrefix == nullptr || segmentSize <= sizeof(CAPTURE_SEGMENT_HEADER))
+		return false;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+
+	m_PathPrefix = pathPrefix;
+	m_SegmentSize = segmentSize;
+	m_SegmentIndex = 0;
+	m_TickFrequency = frequency.QuadPart;
+
+	SEGMENT* pSegment = OpenSegment();
+	if (pSegment == nullptr)
+		return false;
+
+	m_pCurrent = pSegment;
+	return true;
+}
+
+void TrafficCapture::Close()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	SEGMENT* pSegment = m_pCurrent.exchange(nullptr);
+	if (pSegment != nullptr)
+		m_vecRetired.push_back(pSegment);
+
+	// a late writer may still look at its counters
+	for (SEGMENT* pRetired : m_vecRetired)
+	{
+		while (pRetired->writers != 0)
+			YieldProcessor();
+
+		UnmapSegment(pRetired);
+	}
+}
+
+void TrafficCapture::Append(CAPTURE_DIRECTION direction, SESSION_UID sessionUID, MESSAGE* pMessage)
+{
+	const size_t frameSize = sizeof(HEADER) + (unsigned short)pMessage->GetPayloadSize();
+	const size_t recordSize = sizeof(CAPTURE_RECORD) + frameSize;
+	if (recordSize > m_SegmentSize - sizeof(CAPTURE_SEGMENT_HEADER))
+		return;
+
+	LARGE_INTEGER tick;
+	QueryPerformanceCounter(&tick);
+
+	while (true)
+	{
+		SEGMENT* pSegment = m_pCurrent.load();
+		if (pSegment == nullptr)
+			return;
+
+		// announce ourselves first, Roll only unmaps a segment no one is writing into
+		++pSegment->writers;
+		if (m_pCurrent.load() != pSegment)
+		{
+			--pSegment->writers;
+			continue;
+		}
+
+		size_t offset = pSegment->writeOffset.fetch_add(recordSize);
+		if (offset + recordSize <= pSegment->size)
+		{
+			CAPTURE_RECORD record;
+			record.tick = tick.QuadPart;
+			record.sessionUID = sessionUID;
+			record.direction = direction;
+
+			char* pCursor = pSegment->pView + offset;
+			std::memcpy(pCursor, &record, sizeof(record));
+			std::memcpy(pCursor + sizeof(record), (const char*)pMessage, frameSize);
+
+			--pSegment->writers;
+			return;
+		}
+
+		--pSegment->writers;
+		Roll(pSegment);
+	}
+}
+
+std::string TrafficCapture::MakeSegmentPath(const std::string& pathPrefix, int segmentIndex)
+{
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), "_%06d.cap", segmentIndex);
+	return pathPrefix + suffix;
+}
+
+TrafficCapture::SEGMENT* TrafficCapture::OpenSegment()
+{
+	std::string path = MakeSegmentPath(m_PathPrefix, m_SegmentIndex++);
+
+	HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READWRITE, (DWORD)((ULONGLONG)m_SegmentSize >> 32), (DWORD)m_SegmentSize, nullptr);
+	if (hMapping == nullptr)
+	{
+		CloseHandle(hFile);
+		return nullptr;
+	}
+
+	char* pView = static_cast<char*>(MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, m_SegmentSize));
+	if (pView == nullptr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return nullptr;
+	}
+
+	CAPTURE_SEGMENT_HEADER header;
+	header.magic = CAPTURE_MAGIC;
+	header.version = CAPTURE_VERSION;
+	header.tickFrequency = m_TickFrequency;
+	std::memcpy(pView, &header, sizeof(header));
+
+	SEGMENT* pSegment = new SEGMENT;
+	pSegment->hFile = hFile;
+	pSegment->hMapping = hMapping;
+	pSegment->pView = pView;
+	pSegment->size = m_SegmentSize;
+	pSegment->writeOffset = sizeof(header);
+	pSegment->writers = 0;
+
+	return pSegment;
+}
+
+void TrafficCapture::Roll(SEGMENT* pFull)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	// another writer already rolled it
+	if (m_pCurrent.load() != pFull)
+		return;
+
+	m_pCurrent = OpenSegment();
+	m_vecRetired.push_back(pFull);
+
+	for (SEGMENT* pRetired : m_vecRetired)
+	{
+		if (pRetired->writers == 0)
+			UnmapSegment(pRetired);
+	}
+}
+
+void TrafficCapture::UnmapSegment(SEGMENT* pSegment)
+{
+	if (pSegment->pView == nullptr)
+		return;
+
+	UnmapViewOfFile(pSegment->pView);
+	CloseHandle(pSegment->hMapping);
+	CloseHandle(pSegment->hFile);
+
+	pSegment->pView = nullptr;
+	pSegment->hMapping = nullptr;
+	pSegment->hFile = nullptr;
+}
+
+CaptureReader::CaptureReader()
+: m_SegmentIndex(0)
+, m_hFile(INVALID_HANDLE_VALUE)
+, m_hMapping(nullptr)
+, m_pView(nullptr)
+, m_Size(0)
+, m_ReadOffset(0)
+, m_TickFrequency(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+	Close();
+}
+
+bool CaptureReader::Open(const char* pathPrefix)
+{
+	if (pathPrefix == nullptr)
+		return false;
+
+	Close();
+
+	m_PathPrefix = pathPrefix;
+	return OpenSegment(0);
+}
+
+void CaptureReader::Close()
+{
+	CloseSegment();
+	m_SegmentIndex = 0;
+}
+
+bool CaptureReader::Next(CAPTURE_RECORD& record, const char*& pFrame, int& frameSize)
+{
+	while (m_pView != nullptr)
+	{
+		if (m_ReadOffset + sizeof(CAPTURE_RECORD) + sizeof(HEADER) <= m_Size)
+		{
+			std::memcpy(&record, m_pView + m_ReadOffset, sizeof(record));
+
+			HEADER header;
+			std::memcpy(&header, m_pView + m_ReadOffset + sizeof(record), sizeof(header));
+
+			frameSize = sizeof(header) + (unsigned short)header.length;
+			if (record.tick != 0 && m_ReadOffset + sizeof(record) + frameSize <= m_Size)
+			{
+				pFrame = m_pView + m_ReadOffset + sizeof(record);
+				m_ReadOffset += sizeof(record) + frameSize;
+				return true;
+			}
+		}
+
+		// zero filled tail, the rest of the capture is in the next segment
+		if (!OpenSegment(m_SegmentIndex + 1))
+			return false;
+	}
+
+	return false;
+}
+
+bool CaptureReader::OpenSegment(int segmentIndex)
+{
+	CloseSegment();
+
+	std::string path = TrafficCapture::MakeSegmentPath(m_PathPrefix, segmentIndex);
+
+	m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(CAPTURE_SEGMENT_HEADER))
+	{
+		CloseSegment();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr)
+	{
+		CloseSegment();
+		return false;
+	}
+
+	m_pView = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_pView == nullptr)
+	{
+		CloseSegment();
+		return false;
+	}
+
+	CAPTURE_SEGMENT_HEADER header;
+	std::memcpy(&header, m_pView, sizeof(header));
+	if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION)
+	{
+		CloseSegment();
+		return false;
+	}
+
+	m_SegmentIndex = segmentIndex;
+	m_Size = (size_t)fileSize.QuadPart;
+	m_ReadOffset = sizeof(header);
+	m_TickFrequency = header.tickFrequency;
+
+	return true;
+}
+
+void CaptureReader::CloseSegment()
+{
+	if (m_pView != nullptr)
+		UnmapViewOfFile(m_pView);
+
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+	m_pView = nullptr;
+	m_Size = 0;
+	m_ReadOffset = 0;
+}
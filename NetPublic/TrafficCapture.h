@@ -0,0 +1,104 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Protocol.h"
+
+constexpr size_t	   CAPTURE_SEGMENT_SIZE = 64 * 1024 * 1024;
+constexpr unsigned int CAPTURE_MAGIC = 0x50414354; // "TCAP"
+constexpr unsigned int CAPTURE_VERSION = 1;
+
+enum class CAPTURE_DIRECTION : char
+{
+	RECV,
+	SEND
+};
+
+#pragma pack(1)
+struct CAPTURE_SEGMENT_HEADER
+{
+	unsigned int magic;
+	unsigned int version;
+	LONGLONG	 tickFrequency; // QueryPerformanceFrequency of the capturing host
+};
+
+// followed by the frame exactly as it went over the wire, HEADER and payload.
+// a zero tick marks the unused tail of a segment
+struct CAPTURE_RECORD
+{
+	LONGLONG		  tick;
+	SESSION_UID		  sessionUID;
+	CAPTURE_DIRECTION direction;
+};
+#pragma pack()
+
+// writers reserve with one atomic add, the lock is only taken to roll over
+class TrafficCapture
+{
+	struct SEGMENT
+	{
+		HANDLE				hFile;
+		HANDLE				hMapping;
+		char*				pView;
+		size_t				size;
+		std::atomic<size_t> writeOffset;
+		std::atomic<int>	writers;
+	};
+
+public:
+	TrafficCapture();
+	~TrafficCapture();
+
+	bool Open(const char* pathPrefix, size_t segmentSize = CAPTURE_SEGMENT_SIZE);
+	void Close();
+	bool IsOpen() const { return m_pCurrent.load(std::memory_order_relaxed) != nullptr; }
+
+	void Append(CAPTURE_DIRECTION direction, SESSION_UID sessionUID, MESSAGE* pMessage);
+
+	static std::string MakeSegmentPath(const std::string& pathPrefix, int segmentIndex);
+
+private:
+	SEGMENT* OpenSegment();
+	void	 Roll(SEGMENT* pFull);
+	void	 UnmapSegment(SEGMENT* pSegment);
+
+private:
+	std::atomic<SEGMENT*> m_pCurrent;
+	std::mutex			  m_lock;
+	std::vector<SEGMENT*> m_vecRetired;
+	std::string			  m_PathPrefix;
+	size_t				  m_SegmentSize;
+	int					  m_SegmentIndex;
+	LONGLONG			  m_TickFrequency;
+};
+
+class CaptureReader
+{
+public:
+	CaptureReader();
+	~CaptureReader();
+
+	bool Open(const char* pathPrefix);
+	void Close();
+
+	// pFrame points into the mapped segment and stays valid until the next call
+	bool	 Next(CAPTURE_RECORD& record, const char*& pFrame, int& frameSize);
+	LONGLONG GetTickFrequency() const { return m_TickFrequency; }
+
+private:
+	bool OpenSegment(int segmentIndex);
+	void CloseSegment();
+
+private:
+	std::string m_PathPrefix;
+	int			m_SegmentIndex;
+	HANDLE		m_hFile;
+	HANDLE		m_hMapping;
+	const char* m_pView;
+	size_t		m_Size;
+	size_t		m_ReadOffset;
+	LONGLONG	m_TickFrequency;
+};
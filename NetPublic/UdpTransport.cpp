@@ -0,0 +1,470 @@
+#include "UdpTransport.h"
+#include <WS2tcpip.h>
+
+UdpPeer::UdpPeer()
+: m_SessionUID(0)
+, m_Token(0)
+, m_Bound(false)
+{
+	ZeroMemory(&m_Address, sizeof(m_Address));
+	m_Carry.pMessage = nullptr;
+	ResetState();
+}
+
+void UdpPeer::Reset(SESSION_UID sessionUID, int token, const FREE_FUNC& freeMessage)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	ReleaseQueued(freeMessage);
+	ResetState();
+
+	ZeroMemory(&m_Address, sizeof(m_Address));
+	m_Bound = false;
+	m_Token = token;
+	m_SessionUID = sessionUID;
+}
+
+void UdpPeer::Clear(const FREE_FUNC& freeMessage)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_SessionUID = 0;
+	m_Bound = false;
+
+	ReleaseQueued(freeMessage);
+}
+
+void UdpPeer::Queue(MESSAGE* pMessage, DELIVERY delivery)
+{
+	QUEUED queued;
+	queued.pMessage = pMessage;
+	queued.delivery = delivery;
+	m_queueSend.push(queued);
+}
+
+void UdpPeer::SetAddress(const SOCKADDR_IN& addr)
+{
+	m_Address = addr;
+	m_Bound = true;
+}
+
+int UdpPeer::BuildDatagram(char* pBuffer, int capacity, ULONGLONG now, const FREE_FUNC& freeMessage)
+{
+	int offset = sizeof(UDP_HEADER);
+
+	for (auto& unacked : m_mapUnacked)
+	{
+		RELIABLE_ENTRY& entry = unacked.second;
+		if (now - entry.lastSendTick < UDP_RESEND_TICK)
+			continue;
+
+		if (!WriteFrame(pBuffer, capacity, offset, DELIVERY::RELIABLE_ORDERED, unacked.first, entry.pMessage))
+			break;
+
+		entry.packetSequence = m_LocalSequence;
+		entry.lastSendTick = now;
+	}
+
+	while (true)
+	{
+		QUEUED queued = m_Carry;
+		if (queued.pMessage == nullptr && !m_queueSend.try_pop(queued))
+			break;
+
+		m_Carry.pMessage = nullptr;
+
+		if (queued.delivery == DELIVERY::RELIABLE_ORDERED && (int)m_mapUnacked.size() >= UDP_RELIABLE_WINDOW)
+		{
+			m_Carry = queued;
+			break;
+		}
+
+		unsigned short id = 0;
+		if (queued.delivery == DELIVERY::RELIABLE_ORDERED)
+			id = m_NextReliableId;
+		else if (queued.delivery == DELIVERY::UNRELIABLE_SEQUENCED)
+			id = m_NextSequencedId;
+
+		if (!WriteFrame(pBuffer, capacity, offset, queued.delivery, id, queued.pMessage))
+		{
+			m_Carry = queued;
+			break;
+		}
+
+		if (queued.delivery == DELIVERY::RELIABLE_ORDERED)
+		{
+			RELIABLE_ENTRY entry;
+			entry.pMessage = queued.pMessage;
+			entry.packetSequence = m_LocalSequence;
+			entry.lastSendTick = now;
+			m_mapUnacked[id] = entry;
+			++m_NextReliableId;
+			continue;
+		}
+
+		if (queued.delivery == DELIVERY::UNRELIABLE_SEQUENCED)
+			++m_NextSequencedId;
+
+		freeMessage(queued.pMessage);
+	}
+
+	// until the remote answers, a bare header is how it learns our address
+	if (offset == sizeof(UDP_HEADER))
+	{
+		bool announce = !m_ReceivedAny && now - m_LastAckTick >= UDP_RESEND_TICK;
+		if (!announce && (!m_AckPending || now - m_LastAckTick < UDP_ACK_TICK))
+			return 0;
+	}
+
+	UDP_HEADER header;
+	header.sessionUID = m_SessionUID;
+	header.token = m_Token;
+	header.sequence = m_LocalSequence++;
+	header.ackValid = m_ReceivedAny;
+	header.ack = m_RemoteSequence;
+	header.ackBits = m_RemoteAckBits;
+	std::memcpy(pBuffer, &header, sizeof(header));
+
+	m_AckPending = false;
+	m_LastAckTick = now;
+
+	return offset;
+}
+
+bool UdpPeer::OnDatagram(const char* pData, int size, const ALLOCATE_FUNC& allocateMessage, const FREE_FUNC& freeMessage, std::vector<MESSAGE*>& vecDelivered)
+{
+	if (size < (int)sizeof(UDP_HEADER))
+		return false;
+
+	UDP_HEADER header;
+	std::memcpy(&header, pData, sizeof(header));
+
+	if (!m_ReceivedAny)
+	{
+		m_ReceivedAny = true;
+		m_RemoteSequence = header.sequence;
+		m_RemoteAckBits = 0;
+	}
+	else if (IsNewer(header.sequence, m_RemoteSequence))
+	{
+		unsigned short shift = header.sequence - m_RemoteSequence;
+		m_RemoteAckBits = shift < 32 ? m_RemoteAckBits << shift : 0;
+		if (shift <= 32)
+			m_RemoteAckBits |= 1u << (shift - 1);
+
+		if (shift >= UDP_RELIABLE_WINDOW)
+			m_ReceivedWindow.reset();
+		else
+		{
+			for (unsigned short sequence = m_RemoteSequence + 1; sequence != header.sequence; ++sequence)
+				m_ReceivedWindow.reset(sequence % UDP_RELIABLE_WINDOW);
+		}
+
+		m_RemoteSequence = header.sequence;
+	}
+	else
+	{
+		// too old to tell from a duplicate
+		unsigned short distance = m_RemoteSequence - header.sequence;
+		if (distance >= UDP_RELIABLE_WINDOW || m_ReceivedWindow.test(header.sequence % UDP_RELIABLE_WINDOW))
+			return true;
+
+		if (distance <= 32)
+			m_RemoteAckBits |= 1u << (distance - 1);
+	}
+
+	m_ReceivedWindow.set(header.sequence % UDP_RELIABLE_WINDOW);
+
+	// a bare ack is not acked back, or two idle peers would keep answering each other
+	if (size > (int)sizeof(UDP_HEADER))
+		m_AckPending = true;
+
+	if (header.ackValid)
+		ProcessAck(header.ack, header.ackBits, freeMessage);
+
+	int offset = sizeof(UDP_HEADER);
+	while (offset + (int)(sizeof(UDP_FRAME_HEADER) + sizeof(HEADER)) <= size)
+	{
+		UDP_FRAME_HEADER frameHeader;
+		HEADER			 messageHeader;
+		std::memcpy(&frameHeader, pData + offset, sizeof(frameHeader));
+		std::memcpy(&messageHeader, pData + offset + sizeof(frameHeader), sizeof(messageHeader));
+
+		const int	frameSize = sizeof(messageHeader) + messageHeader.length;
+		const char* pFrame = pData + offset + sizeof(frameHeader);
+		if (messageHeader.length < 0 || offset + (int)sizeof(frameHeader) + frameSize > size)
+			return false;
+
+		offset += sizeof(frameHeader) + frameSize;
+
+		bool deliver = true;
+		switch (frameHeader.delivery)
+		{
+			case DELIVERY::UNRELIABLE:
+				break;
+			case DELIVERY::UNRELIABLE_SEQUENCED:
+				// anything older than the last delivered one is stale
+				if (m_ReceivedSequenced && !IsNewer(frameHeader.id, m_LastSequencedId))
+				{
+					deliver = false;
+					break;
+				}
+				m_ReceivedSequenced = true;
+				m_LastSequencedId = frameHeader.id;
+				break;
+			case DELIVERY::RELIABLE_ORDERED:
+				if (frameHeader.id != m_ExpectedReliableId)
+				{
+					deliver = false;
+
+					unsigned short distance = frameHeader.id - m_ExpectedReliableId;
+					if (!IsNewer(frameHeader.id, m_ExpectedReliableId) || distance >= UDP_RELIABLE_WINDOW)
+						break;
+
+					if (m_mapOutOfOrder.find(frameHeader.id) != m_mapOutOfOrder.end())
+						break;
+
+					MESSAGE* pMessage = allocateMessage();
+					if (pMessage == nullptr)
+						break;
+
+					std::memcpy((char*)pMessage, pFrame, frameSize);
+					m_mapOutOfOrder[frameHeader.id] = pMessage;
+					break;
+				}
+				++m_ExpectedReliableId;
+				break;
+			default:
+				return false;
+		}
+
+		if (!deliver)
+			continue;
+
+		MESSAGE* pMessage = allocateMessage();
+		if (pMessage == nullptr)
+			return false;
+
+		std::memcpy((char*)pMessage, pFrame, frameSize);
+		vecDelivered.push_back(pMessage);
+
+		if (frameHeader.delivery != DELIVERY::RELIABLE_ORDERED)
+			continue;
+
+		auto it = m_mapOutOfOrder.find(m_ExpectedReliableId);
+		while (it != m_mapOutOfOrder.end())
+		{
+			vecDelivered.push_back(it->second);
+			m_mapOutOfOrder.erase(it);
+			it = m_mapOutOfOrder.find(++m_ExpectedReliableId);
+		}
+	}
+
+	return true;
+}
+
+bool UdpPeer::WriteFrame(char* pBuffer, int capacity, int& offset, DELIVERY delivery, unsigned short id, MESSAGE* pMessage)
+{
+	const int frameSize = sizeof(HEADER) + pMessage->GetPayloadSize();
+	if (offset + (int)sizeof(UDP_FRAME_HEADER) + frameSize > capacity)
+		return false;
+
+	UDP_FRAME_HEADER frameHeader;
+	frameHeader.delivery = delivery;
+	frameHeader.id = id;
+	std::memcpy(pBuffer + offset, &frameHeader, sizeof(frameHeader));
+	std::memcpy(pBuffer + offset + sizeof(frameHeader), (char*)pMessage, frameSize);
+
+	offset += sizeof(frameHeader) + frameSize;
+	return true;
+}
+
+void UdpPeer::ProcessAck(unsigned short ack, unsigned int ackBits, const FREE_FUNC& freeMessage)
+{
+	for (auto it = m_mapUnacked.begin(); it != m_mapUnacked.end();)
+	{
+		unsigned short distance = ack - it->second.packetSequence;
+
+		bool acked = distance == 0 || (distance <= 32 && (ackBits & (1u << (distance - 1))));
+		if (!acked)
+		{
+			++it;
+			continue;
+		}
+
+		freeMessage(it->second.pMessage);
+		it = m_mapUnacked.erase(it);
+	}
+}
+
+void UdpPeer::ReleaseQueued(const FREE_FUNC& freeMessage)
+{
+	QUEUED queued;
+	while (m_queueSend.try_pop(queued))
+		freeMessage(queued.pMessage);
+
+	if (m_Carry.pMessage != nullptr)
+		freeMessage(m_Carry.pMessage);
+	m_Carry.pMessage = nullptr;
+
+	for (auto& unacked : m_mapUnacked)
+		freeMessage(unacked.second.pMessage);
+	m_mapUnacked.clear();
+
+	for (auto& outOfOrder : m_mapOutOfOrder)
+		freeMessage(outOfOrder.second);
+	m_mapOutOfOrder.clear();
+}
+
+void UdpPeer::ResetState()
+{
+	m_LocalSequence = 0;
+	m_NextReliableId = 0;
+	m_NextSequencedId = 0;
+
+	m_ReceivedAny = false;
+	m_AckPending = false;
+	m_LastAckTick = 0;
+	m_RemoteSequence = 0;
+	m_RemoteAckBits = 0;
+	m_ReceivedWindow.reset();
+	m_ExpectedReliableId = 0;
+	m_ReceivedSequenced = false;
+	m_LastSequencedId = 0;
+}
+
+UdpSocket::UdpSocket()
+: m_Socket(INVALID_SOCKET)
+, m_LossPercent(0)
+, m_DelayMs(0)
+, m_Random(std::random_device()())
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+bool UdpSocket::Open(const char* ip, short port)
+{
+	m_Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (m_Socket == INVALID_SOCKET)
+		return false;
+
+	SOCKADDR_IN addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	InetPtonA(AF_INET, ip, &addr.sin_addr);
+	addr.sin_port = htons(port);
+
+	if (bind(m_Socket, (SOCKADDR*)&addr, sizeof(addr)) == SOCKET_ERROR)
+	{
+		Close();
+		return false;
+	}
+
+	int bufferSize = 4 * 1024 * 1024;
+	setsockopt(m_Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+	setsockopt(m_Socket, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+
+	u_long nonBlocking = 1;
+	if (ioctlsocket(m_Socket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void UdpSocket::Close()
+{
+	if (m_Socket == INVALID_SOCKET)
+		return;
+
+	closesocket(m_Socket);
+	m_Socket = INVALID_SOCKET;
+}
+
+bool UdpSocket::Wait(int timeoutMs)
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(m_Socket, &readSet);
+
+	timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = timeoutMs * 1000;
+
+	return select(0, &readSet, nullptr, nullptr, &timeout) > 0;
+}
+
+int UdpSocket::Receive(std::function<void(const SOCKADDR_IN&, const char*, int)> onDatagram)
+{
+	char buffer[UDP_MAX_DATAGRAM_SIZE];
+	int	 count = 0;
+
+	while (true)
+	{
+		SOCKADDR_IN from;
+		int			fromSize = sizeof(from);
+		int			size = recvfrom(m_Socket, buffer, sizeof(buffer), 0, (SOCKADDR*)&from, &fromSize);
+		if (size == SOCKET_ERROR)
+		{
+			// ICMP port unreachable and oversized datagrams
+			int error = WSAGetLastError();
+			if (error == WSAECONNRESET || error == WSAEMSGSIZE)
+				continue;
+
+			break;
+		}
+
+		onDatagram(from, buffer, size);
+		++count;
+	}
+
+	return count;
+}
+
+bool UdpSocket::SendTo(const SOCKADDR_IN& addr, const char* pData, int size)
+{
+	if (m_LossPercent > 0 && (int)(m_Random() % 100) < m_LossPercent)
+		return true;
+
+	if (m_DelayMs > 0)
+	{
+		DELAYED delayed;
+		delayed.sendTick = GetTickCount64() + m_DelayMs;
+		delayed.addr = addr;
+		delayed.data.assign(pData, pData + size);
+		m_vecDelayed.push_back(std::move(delayed));
+		return true;
+	}
+
+	return sendto(m_Socket, pData, size, 0, (const SOCKADDR*)&addr, sizeof(addr)) != SOCKET_ERROR;
+}
+
+void UdpSocket::FlushDelayed()
+{
+	if (m_vecDelayed.empty())
+		return;
+
+	ULONGLONG now = GetTickCount64();
+
+	size_t sent = 0;
+	while (sent < m_vecDelayed.size() && m_vecDelayed[sent].sendTick <= now)
+	{
+		DELAYED& delayed = m_vecDelayed[sent];
+		sendto(m_Socket, delayed.data.data(), (int)delayed.data.size(), 0, (const SOCKADDR*)&delayed.addr, sizeof(delayed.addr));
+		++sent;
+	}
+
+	m_vecDelayed.erase(m_vecDelayed.begin(), m_vecDelayed.begin() + sent);
+}
+
+void UdpSocket::SetLossSimulation(int lossPercent, int delayMs)
+{
+	m_LossPercent = lossPercent;
+	m_DelayMs = delayMs;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <winsock2.h>
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <concurrent_queue.h>
+
+#include "Protocol.h"
+
+constexpr int		UDP_MAX_DATAGRAM_SIZE = 1200;
+constexpr ULONGLONG UDP_RESEND_TICK = 50;
+constexpr ULONGLONG UDP_ACK_TICK = 10;
+constexpr int		UDP_RELIABLE_WINDOW = 1024;
+constexpr int		UDP_MAX_BATCH = 16;
+
+enum class DELIVERY : char
+{
+	UNRELIABLE,
+	UNRELIABLE_SEQUENCED,
+	RELIABLE_ORDERED
+};
+
+#pragma pack(1)
+// sessionUID and token are only checked on datagrams going to the server,
+// ack/ackBits acknowledge the latest remote sequence and the 32 before it
+struct UDP_HEADER
+{
+	SESSION_UID	   sessionUID;
+	int			   token;
+	unsigned short sequence;
+	bool		   ackValid;
+	unsigned short ack;
+	unsigned int   ackBits;
+};
+
+// followed by the same HEADER + payload frame TCP carries
+struct UDP_FRAME_HEADER
+{
+	DELIVERY	   delivery;
+	unsigned short id;
+};
+#pragma pack()
+
+class UdpPeer
+{
+	struct RELIABLE_ENTRY
+	{
+		MESSAGE*	   pMessage;
+		unsigned short packetSequence;
+		ULONGLONG	   lastSendTick;
+	};
+
+	struct QUEUED
+	{
+		MESSAGE* pMessage;
+		DELIVERY delivery;
+	};
+
+public:
+	using ALLOCATE_FUNC = std::function<MESSAGE*()>;
+	using FREE_FUNC = std::function<void(MESSAGE*)>;
+
+	UdpPeer();
+
+	void Reset(SESSION_UID sessionUID, int token, const FREE_FUNC& freeMessage);
+	void Clear(const FREE_FUNC& freeMessage);
+
+	void Lock() { m_lock.lock(); }
+	void Unlock() { m_lock.unlock(); }
+
+	// thread safe, everything else is called under Lock()
+	void Queue(MESSAGE* pMessage, DELIVERY delivery);
+
+	int	 BuildDatagram(char* pBuffer, int capacity, ULONGLONG now, const FREE_FUNC& freeMessage);
+	bool OnDatagram(const char* pData, int size, const ALLOCATE_FUNC& allocateMessage, const FREE_FUNC& freeMessage, std::vector<MESSAGE*>& vecDelivered);
+
+	SESSION_UID GetSessionUID() const { return m_SessionUID; }
+	int			GetToken() const { return m_Token; }
+	bool		IsBound() const { return m_Bound; }
+
+	void			   SetAddress(const SOCKADDR_IN& addr);
+	const SOCKADDR_IN& GetAddress() const { return m_Address; }
+
+	static bool IsNewer(unsigned short lhs, unsigned short rhs) { return (short)(lhs - rhs) > 0; }
+	static bool CanCarry(MESSAGE* pMessage) { return (int)(sizeof(UDP_HEADER) + sizeof(UDP_FRAME_HEADER) + sizeof(HEADER)) + pMessage->GetPayloadSize() <= UDP_MAX_DATAGRAM_SIZE; }
+
+private:
+	bool WriteFrame(char* pBuffer, int capacity, int& offset, DELIVERY delivery, unsigned short id, MESSAGE* pMessage);
+	void ProcessAck(unsigned short ack, unsigned int ackBits, const FREE_FUNC& freeMessage);
+	void ReleaseQueued(const FREE_FUNC& freeMessage);
+	void ResetState();
+
+private:
+	std::atomic<SESSION_UID> m_SessionUID;
+	int						 m_Token;
+	std::atomic<bool>		 m_Bound;
+	SOCKADDR_IN				 m_Address;
+	std::mutex				 m_lock;
+
+	// send side
+	Concurrency::concurrent_queue<QUEUED>	 m_queueSend;
+	QUEUED									 m_Carry;
+	unsigned short							 m_LocalSequence;
+	unsigned short							 m_NextReliableId;
+	unsigned short							 m_NextSequencedId;
+	std::map<unsigned short, RELIABLE_ENTRY> m_mapUnacked;
+
+	// recv side
+	bool							   m_ReceivedAny;
+	bool							   m_AckPending;
+	ULONGLONG						   m_LastAckTick;
+	unsigned short					   m_RemoteSequence;
+	unsigned int					   m_RemoteAckBits;
+	std::bitset<UDP_RELIABLE_WINDOW>   m_ReceivedWindow; // by sequence % window
+	unsigned short					   m_ExpectedReliableId;
+	bool							   m_ReceivedSequenced;
+	unsigned short					   m_LastSequencedId;
+	std::map<unsigned short, MESSAGE*> m_mapOutOfOrder;
+};
+
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	bool Open(const char* ip, short port);
+	void Close();
+
+	bool Wait(int timeoutMs);
+	int	 Receive(std::function<void(const SOCKADDR_IN&, const char*, int)> onDatagram);
+	bool SendTo(const SOCKADDR_IN& addr, const char* pData, int size);
+	void FlushDelayed();
+
+	void SetLossSimulation(int lossPercent, int delayMs);
+
+private:
+	struct DELAYED
+	{
+		ULONGLONG		  sendTick;
+		SOCKADDR_IN		  addr;
+		std::vector<char> data;
+	};
+
+	SOCKET				 m_Socket;
+	int					 m_LossPercent;
+	int					 m_DelayMs;
+	std::mt19937		 m_Random;
+	std::vector<DELAYED> m_vecDelayed;
+};
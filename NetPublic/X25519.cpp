@@ -0,0 +1,209 @@
+#include "X25519.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <cstring>
+
+#pragma comment(lib, "bcrypt.lib")
+
+namespace
+{
+// field element mod 2^255 - 19 in sixteen 16 bit limbs, held in 64 bit to absorb the products
+using FIELD = long long[16];
+
+void Carry(FIELD o)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		o[i] += 1LL << 16;
+		long long carry = o[i] >> 16;
+		if (i < 15)
+			o[i + 1] += carry - 1;
+		else
+			o[0] += 38 * (carry - 1);
+		o[i] -= carry << 16;
+	}
+}
+
+// swaps p and q when bit is 1, without a branch on the secret
+void Select(FIELD p, FIELD q, int bit)
+{
+	long long mask = ~(long long)(bit - 1);
+	for (int i = 0; i < 16; ++i)
+	{
+		long long t = mask & (p[i] ^ q[i]);
+		p[i] ^= t;
+		q[i] ^= t;
+	}
+}
+
+void Pack(unsigned char* pOut, const FIELD n)
+{
+	FIELD t;
+	FIELD m;
+	std::memcpy(t, n, sizeof(t));
+
+	Carry(t);
+	Carry(t);
+	Carry(t);
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		m[0] = t[0] - 0xffed;
+		for (int i = 1; i < 15; ++i)
+		{
+			m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+			m[i - 1] &= 0xffff;
+		}
+
+		m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+		int borrow = (int)((m[15] >> 16) & 1);
+		m[14] &= 0xffff;
+
+		Select(t, m, 1 - borrow);
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		pOut[2 * i] = (unsigned char)(t[i] & 0xff);
+		pOut[2 * i + 1] = (unsigned char)(t[i] >> 8);
+	}
+}
+
+void Unpack(FIELD o, const unsigned char* pIn)
+{
+	for (int i = 0; i < 16; ++i)
+		o[i] = pIn[2 * i] + ((long long)pIn[2 * i + 1] << 8);
+
+	o[15] &= 0x7fff;
+}
+
+void Add(FIELD o, const FIELD a, const FIELD b)
+{
+	for (int i = 0; i < 16; ++i)
+		o[i] = a[i] + b[i];
+}
+
+void Sub(FIELD o, const FIELD a, const FIELD b)
+{
+	for (int i = 0; i < 16; ++i)
+		o[i] = a[i] - b[i];
+}
+
+void Mul(FIELD o, const FIELD a, const FIELD b)
+{
+	long long t[31] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int j = 0; j < 16; ++j)
+			t[i + j] += a[i] * b[j];
+	}
+
+	for (int i = 0; i < 15; ++i)
+		t[i] += 38 * t[i + 16];
+
+	for (int i = 0; i < 16; ++i)
+		o[i] = t[i];
+
+	Carry(o);
+	Carry(o);
+}
+
+void Square(FIELD o, const FIELD a)
+{
+	Mul(o, a, a);
+}
+
+// a^(p-2)
+void Invert(FIELD o, const FIELD a)
+{
+	FIELD c;
+	std::memcpy(c, a, sizeof(c));
+
+	for (int bit = 253; bit >= 0; --bit)
+	{
+		Square(c, c);
+		if (bit != 2 && bit != 4)
+			Mul(c, c, a);
+	}
+
+	std::memcpy(o, c, sizeof(c));
+}
+
+void ScalarMult(unsigned char* pOut, const unsigned char* pScalar, const unsigned char* pPoint)
+{
+	static const FIELD A24 = { 0xDB41, 1 }; // 121665
+
+	unsigned char z[32];
+	std::memcpy(z, pScalar, sizeof(z));
+	z[31] = (z[31] & 127) | 64;
+	z[0] &= 248;
+
+	FIELD x;
+	FIELD a = { 1 };
+	FIELD b;
+	FIELD c = {};
+	FIELD d = { 1 };
+	FIELD e;
+	FIELD f;
+	Unpack(x, pPoint);
+	std::memcpy(b, x, sizeof(b));
+
+	// Montgomery ladder
+	for (int i = 254; i >= 0; --i)
+	{
+		int bit = (z[i >> 3] >> (i & 7)) & 1;
+		Select(a, b, bit);
+		Select(c, d, bit);
+
+		Add(e, a, c);
+		Sub(a, a, c);
+		Add(c, b, d);
+		Sub(b, b, d);
+		Square(d, e);
+		Square(f, a);
+		Mul(a, c, a);
+		Mul(c, b, e);
+		Add(e, a, c);
+		Sub(a, a, c);
+		Square(b, a);
+		Sub(c, d, f);
+		Mul(a, c, A24);
+		Add(a, a, d);
+		Mul(c, c, a);
+		Mul(a, d, f);
+		Mul(d, b, x);
+		Square(b, e);
+
+		Select(a, b, bit);
+		Select(c, d, bit);
+	}
+
+	Invert(c, c);
+	Mul(a, a, c);
+	Pack(pOut, a);
+
+	SecureZeroMemory(z, sizeof(z));
+}
+} // namespace
+
+bool X25519GenerateKeyPair(unsigned char* pPrivateKey, unsigned char* pPublicKey)
+{
+	static const unsigned char basePoint[X25519_KEY_SIZE] = { 9 };
+
+	if (BCryptGenRandom(nullptr, pPrivateKey, X25519_KEY_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0)
+		return false;
+
+	ScalarMult(pPublicKey, pPrivateKey, basePoint);
+	return true;
+}
+
+bool X25519SharedSecret(const unsigned char* pPrivateKey, const unsigned char* pPeerPublicKey, unsigned char* pSharedSecret)
+{
+	ScalarMult(pSharedSecret, pPrivateKey, pPeerPublicKey);
+
+	unsigned char bits = 0;
+	for (int i = 0; i < X25519_KEY_SIZE; ++i)
+		bits |= pSharedSecret[i];
+
+	return bits != 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+constexpr int X25519_KEY_SIZE = 32;
+
+// RFC 7748, constant time ladder
+bool X25519GenerateKeyPair(unsigned char* pPrivateKey, unsigned char* pPublicKey);
+
+// false for a peer key of low order, the shared secret would then be all zero
+bool X25519SharedSecret(const unsigned char* pPrivateKey, const unsigned char* pPeerPublicKey, unsigned char* pSharedSecret);
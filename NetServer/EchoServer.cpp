@@ -0,0 +1,76 @@
+#include "NetServer.h"
+
+class TestServer : public NetServer
+{
+	bool OnConnectionRequest(char* pClientIP, short port)
+	{
+		return true;
+	}
+
+	void OnClientJoin(SESSION_UID sessionUID)
+	{
+		std::cout << "Client come : " << sessionUID << std::endl;
+	}
+
+	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
+	{
+		if (!Send(sessionUID, pMessage))
+		{
+			std::cout << "Send Fail!" << std::endl;
+		}
+	}
+
+	void OnClientLeave(SESSION_UID sessionUID)
+	{
+		std::cout << "Client Leave : " << sessionUID << std::endl;
+	}
+};
+
+TestServer server;
+
+constexpr const char* HANDOFF_PIPE_NAME = "\\\\.\\pipe\\NetServerHandOff";
+
+// run with --takeover to start a new build that takes the sessions over from the running one
+int main(int argc, char* argv[])
+{
+	server.EnableLargePageArena(true);
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--integrity") == 0)
+			server.EnableIntegrity(true);
+
+		if (std::strcmp(argv[i], "--encrypt") == 0)
+			server.EnableEncryption(true);
+	}
+
+	server.RegisterRpc(1, [](SESSION_UID sessionUID, RPC_CALL_ID callId, const char* pBody, int bodySize) {
+		server.Reply(sessionUID, callId, pBody, bodySize);
+	});
+
+	bool takeOver = argc > 1 && std::strcmp(argv[1], "--takeover") == 0;
+	if (takeOver)
+		server.StartFromHandOff(HANDOFF_PIPE_NAME, 5, 400);
+	else
+	{
+		server.Start("0.0.0.0", 27931, 5, false, 400);
+		server.StartUdp("0.0.0.0", 27931);
+	}
+
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--capture") == 0)
+			server.StartCapture(argv[i + 1]);
+	}
+
+	std::thread handOffThread([]() {
+		if (server.WaitHandOff(HANDOFF_PIPE_NAME))
+			ExitProcess(0);
+	});
+
+	while (true)
+	{
+		std::cout << "arena : " << server.GetArenaBytes() << " bytes, large page backed : " << server.GetLargePageBytes() << " bytes" << std::endl;
+		Sleep(5000);
+	}
+}
\ No newline at end of file
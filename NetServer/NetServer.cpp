@@ -1,12 +1,66 @@
 ﻿#include "NetServer.h"
 #include "NetUtil.h"
 #include "ThreadLocalMemoryPool.h"
+#include "SystemPacket.h"
+#include "MessageFramer.h"
+#include <algorithm>
+
+namespace
+{
+// sessions are only released on IOCP workers
+thread_local bool t_IsWorkerThread = false;
+} // namespace
 
 NetServer::NetServer()
 : m_AtomicCurrentClientCount(0)
 , m_AtomicSessionUID(0)
+, m_MaxClientCnt(0)
+, m_SessionTableSize(0)
+, m_FreeSessionHead(0)
+, m_WarmSessionCnt(0)
+, m_WarmThreadCnt(1)
 , m_MessagePool(3000)
+, m_FrameRefPool(3000)
+, m_UseLargePageArena(false)
+, m_LargeFrameThreshold(LARGE_FRAME_THRESHOLD)
+, m_CorkBytes(0)
+, m_CorkDeadlineTicks(0)
+, m_ZeroCopyBytes(0)
+, m_ZeroCopySendCnt(0)
+, m_ZeroCopySendBytes(0)
+, m_RecvBudget(RECV_BUDGET)
+, m_ActiveWorkerCnt(0)
+, m_ProbePending(false)
+, m_ProbeDelayTicks(0)
+, m_CompletionDelayUs(0)
+, m_HandOff(false)
+, m_PausedSendThreadCnt(0)
+, m_UseSharedMemory(true)
+, m_UseIntegrity(false)
+, m_UseEncryption(false)
 {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_TickFrequency = frequency.QuadPart;
+
+	for (std::atomic<SESSION_SEGMENT*>& segment : m_SessionSegments)
+		segment = nullptr;
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_ShmReady>([this](SESSION* pSession, SystemPacketHeader*) {
+		OnShmReady(pSession);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_IntegrityReady>([this](SESSION* pSession, SystemPacketHeader*) {
+		OnIntegrityReady(pSession);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_CryptoReady>([this](SESSION* pSession, SystemPacketHeader* pPacket) {
+		OnCryptoReady(pSession, pPacket);
+	});
+
+	m_SystemPacketProcessor.RegisterProcessor<SystemPacket_RpcRequest>([this](SESSION* pSession, SystemPacketHeader* pPacket) {
+		OnRpcRequest(pSession, pPacket);
+	});
 }
 
 bool NetServer::Start(const char* ip, short port, int workerThreadCnt, bool tcpNagleOn, int maxUserCnt)
@@ -31,34 +85,17 @@ bool NetServer::Start(const char* ip, short port, int workerThreadCnt, bool tcpN
 	if (setsockopt(m_listenSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&bNagleOpt, sizeof(bNagleOpt)) == SOCKET_ERROR)
 		return false;
 
-	m_hIocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, workerThreadCnt);
+	m_hIocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, GetMaxWorkerCount(workerThreadCnt));
 	if (m_hIocp == NULL)
 		return false;
 
-	// init session array
-	m_SessionArray = new (std::nothrow) SESSION[maxUserCnt];
-	if (m_SessionArray == nullptr)
+	if (!InitSessionTable(maxUserCnt, true))
 		return false;
 
-	m_MaxClientCnt = maxUserCnt;
-
-	for (int sessionIndex = 0; sessionIndex < maxUserCnt; ++sessionIndex)
-	{
-		m_queueSessionIndexArray.push(sessionIndex);
-	}
-
 	if (listen(m_listenSocket, SOMAXCONN) == SOCKET_ERROR)
 		return false;
 
-	// create thread
-	for (int i = 0; i < workerThreadCnt; ++i)
-	{
-		m_vecWorkerThread.push_back(std::thread([this]() { WorkerThread(); }));
-	}
-
-	m_vecSendThread.push_back(std::thread([this]() { SendThread(); }));
-
-	m_AcceptThread = std::thread([this]() { AcceptThread(); });
+	CreateThreads(workerThreadCnt);
 
 	return true;
 }
@@ -68,28 +105,40 @@ void NetServer::PostRecv(SESSION* pSession)
 	if (pSession == nullptr)
 		return;
 
-	RingBuffer& recvQ = pSession->recvQ;
+	if (m_HandOff)
+		return;
 
-	int freeSize = (int)recvQ.free_space();
-	int directEnqueueSize = (int)recvQ.direct_enqueue_size();
+	RingBuffer& recvQ = pSession->recvQ;
 
 	int	bufCount = 1;
 	WSABUF recvBuf[2];
-	recvBuf[0].buf = recvQ.head_pointer();
-	recvBuf[0].len = directEnqueueSize;
-	if (directEnqueueSize < freeSize)
+	if (pSession->pLargeMessage != nullptr)
 	{
-		recvBuf[1].buf = recvQ.start_pointer();
-		recvBuf[1].len = freeSize - directEnqueueSize;
-		++bufCount;
+		MESSAGE* pMessage = pSession->pLargeMessage;
+		recvBuf[0].buf = (char*)pMessage + pSession->largeReceivedSize;
+		recvBuf[0].len = sizeof(pMessage->header) + pMessage->header.length - pSession->largeReceivedSize;
+	}
+	else
+	{
+		int freeSize = (int)recvQ.free_space();
+		int directEnqueueSize = (int)recvQ.direct_enqueue_size();
+
+		recvBuf[0].buf = recvQ.head_pointer();
+		recvBuf[0].len = directEnqueueSize;
+		if (directEnqueueSize < freeSize)
+		{
+			recvBuf[1].buf = recvQ.start_pointer();
+			recvBuf[1].len = freeSize - directEnqueueSize;
+			++bufCount;
+		}
 	}
 
 	pSession->ResetRecvOverlapped();
 
-	PreventRelease(pSession);
+	if (!PreventRelease(pSession))
+		return;
 
-	DWORD flags = 0;
-	int   result = WSARecv(pSession->sessionSocket, recvBuf, bufCount, nullptr, &flags, &pSession->recvOverlapped, nullptr);
+	int result = PostSessionRecv(pSession, recvBuf, bufCount);
 	if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
 	{
 		NetUtil::PrintError(WSAGetLastError(), __LINE__);
@@ -102,34 +151,105 @@ void NetServer::PostSend(SESSION* pSession)
 	if (pSession == nullptr)
 		return;
 
-	auto& sendPendingQ = pSession->sendPendingQ;
-	if (!sendPendingQ.empty())
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink != nullptr && pShmLink->sendActive)
+	{
+		PostShmSend(pSession);
+		return;
+	}
+
+	// one WSASend in flight
+	if (pSession->pSendPending.load(std::memory_order_acquire) != nullptr || pSession->pSendPendingRef.load(std::memory_order_acquire) != nullptr)
+		return;
+
+	auto& sendHighQ = pSession->sendHighQ;
+	auto& sendQ = pSession->sendQ;
+	if (!pSession->HasQueuedSend() || IsCorked(pSession))
 		return;
 
-	auto&  sendQ = pSession->sendQ;
+	// cleared before gathering so a racing flush isn't lost
+	pSession->flushRequested = false;
+
 	WSABUF sendBuf[MAX_WSABUF_SIZE];
 
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
 	int		 wsaBufIdx = 0;
+	int		 gatheredBytes = 0;
+	bool	 switched = false;
 	MESSAGE* pMessage = nullptr;
-	while (sendQ.try_pop(pMessage))
+
+	// a started chain is finished before any other lane
+	MpscQueue<MESSAGE>* pChainQ = pSession->pChainQ;
+
+	int highLimit = sendQ.IsEmpty() ? MAX_WSABUF_SIZE : MAX_WSABUF_SIZE - BULK_SEND_SHARE;
+	if (pChainQ == &sendQ)
+		highLimit = 0;
+	long long highTicks = 0;
+	long long highMaxTicks = 0;
+	int		  highCount = 0;
+	while (wsaBufIdx < highLimit && (pMessage = sendHighQ.Pop()) != nullptr)
 	{
-		sendBuf[wsaBufIdx].buf = (char*)pMessage;
-		sendBuf[wsaBufIdx].len = sizeof(pMessage->header) + pMessage->header.length;
+		const long long age = now.QuadPart - pMessage->queuedTick;
+		highTicks += age;
+		highMaxTicks = (std::max)(highMaxTicks, age);
+		++highCount;
+		gatheredBytes += sizeof(pMessage->header) + pMessage->header.length;
+		pChainQ = pMessage->header.type == PACKET_TYPE::USER_CONTINUED ? &sendHighQ : nullptr;
+
+		switched = !GatherSend(pSession, pMessage, sendBuf[wsaBufIdx++]);
+		if (switched)
+			break;
+	}
 
-		++wsaBufIdx;
+	long long bulkTicks = 0;
+	long long bulkMaxTicks = 0;
+	int		  bulkCount = 0;
+	while (!switched && pChainQ != &sendHighQ && wsaBufIdx < MAX_WSABUF_SIZE && (pMessage = sendQ.Pop()) != nullptr)
+	{
+		const long long age = now.QuadPart - pMessage->queuedTick;
+		bulkTicks += age;
+		bulkMaxTicks = (std::max)(bulkMaxTicks, age);
+		++bulkCount;
+		gatheredBytes += sizeof(pMessage->header) + pMessage->header.length;
+		pChainQ = pMessage->header.type == PACKET_TYPE::USER_CONTINUED ? &sendQ : nullptr;
+
+		switched = !GatherSend(pSession, pMessage, sendBuf[wsaBufIdx++]);
+	}
 
-		sendPendingQ.push(pMessage);
+	FRAME_REF* pRef = nullptr;
+	while (!switched && pChainQ == nullptr && wsaBufIdx < MAX_WSABUF_SIZE && (pRef = pSession->sendSharedQ.Pop()) != nullptr)
+	{
+		gatheredBytes += sizeof(pRef->pFrame->header) + pRef->pFrame->header.length;
+		GatherShared(pSession, pRef, sendBuf[wsaBufIdx++]);
+	}
 
-		if (wsaBufIdx >= MAX_WSABUF_SIZE)
-			break;
+	pSession->pChainQ = pChainQ;
+
+	RecordSendAge(SEND_PRIORITY::HIGH, highCount, highTicks, highMaxTicks);
+	RecordSendAge(SEND_PRIORITY::BULK, bulkCount, bulkTicks, bulkMaxTicks);
+
+	// cleared before the check, a racing Send() stamps it itself
+	if (m_CorkBytes > 0)
+	{
+		pSession->corkBytes -= gatheredBytes;
+		pSession->corkTick = 0;
+
+		long long noTick = 0;
+		if (pSession->HasQueuedSend())
+			pSession->corkTick.compare_exchange_strong(noTick, now.QuadPart);
 	}
 
+	if (m_ZeroCopyBytes > 0 && pSession->pLoopback == nullptr)
+		SelectSendBuffer(pSession, gatheredBytes);
+
 	pSession->ResetSendOverlapped();
 
-	PreventRelease(pSession);
+	if (!PreventRelease(pSession))
+		return;
 
-	DWORD flags = 0;
-	int   result = WSASend(pSession->sessionSocket, sendBuf, wsaBufIdx, nullptr, flags, &pSession->sendOverlapped, nullptr);
+	int result = PostSessionSend(pSession, sendBuf, wsaBufIdx);
 	if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
 	{
 		NetUtil::PrintError(WSAGetLastError(), __LINE__);
@@ -137,46 +257,353 @@ void NetServer::PostSend(SESSION* pSession)
 	}
 }
 
-bool NetServer::Send(SESSION_UID sessionUID, MESSAGE* pMessage)
+// same lane order as PostSend, a started chain first
+MESSAGE* NetServer::PopQueuedSend(SESSION* pSession)
 {
+	MpscQueue<MESSAGE>* pQueue = pSession->pChainQ;
+	MESSAGE*			pMessage = pQueue != nullptr ? pQueue->Pop() : nullptr;
 	if (pMessage == nullptr)
-		return false;
+	{
+		pQueue = &pSession->sendHighQ;
+		pMessage = pQueue->Pop();
+	}
+	if (pMessage == nullptr)
+	{
+		pQueue = &pSession->sendQ;
+		pMessage = pQueue->Pop();
+	}
 
-	SESSION* pSession = GetSession(sessionUID);
-	if (pSession == nullptr)
+	pSession->pChainQ = pMessage != nullptr && pMessage->header.type == PACKET_TYPE::USER_CONTINUED ? pQueue : nullptr;
+	return pMessage;
+}
+
+// false after the shared memory switch frame or a seal failure, stop gathering
+bool NetServer::GatherSend(SESSION* pSession, MESSAGE* pMessage, WSABUF& sendBuf)
+{
+	if (!SealFrame(pSession, pMessage))
 	{
+		// the switch markers must not outlive the frame, the pool reuses it
+		NetUtil::PrintError(ERROR_BUFFER_OVERFLOW, __LINE__);
+		ShutdownSession(pSession);
+
+		if (pSession->pShmLink != nullptr && pSession->pShmLink->pSwitchMessage == pMessage)
+			pSession->pShmLink->pSwitchMessage = nullptr;
+		if (pSession->pIntegritySwitchMessage == pMessage)
+			pSession->pIntegritySwitchMessage = nullptr;
+		if (pSession->pCryptoSwitchMessage == pMessage)
+			pSession->pCryptoSwitchMessage = nullptr;
+
 		FreeMessage(pMessage);
+		sendBuf.buf = nullptr;
+		sendBuf.len = 0;
+		return false;
+	}
+
+	sendBuf.buf = (char*)pMessage;
+	sendBuf.len = sizeof(pMessage->header) + pMessage->header.length;
+
+	if (pMessage->traceId != 0)
+		m_Tracer.Record(pMessage->traceId, TRACE_POINT::POST_SEND, pSession->sessionUID);
+
+	pMessage->pNext.store(nullptr, std::memory_order_relaxed);
+	if (pSession->pSendPendingTail == nullptr)
+		pSession->pSendPending.store(pMessage, std::memory_order_relaxed);
+	else
+		pSession->pSendPendingTail->pNext.store(pMessage, std::memory_order_relaxed);
+	pSession->pSendPendingTail = pMessage;
+
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink != nullptr && pMessage == pShmLink->pSwitchMessage)
+	{
+		pShmLink->pSwitchMessage = nullptr;
+		pShmLink->sendActive = true;
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(pSession->lock);
+	if (pMessage == pSession->pIntegritySwitchMessage)
+	{
+		pSession->pIntegritySwitchMessage = nullptr;
+		pSession->integritySend = true;
+	}
+
+	if (pMessage == pSession->pCryptoSwitchMessage)
+	{
+		pSession->pCryptoSwitchMessage = nullptr;
+		pSession->encryptSend = true;
+	}
+
+	return true;
+}
+
+// sealing works in place, a sealing session gets its own copy of the shared frame
+void NetServer::GatherShared(SESSION* pSession, FRAME_REF* pRef, WSABUF& sendBuf)
+{
+	if (pSession->integritySend || pSession->encryptSend)
+	{
+		MESSAGE* pCopy = CopySharedFrame(pRef);
+		if (pCopy == nullptr)
+		{
+			NetUtil::PrintError(ERROR_NOT_ENOUGH_MEMORY, __LINE__);
+			ShutdownSession(pSession);
+			sendBuf.buf = nullptr;
+			sendBuf.len = 0;
+			return;
+		}
+
+		GatherSend(pSession, pCopy, sendBuf);
+		return;
+	}
+
+	sendBuf.buf = (char*)pRef->pFrame;
+	sendBuf.len = sizeof(pRef->pFrame->header) + pRef->pFrame->header.length;
+
+	pRef->pNext.store(pSession->pSendPendingRef.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	pSession->pSendPendingRef.store(pRef, std::memory_order_relaxed);
+}
+
+void NetServer::PushSend(SESSION* pSession, MESSAGE* pMessage, SEND_PRIORITY priority)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	pMessage->queuedTick = now.QuadPart;
+
+	// PostSend may free the frame right after the push
+	const int frameSize = sizeof(pMessage->header) + pMessage->header.length;
+
+	if (pMessage->traceId != 0)
+		m_Tracer.Record(pMessage->traceId, TRACE_POINT::SEND_QUEUED, pSession->sessionUID);
+
+	if (priority == SEND_PRIORITY::HIGH)
+		pSession->sendHighQ.Push(pMessage);
+	else
+		pSession->sendQ.Push(pMessage);
+
+	if (m_CorkBytes > 0)
+	{
+		pSession->corkBytes += frameSize;
+
+		long long noTick = 0;
+		pSession->corkTick.compare_exchange_strong(noTick, now.QuadPart);
+	}
+}
+
+bool NetServer::IsCorked(SESSION* pSession)
+{
+	if (m_CorkBytes <= 0 || pSession->flushRequested || pSession->corkBytes >= m_CorkBytes || !pSession->sendHighQ.IsEmpty())
+		return false;
+
+	const long long corkTick = pSession->corkTick;
+	if (corkTick == 0)
+		return false;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart - corkTick < m_CorkDeadlineTicks;
+}
+
+// only with no send in flight
+void NetServer::SelectSendBuffer(SESSION* pSession, int gatheredBytes)
+{
+	const bool zeroCopy = gatheredBytes >= m_ZeroCopyBytes;
+	if (zeroCopy)
+	{
+		++m_ZeroCopySendCnt;
+		m_ZeroCopySendBytes += gatheredBytes;
+	}
+
+	if (zeroCopy == pSession->zeroCopySend)
+		return;
+
+	if (zeroCopy)
+	{
+		int optLen = sizeof(pSession->sendBufferSize);
+		if (getsockopt(pSession->sessionSocket, SOL_SOCKET, SO_SNDBUF, (char*)&pSession->sendBufferSize, &optLen) == SOCKET_ERROR)
+		{
+			NetUtil::PrintError(WSAGetLastError(), __LINE__);
+			return;
+		}
+	}
+
+	int bufferSize = zeroCopy ? 0 : pSession->sendBufferSize;
+	if (setsockopt(pSession->sessionSocket, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize)) == SOCKET_ERROR)
+	{
+		NetUtil::PrintError(WSAGetLastError(), __LINE__);
+		return;
+	}
+
+	pSession->zeroCopySend = zeroCopy;
+}
+
+void NetServer::SetCork(int byteThreshold, int flushDeadlineUs)
+{
+	m_CorkBytes = byteThreshold;
+	m_CorkDeadlineTicks = (long long)flushDeadlineUs * m_TickFrequency / 1000000;
+}
+
+void NetServer::RecordSendAge(SEND_PRIORITY priority, int frameCount, long long totalTicks, long long maxTicks)
+{
+	if (frameCount == 0)
+		return;
+
+	SEND_LANE_COUNTER& counter = m_SendLaneCounter[(int)priority];
+	counter.frameCount += frameCount;
+	counter.totalAgeTicks += totalTicks;
+
+	unsigned long long max = counter.maxAgeTicks.load(std::memory_order_relaxed);
+	while ((unsigned long long)maxTicks > max && !counter.maxAgeTicks.compare_exchange_weak(max, maxTicks))
+	{
+	}
+}
+
+SEND_LANE_STATS NetServer::GetSendLaneStats(SEND_PRIORITY priority) const
+{
+	const SEND_LANE_COUNTER& counter = m_SendLaneCounter[(int)priority];
 
-	if (pSession->sessionUID != sessionUID || pSession->IsReleased())
+	SEND_LANE_STATS stats;
+	stats.frameCount = counter.frameCount;
+	stats.totalAgeUs = counter.totalAgeTicks * 1000000 / m_TickFrequency;
+	stats.maxAgeUs = counter.maxAgeTicks * 1000000 / m_TickFrequency;
+	return stats;
+}
+
+void NetServer::ResetSendLaneStats()
+{
+	for (SEND_LANE_COUNTER& counter : m_SendLaneCounter)
+	{
+		counter.frameCount = 0;
+		counter.totalAgeTicks = 0;
+		counter.maxAgeTicks = 0;
+	}
+}
+
+bool NetServer::Send(SESSION_UID sessionUID, MESSAGE* pMessage, SEND_PRIORITY priority, bool sendNow)
+{
+	if (pMessage == nullptr)
+		return false;
+
+	SESSION* pSession = AcquireSession(sessionUID);
+	if (pSession == nullptr)
 	{
 		FreeMessage(pMessage);
 		return false;
 	}
 
-	pSession->sendQ.push(pMessage);
+	if (m_Capture.IsOpen())
+		m_Capture.Append(CAPTURE_DIRECTION::SEND, sessionUID, pMessage);
+
+	if (m_Tracer.IsEnabled() && pMessage->traceId == 0)
+		pMessage->traceId = m_Tracer.Sample();
+
+	// straight into the ring only with nothing queued ahead of it
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink != nullptr && pShmLink->sendActive && !pSession->HasQueuedSend() && !pShmLink->writing.exchange(true))
+	{
+		bool written = pShmLink->pCarry == nullptr && !pSession->HasQueuedSend() && pShmLink->channel.Write(pMessage);
+		pShmLink->writing = false;
+
+		if (written)
+		{
+			FreeMessage(pMessage);
+			UnlockPrevent(pSession);
+			return true;
+		}
+	}
+
+	PushSend(pSession, pMessage, priority);
+
+	if (sendNow)
+		pSession->flushRequested = true;
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(sessionUID));
+
+	UnlockPrevent(pSession);
 
 	return true;
 }
 
-bool NetServer::Disconnect(SESSION_UID sessionUID)
+bool NetServer::Send(SESSION_UID sessionUID, MessageChain& chain, SEND_PRIORITY priority, bool sendNow)
 {
-	SESSION* pSession = GetSession(sessionUID);
+	if (chain.GetFirst() == nullptr)
+		return false;
+
+	SESSION* pSession = AcquireSession(sessionUID);
 	if (pSession == nullptr)
+	{
+		chain.Clear();
 		return false;
+	}
+
+	MESSAGE* pLast = nullptr;
+	MESSAGE* pFirst = chain.Detach(pLast);
+
+	if (m_Tracer.IsEnabled())
+		pFirst->traceId = m_Tracer.Sample();
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	// PostSend may free the fragments right after the push
+	int chainBytes = 0;
+	for (MESSAGE* pMessage = pFirst; pMessage != nullptr; pMessage = MessageChain::GetNext(pMessage))
+	{
+		if (m_Capture.IsOpen())
+			m_Capture.Append(CAPTURE_DIRECTION::SEND, sessionUID, pMessage);
+
+		pMessage->queuedTick = now.QuadPart;
+		chainBytes += sizeof(pMessage->header) + pMessage->header.length;
+	}
+
+	if (pFirst->traceId != 0)
+		m_Tracer.Record(pFirst->traceId, TRACE_POINT::SEND_QUEUED, sessionUID);
 
-	std::lock_guard<std::mutex> lock(pSession->lock);
+	// one push, no other frame between the fragments
+	if (priority == SEND_PRIORITY::HIGH)
+		pSession->sendHighQ.PushList(pFirst, pLast);
+	else
+		pSession->sendQ.PushList(pFirst, pLast);
 
-	if (pSession->IsReleased())
+	if (m_CorkBytes > 0)
+	{
+		pSession->corkBytes += chainBytes;
+
+		long long noTick = 0;
+		pSession->corkTick.compare_exchange_strong(noTick, now.QuadPart);
+	}
+
+	if (sendNow)
+		pSession->flushRequested = true;
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(sessionUID));
+
+	UnlockPrevent(pSession);
+
+	return true;
+}
+
+bool NetServer::Flush(SESSION_UID sessionUID)
+{
+	SESSION* pSession = AcquireSession(sessionUID);
+	if (pSession == nullptr)
 		return false;
 
-	if (pSession->sessionUID != sessionUID)
+	pSession->flushRequested = true;
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(sessionUID));
+
+	UnlockPrevent(pSession);
+
+	return true;
+}
+
+bool NetServer::Disconnect(SESSION_UID sessionUID)
+{
+	SESSION* pSession = AcquireSession(sessionUID);
+	if (pSession == nullptr)
 		return false;
 
-	shutdown(pSession->sessionSocket, SD_BOTH);
+	ShutdownSession(pSession);
+
+	UnlockPrevent(pSession);
 
 	return true;
 }
@@ -201,70 +628,208 @@ bool NetServer::FreeMessage(MESSAGE* pMessage)
 	return true;
 }
 
-void NetServer::WorkerThread()
+MessageChain NetServer::CreateChain()
 {
-	while (true)
-	{
-		SESSION*	pSession = nullptr;
-		OVERLAPPED* pOverlapped = nullptr;
-		DWORD		transferredBytes = 0;
+	return MessageChain([this]() { return AllocateMessage(); }, [this](MESSAGE* pMessage) { FreeMessage(pMessage); });
+}
 
-		// available error : ERROR_OPERATION_ABORTED, ERROR_ABANDONED_WAIT_0, WAIT_TIMEOUT
-		GetQueuedCompletionStatus(m_hIocp, &transferredBytes, (PULONG_PTR)&pSession, &pOverlapped, INFINITE);
-		if (pOverlapped == nullptr)
-		{
-			PostQueuedCompletionStatus(m_hIocp, NULL, NULL, NULL);
-			break;
-		}
+void NetServer::WorkerThread(THREAD_SLOT* pSlot, int numaNode)
+{
+	t_IsWorkerThread = true;
+
+	if (pSlot->core >= 0 || m_NetCoreMask != 0)
+		PinThread(pSlot->core);
+	else
+		LargePageArena::BindThreadToNumaNode(numaNode);
+
+	// after binding, for the worker's node
+	if (m_UseLargePageArena)
+		m_MessagePool.Reserve();
+
+	const int batchSize = (std::min)((std::max)(m_Threading.dequeueBatch, 1), MAX_DEQUEUE_BATCH);
+
+	OVERLAPPED_ENTRY entries[MAX_DEQUEUE_BATCH];
 
-		if (transferredBytes == 0 || pOverlapped->Internal == ERROR_OPERATION_ABORTED)
+	LARGE_INTEGER wakeup;
+	wakeup.QuadPart = 0;
+	bool exit = false;
+	bool retire = false;
+	while (!exit)
+	{
+		if (wakeup.QuadPart != 0)
 		{
-			NetUtil::PrintError(WSAGetLastError(), __LINE__);
-			UnlockPrevent(pSession);
-			continue;
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+			pSlot->busyTicks.store(pSlot->busyTicks.load(std::memory_order_relaxed) + now.QuadPart - wakeup.QuadPart, std::memory_order_relaxed);
 		}
 
-		if (&pSession->recvOverlapped == pOverlapped) // recv complete
+		if (retire)
 		{
-			AfterRecvProcess(pSession, transferredBytes);
+			retire = false;
+			pSlot->running = false;
+			WaitForSingleObject(pSlot->hWake, INFINITE);
 		}
-		else if (&pSession->sendOverlapped == pOverlapped) // send complete
+
+		const int entryCnt = WaitCompletions(pSlot, entries, batchSize);
+		QueryPerformanceCounter(&wakeup);
+
+		// finish the batch even past a shutdown or retire
+		for (int i = 0; i < entryCnt; ++i)
 		{
-			AfterSendProcess(pSession);
+			OVERLAPPED_ENTRY& entry = entries[i];
+			if (entry.lpOverlapped == &m_RetireOverlapped)
+				retire = true;
+			else if (!HandleCompletion((SESSION*)entry.lpCompletionKey, entry.lpOverlapped, entry.dwNumberOfBytesTransferred, wakeup))
+				exit = true;
 		}
+	}
+
+	pSlot->running = false;
+}
+
+bool NetServer::HandleCompletion(SESSION* pSession, OVERLAPPED* pOverlapped, DWORD transferredBytes, const LARGE_INTEGER& wakeup)
+{
+	if (pOverlapped == nullptr)
+	{
+		PostQueuedCompletionStatus(m_hIocp, NULL, NULL, NULL);
+		return false;
+	}
 
+	if (pOverlapped == &m_ProbeOverlapped)
+	{
+		m_ProbeDelayTicks = wakeup.QuadPart - m_ProbeTick;
+		m_ProbePending = false;
+		return true;
+	}
+
+	// Publish chunk
+	if (pSession == nullptr)
+	{
+		FANOUT_TASK* pTask = reinterpret_cast<FANOUT_TASK*>(pOverlapped);
+		FanOut(pTask->pFrame, *pTask->members, pTask->begin, pTask->end);
+		delete pTask;
+		return true;
+	}
+
+	// no reference held, the byte count is the generation
+	if (&pSession->releaseOverlapped == pOverlapped)
+	{
+		ReleasePosted(pSession, transferredBytes);
+		return true;
+	}
+
+	if (transferredBytes == 0 || pOverlapped->Internal == ERROR_OPERATION_ABORTED)
+	{
+		NetUtil::PrintError(WSAGetLastError(), __LINE__);
 		UnlockPrevent(pSession);
+		return true;
+	}
+
+	if (&pSession->recvOverlapped == pOverlapped) // recv complete
+	{
+		AfterRecvProcess(pSession, transferredBytes);
 	}
+	else if (&pSession->sendOverlapped == pOverlapped) // send complete
+	{
+		AfterSendProcess(pSession);
+	}
+	else if (&pSession->shmOverlapped == pOverlapped) // shared memory ring has frames
+	{
+		DeleteResumeTimer(pSession->shmResumeTimer);
+		DrainShm(pSession);
+	}
+	else if (&pSession->resumeOverlapped == pOverlapped) // yielded or throttled session is due
+	{
+		DeleteResumeTimer(pSession->resumeTimer);
+		AfterRecvProcess(pSession, 0);
+	}
+
+	UnlockPrevent(pSession);
+	return true;
 }
 
-void NetServer::SendThread()
+// each send thread scans every sendThreadCnt-th session, so no two ever PostSend the same one
+void NetServer::SendThread(THREAD_SLOT* pSlot, int sendIndex)
 {
+	PinThread(pSlot->core);
+
+	const int sendThreadCnt = m_Threading.sendThreadCnt;
+	bool	  paused = false;
 	while (true)
 	{
-		for (int idx = 0; idx < m_MaxClientCnt; ++idx)
+		if (m_HandOff)
 		{
-			SESSION* pSession = &m_SessionArray[idx];
-			if (pSession == nullptr)
-				continue;
+			if (!paused)
+			{
+				paused = true;
+				++m_PausedSendThreadCnt;
+			}
 
-			if (pSession->sessionSocket == 0)
+			Sleep(1);
+			continue;
+		}
+
+		LARGE_INTEGER scanBegin;
+		QueryPerformanceCounter(&scanBegin);
+		bool sent = false;
+
+		const int tableSize = m_SessionTableSize.load(std::memory_order_acquire);
+		for (int idx = sendIndex; idx < tableSize; idx += sendThreadCnt)
+		{
+			std::atomic<char>& sendReady = GetSendReady(idx);
+			if (sendReady.load(std::memory_order_relaxed) == 0)
 				continue;
 
-			if (pSession->sendQ.empty())
+			sendReady.store(0);
+
+			SESSION* pSession = GetSession(idx);
+			if (!PreventRelease(pSession))
 				continue;
 
 			PostSend(pSession);
+			sent = true;
+
+			if (pSession->HasQueuedSend())
+				MarkSendReady(idx);
+
+			UnlockPrevent(pSession);
+		}
+
+		if (sent)
+		{
+			LARGE_INTEGER scanEnd;
+			QueryPerformanceCounter(&scanEnd);
+			pSlot->busyTicks.store(pSlot->busyTicks.load(std::memory_order_relaxed) + scanEnd.QuadPart - scanBegin.QuadPart, std::memory_order_relaxed);
 		}
 	}
 }
 
-void NetServer::AcceptThread()
+void NetServer::AcceptThread(THREAD_SLOT* pSlot)
 {
+	PinThread(pSlot->core);
+
+	LARGE_INTEGER wakeup;
+	wakeup.QuadPart = 0;
 	while (true)
 	{
+		if (wakeup.QuadPart != 0)
+		{
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+			pSlot->busyTicks.store(pSlot->busyTicks.load(std::memory_order_relaxed) + now.QuadPart - wakeup.QuadPart, std::memory_order_relaxed);
+		}
+
 		SOCKADDR_IN addr;
 		int			size = sizeof(addr);
 		SOCKET		acceptSocket = accept(m_listenSocket, (SOCKADDR*)&addr, &size);
+		QueryPerformanceCounter(&wakeup);
+		if (m_HandOff)
+		{
+			if (acceptSocket != INVALID_SOCKET)
+				closesocket(acceptSocket);
+			break;
+		}
+
 		if (acceptSocket == INVALID_SOCKET)
 		{
 			switch (WSAGetLastError())
@@ -294,18 +859,13 @@ void NetServer::AcceptThread()
 		}
 
 		int sessionIdx;
-		if (!m_queueSessionIndexArray.try_pop(sessionIdx))
+		if (!PopFreeSession(sessionIdx))
 		{
 			closesocket(acceptSocket);
 			continue;
 		}
 
-		SESSION* pSession = &m_SessionArray[sessionIdx];
-		if (pSession == nullptr)
-		{
-			closesocket(acceptSocket);
-			continue;
-		}
+		SESSION* pSession = GetSession(sessionIdx);
 
 		if (CreateIoCompletionPort((HANDLE)acceptSocket, m_hIocp, (ULONG_PTR)pSession, NULL) == NULL)
 		{
@@ -316,28 +876,39 @@ void NetServer::AcceptThread()
 
 		++m_AtomicCurrentClientCount;
 
-		pSession->Reset();
+		JoinSession(pSession, sessionIdx, acceptSocket, nullptr);
+	}
 
-		//혹시 해제되지 못했던 메시지를 반환시켜준다.
-		MESSAGE* pMessage = nullptr;
-		while (pSession->sendQ.try_pop(pMessage))
-			FreeMessage(pMessage);
+	pSlot->running = false;
+}
 
-		while (pSession->sendPendingQ.try_pop(pMessage))
-			FreeMessage(pMessage);
+void NetServer::JoinSession(SESSION* pSession, int sessionIdx, SOCKET sessionSocket, LoopbackPipe* pLoopback)
+{
+	pSession->Reset();
 
-		pSession->sessionSocket = acceptSocket;
-		pSession->sessionUID = NetUtil::MakeSessionUID(sessionIdx, ++m_AtomicSessionUID);
-		pSession->SetReleaseState(false);
+	//혹시 해제되지 못했던 메시지를 반환시켜준다.
+	FreeSendQueues(pSession);
 
-		PreventRelease(pSession);
+	pSession->sessionSocket = sessionSocket;
+	pSession->pLoopback = pLoopback;
+	pSession->sessionUID = NetUtil::MakeSessionUID(sessionIdx, ++m_AtomicSessionUID);
+	pSession->Activate(pSession->sessionUID);
 
-		OnClientJoin(pSession->sessionUID);
+	ResetRateLimit(pSession);
 
-		PostRecv(pSession);
+	BindUdpPeer(pSession);
 
-		UnlockPrevent(pSession);
-	}
+	OfferIntegrity(pSession);
+
+	OfferEncryption(pSession);
+
+	OfferSharedMemory(pSession);
+
+	OnClientJoin(pSession->sessionUID);
+
+	PostRecv(pSession);
+
+	UnlockPrevent(pSession);
 }
 
 void NetServer::AfterRecvProcess(SESSION* pSession, DWORD transferredBytes)
@@ -345,60 +916,257 @@ void NetServer::AfterRecvProcess(SESSION* pSession, DWORD transferredBytes)
 	if (pSession == nullptr)
 		return;
 
+	if (pSession->pLargeMessage != nullptr)
+	{
+		if (AfterLargeRecvProcess(pSession, transferredBytes))
+			PostRecv(pSession);
+		return;
+	}
+
 	RingBuffer& recvQ = pSession->recvQ;
 	recvQ.move_head(transferredBytes);
 
+	int framedCount = 0;
 	while (true)
 	{
-		HEADER header;
+		HEADER		 header;
+		FRAME_STATUS status = PeekFrame(recvQ, header);
+		if (status == FRAME_STATUS::INVALID)
+			return;
 
-		const size_t headerSize = sizeof(header);
-		const size_t useSize = recvQ.size_in_use();
-		if (useSize <= sizeof(header))
+		const bool isLarge = m_LargeFrameThreshold > 0 && header.length >= m_LargeFrameThreshold;
+		if (status == FRAME_STATUS::INCOMPLETE && !isLarge)
 			break;
 
-		if (recvQ.peek((char*)&header, headerSize) == false)
+		if (m_RecvBudget > 0 && framedCount++ >= m_RecvBudget)
+		{
+			ResumeRecv(pSession, 0);
 			return;
+		}
 
-		if (header.length >= RINGBUFFER_SIZE - headerSize)
+		// no recv until resumed
+		if (!AdmitFrame(pSession, sizeof(header) + header.length, pSession->resumeTimer, &pSession->resumeOverlapped))
 			return;
 
-		if (static_cast<short>(useSize - headerSize) < header.length)
+		if (status == FRAME_STATUS::INCOMPLETE)
+		{
+			BeginLargeRecv(pSession, recvQ.size_in_use());
 			break;
+		}
 
 		MESSAGE* pMessage = AllocateMessage();
 		if (pMessage == nullptr)
 			return;
 
-		recvQ.peek((char*)pMessage, headerSize + header.length);
-		recvQ.move_tail(headerSize + header.length);
+		PopFrame(recvQ, header, pMessage);
 
-		OnRecv(pSession->sessionUID, pMessage);
+		if (!ProcessFrame(pSession, pMessage))
+			return;
 	}
 
 	PostRecv(pSession);
 }
 
+// false when the frame doesn't open, it is freed
+bool NetServer::ProcessFrame(SESSION* pSession, MESSAGE* pMessage)
+{
+	if (m_Tracer.IsEnabled() && pMessage->header.type == PACKET_TYPE::USER)
+		TraceFramed(pSession, pMessage);
+
+	if (!OpenFrame(pSession, pMessage))
+	{
+		NetUtil::PrintError(ERROR_INVALID_DATA, __LINE__);
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	if (pMessage->header.type == PACKET_TYPE::SYSTEM)
+	{
+		m_SystemPacketProcessor.RunProcessor(pSession, pMessage);
+		FreeMessage(pMessage);
+		return true;
+	}
+
+	DispatchRecv(pSession, pMessage);
+	return true;
+}
+
+void NetServer::BeginLargeRecv(SESSION* pSession, size_t bufferedSize)
+{
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	RingBuffer& recvQ = pSession->recvQ;
+	recvQ.peek((char*)pMessage, bufferedSize);
+	recvQ.move_tail(bufferedSize);
+
+	pSession->pLargeMessage = pMessage;
+	pSession->largeReceivedSize = (int)bufferedSize;
+}
+
+bool NetServer::AfterLargeRecvProcess(SESSION* pSession, DWORD transferredBytes)
+{
+	MESSAGE* pMessage = pSession->pLargeMessage;
+
+	pSession->largeReceivedSize += transferredBytes;
+	if (pSession->largeReceivedSize < (int)sizeof(pMessage->header) + pMessage->header.length)
+		return true;
+
+	pSession->pLargeMessage = nullptr;
+	pSession->largeReceivedSize = 0;
+
+	return ProcessFrame(pSession, pMessage);
+}
+
+void NetServer::TraceFramed(SESSION* pSession, MESSAGE* pMessage)
+{
+	pMessage->traceId = m_Tracer.Sample();
+	if (pMessage->traceId != 0)
+		m_Tracer.Record(pMessage->traceId, TRACE_POINT::RECV_FRAMED, pSession->sessionUID);
+}
+
+void NetServer::DispatchRecv(SESSION* pSession, MESSAGE* pMessage)
+{
+	if (m_Capture.IsOpen())
+		m_Capture.Append(CAPTURE_DIRECTION::RECV, pSession->sessionUID, pMessage);
+
+	const unsigned int traceId = pMessage->traceId;
+	if (traceId != 0)
+		m_Tracer.Record(traceId, TRACE_POINT::ONRECV_ENTER, pSession->sessionUID);
+
+	OnRecv(pSession->sessionUID, pMessage);
+
+	if (traceId != 0)
+		m_Tracer.Record(traceId, TRACE_POINT::ONRECV_EXIT, pSession->sessionUID);
+}
+
 void NetServer::AfterSendProcess(SESSION* pSession)
 {
 	if (pSession == nullptr)
 		return;
 
+	MESSAGE* pMessage = pSession->pSendPending.load(std::memory_order_relaxed);
+	while (pMessage != nullptr)
+	{
+		MESSAGE* pNext = pMessage->pNext.load(std::memory_order_relaxed);
+		if (pMessage->traceId != 0)
+			m_Tracer.Record(pMessage->traceId, TRACE_POINT::SEND_COMPLETE, pSession->sessionUID);
+
+		FreeMessage(pMessage);
+		pMessage = pNext;
+	}
+
+	FRAME_REF* pRef = pSession->pSendPendingRef.load(std::memory_order_relaxed);
+	while (pRef != nullptr)
+	{
+		FRAME_REF* pNext = pRef->pNext.load(std::memory_order_relaxed);
+		ReleaseFrameRef(pRef);
+		pRef = pNext;
+	}
+
+	// tail before the release stores
+	pSession->pSendPendingTail = nullptr;
+	pSession->pSendPendingRef.store(nullptr, std::memory_order_release);
+	pSession->pSendPending.store(nullptr, std::memory_order_release);
+}
+
+// only with no other consumer: accept, release or hand off
+void NetServer::FreeSendQueues(SESSION* pSession)
+{
 	MESSAGE* pMessage = nullptr;
-	while (pSession->sendPendingQ.try_pop(pMessage))
+	while ((pMessage = pSession->sendHighQ.Pop()) != nullptr)
 		FreeMessage(pMessage);
+
+	while ((pMessage = pSession->sendQ.Pop()) != nullptr)
+		FreeMessage(pMessage);
+
+	FRAME_REF* pRef = nullptr;
+	while ((pRef = pSession->sendSharedQ.Pop()) != nullptr)
+		ReleaseFrameRef(pRef);
+
+	AfterSendProcess(pSession);
 }
 
-SESSION* NetServer::GetSession(SESSION_UID sessionUID)
+// the CRC trailer is encrypted with the payload
+bool NetServer::SealFrame(SESSION* pSession, MESSAGE* pMessage)
+{
+	if (pSession->integritySend && !pMessage->SealIntegrity())
+		return false;
+
+	if (pSession->encryptSend && !pMessage->Encrypt(pSession->sendCrypto))
+		return false;
+
+	return true;
+}
+
+bool NetServer::OpenFrame(SESSION* pSession, MESSAGE* pMessage)
+{
+	if (pSession->decryptRecv && !pMessage->Decrypt(pSession->recvCrypto))
+		return false;
+
+	if (pSession->integrityRecv && !pMessage->CheckIntegrity())
+		return false;
+
+	return true;
+}
+
+// IntegrityReady / IntegritySwitch are the last unsealed frames each way
+void NetServer::OfferIntegrity(SESSION* pSession)
+{
+	if (!m_UseIntegrity)
+		return;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_IntegrityOffer packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	Send(pSession->sessionUID, pMessage);
+}
+
+void NetServer::OnIntegrityReady(SESSION* pSession)
+{
+	if (!m_UseIntegrity || pSession->integrityRecv)
+		return;
+
+	pSession->integrityRecv = true;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_IntegritySwitch packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	// set before the push
+	pSession->pIntegritySwitchMessage = pMessage;
+	PushSend(pSession, pMessage, SEND_PRIORITY::BULK);
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(pSession->sessionUID));
+}
+
+// pin before validating. the caller must UnlockPrevent a returned session
+SESSION* NetServer::AcquireSession(SESSION_UID sessionUID)
 {
 	int sessionIdx = NetUtil::GetSessionIndexPart(sessionUID);
-	if (sessionIdx >= m_MaxClientCnt)
+	if (sessionIdx < 0 || sessionIdx >= m_SessionTableSize.load(std::memory_order_acquire))
 		return nullptr;
 
-	if (m_SessionArray[sessionIdx].sessionUID == sessionUID)
-		return &m_SessionArray[sessionIdx];
+	SESSION* pSession = GetSession(sessionIdx);
+
+	unsigned long long state = pSession->refState.fetch_add(1) + 1;
+	if ((state & SESSION::RELEASE_BIT) != 0 || (state & SESSION::GENERATION_MASK) != SESSION::MakeGeneration(sessionUID))
+	{
+		UnlockPrevent(pSession);
+		return nullptr;
+	}
 
-	return nullptr;
+	return pSession;
 }
 
 void NetServer::ReleaseSession(SESSION* pSession)
@@ -406,42 +1174,53 @@ void NetServer::ReleaseSession(SESSION* pSession)
 	if (pSession == nullptr)
 		return;
 
-	std::lock_guard<std::mutex> lock(pSession->lock);
-
-	if (pSession->IsReleased())
+	if (!pSession->TryMarkReleased())
 		return;
 
-	pSession->SetReleaseState(true);
-
-	closesocket(pSession->sessionSocket);
+	CloseSession(pSession);
 
 	OnClientLeave(pSession->sessionUID);
 
-	MESSAGE* pMessage = nullptr;
-	while (pSession->sendQ.try_pop(pMessage))
-		FreeMessage(pMessage);
+	// after OnClientLeave, it may still publish
+	LeaveTopics(pSession);
 
-	while (pSession->sendPendingQ.try_pop(pMessage))
-		FreeMessage(pMessage);
+	FreeSendQueues(pSession);
+
+	FreeMessage(pSession->pLargeMessage);
 
 	int sessionIndex = NetUtil::GetSessionIndexPart(pSession->sessionUID);
 
+	UdpPeer* pUdpPeer = GetUdpPeer(sessionIndex);
+	if (pUdpPeer != nullptr)
+		pUdpPeer->Clear(m_UdpFree);
+
+	ReleaseShmLink(pSession);
+
 	pSession->Reset();
 
-	m_queueSessionIndexArray.push(sessionIndex);
+	PushFreeSession(sessionIndex);
 
 	--m_AtomicCurrentClientCount;
 }
 
+void NetServer::MarkSendReady(int sessionIndex)
+{
+	std::atomic<char>& sendReady = GetSendReady(sessionIndex);
+	if (sendReady.load(std::memory_order_relaxed) == 0)
+		sendReady.store(1);
+}
+
 bool NetServer::PreventRelease(SESSION* pSession)
 {
 	if (pSession == nullptr)
 		return false;
 
-	if (pSession->IsReleased())
+	if ((pSession->refState.fetch_add(1) & SESSION::RELEASE_BIT) != 0)
+	{
+		--pSession->refState;
 		return false;
+	}
 
-	++pSession->ioCount;
 	return true;
 }
 
@@ -450,46 +1229,30 @@ bool NetServer::UnlockPrevent(SESSION* pSession)
 	if (pSession == nullptr)
 		return false;
 
-	if (pSession->IsReleased())
+	unsigned long long state = --pSession->refState;
+	if ((state & SESSION::RELEASE_BIT) != 0)
 		return false;
 
-	if (--pSession->ioCount == 0)
+	if ((state & SESSION::REFCOUNT_MASK) == 0)
 	{
+		if (m_HandOff)
+			return true;
+
+		// OnClientLeave only runs on a worker, never under the application's locks
+		const DWORD generation = (DWORD)((state & SESSION::GENERATION_MASK) >> 32);
+		if (!t_IsWorkerThread && PostQueuedCompletionStatus(m_hIocp, generation, (ULONG_PTR)pSession, &pSession->releaseOverlapped))
+			return true;
+
 		ReleaseSession(pSession);
 	}
 	return true;
 }
 
-class TestServer : public NetServer
+void NetServer::ReleasePosted(SESSION* pSession, DWORD generation)
 {
-	bool OnConnectionRequest(char* pClientIP, short port)
-	{
-		return true;
-	}
-
-	void OnClientJoin(SESSION_UID sessionUID)
-	{
-		std::cout << "Client come : " << sessionUID << std::endl;
-	}
-
-	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
-	{
-		if (!Send(sessionUID, pMessage))
-		{
-			std::cout << "Send Fail!" << std::endl;
-		}
-	}
-
-	void OnClientLeave(SESSION_UID sessionUID)
-	{
-		std::cout << "Client Leave : " << sessionUID << std::endl;
-	}
-};
-
-TestServer server;
+	const unsigned long long state = pSession->refState.load();
+	if (m_HandOff || (state & SESSION::GENERATION_MASK) >> 32 != generation)
+		return;
 
-int main()
-{
-	server.Start("0.0.0.0", 27931, 5, false, 400);
-	Sleep(INFINITE);
+	ReleaseSession(pSession);
 }
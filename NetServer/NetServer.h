@@ -6,35 +6,225 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
 #include <concurrent_unordered_map.h>
 #include <concurrent_queue.h>
 
 #include "RingBuffer.h"
 #include "Protocol.h"
 #include "ThreadLocalMemoryPool.h"
+#include "LargePageArena.h"
+#include "UdpTransport.h"
+#include "ShmTransport.h"
+#include "LoopbackTransport.h"
+#include "TrafficCapture.h"
+#include "MessageTracer.h"
+#include "X25519.h"
+#include "TokenBucket.h"
+#include "TopicTable.h"
+#include "MessageChain.h"
+#include "RpcCallTable.h"
+#include "MpscQueue.h"
+#include "SystemPacketProcessor.h"
 
 #include "GlobalValue.h"
 
-using SESSION_UID = long long;
+class NetServer;
+class SESSION;
+struct SHM_LINK;
 
+enum class RATE_LIMIT_POLICY
+{
+	THROTTLE,  // stop reading until the buckets refill
+	DISCONNECT
+};
+
+// a rate of 0 turns that bucket off
+struct RATE_LIMIT
+{
+	int				  messagesPerSecond = 0;
+	int				  messageBurst = 0;
+	int				  bytesPerSecond = 0;
+	int				  byteBurst = 0;
+	RATE_LIMIT_POLICY policy = RATE_LIMIT_POLICY::THROTTLE;
+};
+
+// HIGH goes first, BULK keeps BULK_SEND_SHARE buffers of each WSASend while it has frames
+enum class SEND_PRIORITY
+{
+	HIGH,
+	BULK,
+	COUNT
+};
+
+struct SEND_LANE_STATS
+{
+	unsigned long long frameCount;
+	unsigned long long totalAgeUs;
+	unsigned long long maxAgeUs;
+};
+
+// added to once per PostSend, not per frame
+struct alignas(CACHE_LINE_SIZE) SEND_LANE_COUNTER
+{
+	std::atomic<unsigned long long> frameCount{ 0 };
+	std::atomic<unsigned long long> totalAgeTicks{ 0 };
+	std::atomic<unsigned long long> maxAgeTicks{ 0 };
+};
+
+enum class THREAD_ROLE
+{
+	WORKER,
+	SEND,
+	ACCEPT
+};
+
+// logical processor numbers in the process's group, taken round robin. unpinned threads stay off reservedCores
+struct THREADING_CONFIG
+{
+	std::vector<int> workerCores;
+	std::vector<int> sendCores;
+	int				 acceptCore = -1;
+	std::vector<int> reservedCores;
+	int				 sendThreadCnt = 1;
+
+	// 0 keeps the count Start was given
+	int minWorkerCnt = 0;
+	int maxWorkerCnt = 0;
+	int sampleIntervalMs = 1000;
+	int scaleUpDelayUs = 1000;
+	int scaleUpUtilization = 80;
+	int scaleDownUtilization = 30;
+
+	// workers poll the port up to spinUs before blocking, 0 blocks at once
+	int spinUs = 0;
+	int spinBudgetPercent = 25;
+	int dequeueBatch = 1;
+};
+
+struct THREAD_STATS
+{
+	THREAD_ROLE role;
+	int			core;		 // -1 when not pinned
+	int			utilization; // percent of the last sample interval
+	int			spinPercent;
+	int			spinHitRate;
+	bool		running;
+};
+
+// the array isn't cache line aligned, padding keeps busyTicks off the neighbour's line
+struct THREAD_SLOT
+{
+	std::atomic<long long> busyTicks{ 0 };
+	char				   padding[CACHE_LINE_SIZE];
+	THREAD_ROLE			   role = THREAD_ROLE::WORKER;
+	int					   core = -1;
+	std::thread			   thread;
+	HANDLE				   hWake = NULL; // a retired worker parks on it
+	std::atomic<bool>	   running{ false };
+	std::atomic<int>	   utilization{ 0 };
+	long long			   sampledBusyTicks = 0; // monitor thread only
+
+	// written by the worker itself
+	std::atomic<long long> spinTicks{ 0 };
+	std::atomic<long long> spinCnt{ 0 };
+	std::atomic<long long> spinHitCnt{ 0 };
+	std::atomic<int>	   spinPercent{ 0 };
+	std::atomic<int>	   spinHitRate{ 0 };
+	std::atomic<bool>	   spinCapped{ false }; // monitor thread only
+	int					   spinWindowUs = 0;	// worker only
+	long long			   sampledSpinTicks = 0; // monitor thread only
+	long long			   sampledSpinCnt = 0;
+	long long			   sampledSpinHitCnt = 0;
+};
+
+// the frame is read only, freed by whoever drops shareCount to zero
+struct FRAME_REF
+{
+	std::atomic<FRAME_REF*> pNext;
+	MESSAGE*				pFrame;
+};
+
+struct FANOUT_TASK
+{
+	OVERLAPPED	  overlapped;
+	MESSAGE*	  pFrame;
+	TOPIC_MEMBERS members;
+	int			  begin;
+	int			  end;
+};
+
+// the reply may be sent later, from any thread
+using RPC_HANDLER = std::function<void(SESSION_UID sessionUID, RPC_CALL_ID callId, const char* pBody, int bodySize)>;
+
+// the callback can run before hTimer is written, the last of the two to check in through pending posts
+struct RESUME_TIMER
+{
+	NetServer*		 pServer;
+	SESSION*		 pSession;
+	OVERLAPPED*		 pOverlapped;
+	HANDLE			 hTimer;
+	std::atomic<int> pending;
+};
+
+// members are grouped by writer, one cache line group each.
+// refState : RELEASE_BIT | generation << 32 | io refcount
 class SESSION
 {
 public:
+	static constexpr unsigned long long RELEASE_BIT = 1ULL << 63;
+	static constexpr unsigned long long GENERATION_MASK = 0x7FFFFFFFULL << 32;
+	static constexpr unsigned long long REFCOUNT_MASK = 0xFFFFFFFFULL;
+
 	SESSION()
 	: recvQ(RINGBUFFER_SIZE)
+	, refState(RELEASE_BIT)
+	{
+	}
+
+	explicit SESSION(char* pRecvBuffer)
+	: recvQ(pRecvBuffer, RINGBUFFER_SIZE)
+	, refState(RELEASE_BIT)
 	{
 	}
 
+	static unsigned long long MakeGeneration(SESSION_UID sessionUID) { return ((unsigned long long)sessionUID << 32) & GENERATION_MASK; }
+
+	bool HasQueuedSend() const { return !sendHighQ.IsEmpty() || !sendQ.IsEmpty() || !sendSharedQ.IsEmpty(); }
+
 	void Reset()
 	{
 		sessionSocket = 0;
 		sessionUID = 0;
-		releaseFlag = true;
-		sessionIndex = 0;
 		ZeroMemory(&recvOverlapped, sizeof(recvOverlapped));
 		ZeroMemory(&sendOverlapped, sizeof(sendOverlapped));
 		recvQ.Reset();
-		ioCount = 0;
+		pLargeMessage = nullptr;
+		largeReceivedSize = 0;
+		ZeroMemory(&shmOverlapped, sizeof(shmOverlapped));
+		ZeroMemory(&resumeOverlapped, sizeof(resumeOverlapped));
+		resumeTimer.hTimer = nullptr;
+		shmResumeTimer.hTimer = nullptr;
+		pShmLink = nullptr;
+		integrityRecv = false;
+		integritySend = false;
+		pIntegritySwitchMessage = nullptr;
+		decryptRecv = false;
+		encryptSend = false;
+		cryptoPending = false;
+		pCryptoSwitchMessage = nullptr;
+		SecureZeroMemory(&recvCrypto, sizeof(recvCrypto));
+		SecureZeroMemory(&sendCrypto, sizeof(sendCrypto));
+		SecureZeroMemory(cryptoPrivateKey, sizeof(cryptoPrivateKey));
+		corkBytes = 0;
+		corkTick = 0;
+		flushRequested = false;
+		pChainQ = nullptr;
+		zeroCopySend = false;
+		pLoopback = nullptr;
 	}
 
 	void ResetRecvOverlapped()
@@ -47,23 +237,105 @@ public:
 		ZeroMemory(&sendOverlapped, sizeof(sendOverlapped));
 	}
 
-	void Lock() { lock.lock(); }
-	void Unlock() { lock.unlock(); }
+	// keeps refs a stale Send still holds, it drops them on the generation check
+	void Activate(SESSION_UID uid)
+	{
+		unsigned long long state = refState.load();
+		while (!refState.compare_exchange_weak(state, MakeGeneration(uid) | ((state + 1) & REFCOUNT_MASK)))
+		{
+		}
+	}
+
+	bool TryMarkReleased()
+	{
+		unsigned long long state = refState.load();
+		while ((state & RELEASE_BIT) == 0 && (state & REFCOUNT_MASK) == 0)
+		{
+			if (refState.compare_exchange_weak(state, state | RELEASE_BIT))
+				return true;
+		}
+		return false;
+	}
+
+	void MarkReleased() { refState.fetch_or(RELEASE_BIT); }
+	bool IsReleased() const { return (refState.load() & RELEASE_BIT) != 0; }
+	int	 GetIoCount() const { return (int)(refState.load() & REFCOUNT_MASK); }
+
+	// control : read by every path, written only at accept/release
+	alignas(CACHE_LINE_SIZE) SOCKET	sessionSocket;
+	SESSION_UID						sessionUID;
+	SHM_LINK*						pShmLink = nullptr;
+	LoopbackPipe*					pLoopback = nullptr;
+	std::atomic<int>				nextFreeIndex{ -1 };
+
+	// refcount : written by every post, completion and Send()
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned long long> refState;
+	OVERLAPPED										releaseOverlapped;
+
+	// recv : written only by the worker completing recv
+	alignas(CACHE_LINE_SIZE) OVERLAPPED	recvOverlapped;
+	RingBuffer							recvQ;
+	MESSAGE*							pLargeMessage;
+	int									largeReceivedSize;
+	OVERLAPPED							shmOverlapped;
+	OVERLAPPED							resumeOverlapped;
+	RESUME_TIMER						resumeTimer;
+	RESUME_TIMER						shmResumeTimer;
+	TokenBucket							messageBucket;
+	TokenBucket							byteBucket;
+	bool								integrityRecv;
+	bool								decryptRecv;
+	AEAD_STATE							recvCrypto;
+	bool								cryptoPending;
+	unsigned char						cryptoPrivateKey[X25519_KEY_SIZE];
+
+	// send producer : written by Send() callers
+	alignas(CACHE_LINE_SIZE) MpscQueue<MESSAGE> sendHighQ;
+	MpscQueue<MESSAGE>							sendQ;
+	MpscQueue<FRAME_REF>						sendSharedQ;
+	std::atomic<int>							corkBytes{ 0 };
+	std::atomic<long long>						corkTick{ 0 };	 // 0 when nothing is queued
+	std::atomic<bool>							flushRequested{ false };
+
+	// send consumer : written by PostSend and send completion
+	alignas(CACHE_LINE_SIZE) OVERLAPPED	sendOverlapped;
+	std::atomic<MESSAGE*>				pSendPending{ nullptr }; // in flight, linked through pNext
+	MESSAGE*							pSendPendingTail = nullptr;
+	std::atomic<FRAME_REF*>				pSendPendingRef{ nullptr };
+	MpscQueue<MESSAGE>*					pChainQ = nullptr; // lane of an unfinished chain
+	bool								zeroCopySend = false; // SO_SNDBUF is 0
+	int									sendBufferSize = 0;
+	bool								integritySend;
+	MESSAGE*							pIntegritySwitchMessage;
+	bool								encryptSend;
+	AEAD_STATE							sendCrypto;
+	MESSAGE*							pCryptoSwitchMessage;
+
+	// topics : written by Subscribe and Unsubscribe callers
+	alignas(CACHE_LINE_SIZE) std::mutex	topicLock;
+	std::vector<TOPIC_ID>				vecTopic;
+};
 
-	void SetReleaseState(bool release) { releaseFlag = release; }
-	bool IsReleased() { return releaseFlag; }
+// freed only by ReleaseSession. writing keeps the send ring single producer
+struct SHM_LINK
+{
+	ShmChannel		  channel;
+	NetServer*		  pServer;
+	SESSION*		  pSession;
+	HANDLE			  hWait;
+	std::atomic<bool> draining;
+	std::atomic<bool> sendActive;
+	std::atomic<bool> writing;
+	MESSAGE*		  pSwitchMessage;
+	MESSAGE*		  pCarry; // popped while the ring was full
+};
 
-	SOCKET									sessionSocket;
-	SESSION_UID								sessionUID;
-	bool									releaseFlag;
-	int										sessionIndex;
-	OVERLAPPED								recvOverlapped;
-	OVERLAPPED								sendOverlapped;
-	RingBuffer								recvQ;
-	std::atomic<int>						ioCount;
-	std::mutex								lock;
-	Concurrency::concurrent_queue<MESSAGE*> sendQ;
-	Concurrency::concurrent_queue<MESSAGE*> sendPendingQ;
+// never freed, a SESSION pointer never goes stale
+struct SESSION_SEGMENT
+{
+	SESSION*		  pSessions;
+	UdpPeer*		  pUdpPeers;
+	std::atomic<char> sendReady[SESSION_SEGMENT_SIZE];
 };
 
 class NetServer
@@ -72,47 +344,284 @@ public:
 	NetServer();
 
 	bool Start(const char* ip, short port, int workerThreadCnt, bool tcpNagleOn, int maxUserCnt);
-	bool Send(SESSION_UID sessionUID, MESSAGE* pPacket);
+
+	// no UDP, shared memory or hand off
+	bool StartLoopback(LoopbackNetwork* pNetwork, int workerThreadCnt, int maxUserCnt);
+	bool Send(SESSION_UID sessionUID, MESSAGE* pPacket, SEND_PRIORITY priority = SEND_PRIORITY::BULK, bool sendNow = false);
+
+	// leaves the chain empty
+	bool Send(SESSION_UID sessionUID, MessageChain& chain, SEND_PRIORITY priority = SEND_PRIORITY::BULK, bool sendNow = false);
+	bool Flush(SESSION_UID sessionUID);
 	bool Disconnect(SESSION_UID sessionUID);
 
+	// true from WaitHandOff means this process no longer owns any socket
+	bool WaitHandOff(const char* pipeName);
+	bool StartFromHandOff(const char* pipeName, int workerThreadCnt, int maxUserCnt);
+
+	// must be called before Start
+	void   EnableLargePageArena(bool enable) { m_UseLargePageArena = enable; }
+	size_t GetLargePageBytes() const { return m_Arena.GetLargePageBytes(); }
+	size_t GetArenaBytes() const { return m_Arena.GetTotalBytes(); }
+
+	// must be called before Start
+	void					  SetThreadingConfig(const THREADING_CONFIG& config) { m_Threading = config; }
+	std::vector<THREAD_STATS> GetThreadStats() const;
+	int						  GetWorkerCount() const { return m_ActiveWorkerCnt; }
+	long long				  GetCompletionDelayUs() const { return m_CompletionDelayUs; }
+
+	// HIGH frames, sendNow and Flush aren't held. 0 turns it off
+	void SetCork(int byteThreshold, int flushDeadlineUs);
+
+	// must be called before Start
+	void SetSessionWarmUp(int sessionCnt, int threadCnt)
+	{
+		m_WarmSessionCnt = sessionCnt;
+		m_WarmThreadCnt = threadCnt;
+	}
+
+	// lowering only turns new connections away
+	void SetMaxUserCount(int maxUserCnt) { m_MaxClientCnt = (std::min)(maxUserCnt, MAX_SESSION_COUNT); }
+	int	 GetSessionTableSize() const { return m_SessionTableSize; }
+
+	// 0 turns it off
+	void			   SetZeroCopySend(int byteThreshold) { m_ZeroCopyBytes = byteThreshold; }
+	unsigned long long GetZeroCopySendCount() const { return m_ZeroCopySendCnt; }
+	unsigned long long GetZeroCopySendBytes() const { return m_ZeroCopySendBytes; }
+
+	// 0 turns it off
+	void SetLargeFrameThreshold(int threshold) { m_LargeFrameThreshold = threshold; }
+
+	// the rate limit applies to sessions accepted afterwards
+	void SetRecvBudget(int framesPerCompletion) { m_RecvBudget = framesPerCompletion; }
+	void SetRateLimit(const RATE_LIMIT& rateLimit) { m_RateLimit = rateLimit; }
+
+	// call after Start
+	bool StartUdp(const char* ip, short port);
+	bool SendDatagram(SESSION_UID sessionUID, MESSAGE* pMessage, DELIVERY delivery);
+	void SetUdpLossSimulation(int lossPercent, int delayMs) { m_UdpSocket.SetLossSimulation(lossPercent, delayMs); }
+
+	void EnableSharedMemory(bool enable) { m_UseSharedMemory = enable; }
+
+	void EnableIntegrity(bool enable) { m_UseIntegrity = enable; }
+
+	// no server identity, an active man in the middle isn't kept out
+	void EnableEncryption(bool enable) { m_UseEncryption = enable; }
+
+	// a published frame may overtake bulk frames queued before it
+	bool Subscribe(SESSION_UID sessionUID, TOPIC_ID topic);
+	bool Unsubscribe(SESSION_UID sessionUID, TOPIC_ID topic);
+	bool Publish(TOPIC_ID topic, MESSAGE* pMessage);
+
+	// handlers must be registered before Start
+	bool RegisterRpc(int method, RPC_HANDLER handler);
+	bool Reply(SESSION_UID sessionUID, RPC_CALL_ID callId, const void* pBody, int bodySize, RPC_STATUS status = RPC_STATUS::OK);
+
+	SEND_LANE_STATS GetSendLaneStats(SEND_PRIORITY priority) const;
+	void			ResetSendLaneStats();
+
+	// <pathPrefix>_<index>.cap
+	bool StartCapture(const char* pathPrefix) { return m_Capture.Open(pathPrefix); }
+	void StopCapture() { m_Capture.Close(); }
+
+	// the dump is Chrome trace JSON
+	void StartTrace(int sampleEvery) { m_Tracer.Start(sampleEvery); }
+	void StopTrace() { m_Tracer.Stop(); }
+	bool DumpTrace(const char* path) { return m_Tracer.Dump(path); }
+
 	//Message
-	MESSAGE* AllocateMessage();
-	bool	 FreeMessage(MESSAGE* pMessage);
+	MESSAGE*	 AllocateMessage();
+	bool		 FreeMessage(MESSAGE* pMessage);
+	MessageChain CreateChain();
 
 protected:
 	virtual bool OnConnectionRequest(char* pClientIP, short port) = 0;
 	virtual void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage) = 0;
 	virtual void OnClientJoin(SESSION_UID sessionUID) = 0;
+
+	// always on an IOCP worker
 	virtual void OnClientLeave(SESSION_UID sessionUID) = 0;
 
 private:
-	void WorkerThread();
-	void AcceptThread();
-	void SendThread();
+	void WorkerThread(THREAD_SLOT* pSlot, int numaNode);
+	bool HandleCompletion(SESSION* pSession, OVERLAPPED* pOverlapped, DWORD transferredBytes, const LARGE_INTEGER& wakeup);
+	int	 WaitCompletions(THREAD_SLOT* pSlot, OVERLAPPED_ENTRY* pEntries, int batchSize);
+	void AcceptThread(THREAD_SLOT* pSlot);
+	void SendThread(THREAD_SLOT* pSlot, int sendIndex);
+	void LoopbackAcceptThread(THREAD_SLOT* pSlot);
+	void UdpThread();
+	void MonitorThread();
 
 private:
 	void AfterRecvProcess(SESSION* pSession, DWORD transferredBytes);
 	void AfterSendProcess(SESSION* pSession);
+	bool ProcessFrame(SESSION* pSession, MESSAGE* pMessage);
+	void DispatchRecv(SESSION* pSession, MESSAGE* pMessage);
+	void TraceFramed(SESSION* pSession, MESSAGE* pMessage);
+	void BeginLargeRecv(SESSION* pSession, size_t bufferedSize);
+	bool AfterLargeRecvProcess(SESSION* pSession, DWORD transferredBytes);
 	void PostRecv(SESSION* pSession);
 	void PostSend(SESSION* pSession);
+	void PushSend(SESSION* pSession, MESSAGE* pMessage, SEND_PRIORITY priority);
+	void FreeSendQueues(SESSION* pSession);
+	bool GatherSend(SESSION* pSession, MESSAGE* pMessage, WSABUF& sendBuf);
+	void GatherShared(SESSION* pSession, FRAME_REF* pRef, WSABUF& sendBuf);
+	bool IsCorked(SESSION* pSession);
+	void SelectSendBuffer(SESSION* pSession, int gatheredBytes);
+	void RecordSendAge(SEND_PRIORITY priority, int frameCount, long long totalTicks, long long maxTicks);
+
+	void	 PushShared(SESSION* pSession, FRAME_REF* pRef);
+	void	 FanOut(MESSAGE* pFrame, const std::vector<SESSION_UID>& members, int begin, int end);
+	MESSAGE* PopSharedCopy(SESSION* pSession);
+	MESSAGE* PopQueuedSend(SESSION* pSession);
+	MESSAGE* CopySharedFrame(FRAME_REF* pRef);
+	void	 ReleaseFrameRef(FRAME_REF* pRef);
+	void	 ReleaseSharedFrame(MESSAGE* pFrame);
+	void	 LeaveTopics(SESSION* pSession);
+
+	void ResumeRecv(SESSION* pSession, DWORD delayMs);
+	void ScheduleResume(SESSION* pSession, RESUME_TIMER& timer, OVERLAPPED* pOverlapped, DWORD delayMs);
+	void DeleteResumeTimer(RESUME_TIMER& timer);
+	void ResetRateLimit(SESSION* pSession);
+	bool AdmitFrame(SESSION* pSession, int frameSize, RESUME_TIMER& timer, OVERLAPPED* pResumeOverlapped);
 
-	SESSION* GetSession(SESSION_UID sessionUID);
+	void JoinSession(SESSION* pSession, int sessionIdx, SOCKET sessionSocket, LoopbackPipe* pLoopback);
+	int	 PostSessionRecv(SESSION* pSession, WSABUF* pBufs, int bufCount);
+	int	 PostSessionSend(SESSION* pSession, WSABUF* pBufs, int bufCount);
+	void ShutdownSession(SESSION* pSession);
+	void CloseSession(SESSION* pSession);
+
+	SESSION* AcquireSession(SESSION_UID sessionUID);
 	void	 ReleaseSession(SESSION* pSession);
+	void	 ReleasePosted(SESSION* pSession, DWORD generation);
 	bool	 PreventRelease(SESSION* pSession);
 	bool	 UnlockPrevent(SESSION* pSession);
+	void	 MarkSendReady(int sessionIndex);
+
+	// range checked against m_SessionTableSize by the caller
+	SESSION* GetSession(int sessionIdx) const
+	{
+		return &m_SessionSegments[sessionIdx >> SESSION_SEGMENT_SHIFT].load(std::memory_order_acquire)->pSessions[sessionIdx & (SESSION_SEGMENT_SIZE - 1)];
+	}
+	std::atomic<char>& GetSendReady(int sessionIdx)
+	{
+		return m_SessionSegments[sessionIdx >> SESSION_SEGMENT_SHIFT].load(std::memory_order_acquire)->sendReady[sessionIdx & (SESSION_SEGMENT_SIZE - 1)];
+	}
+	UdpPeer* GetUdpPeer(int sessionIdx);
+
+	bool			 InitSessionTable(int maxUserCnt, bool pushFree);
+	bool			 GrowSessionTable(int sessionCnt, int threadCnt, bool pushFree);
+	SESSION_SEGMENT* CreateSessionSegment();
+	void			 DestroySessionSegment(SESSION_SEGMENT* pSegment);
+	void			 PushFreeSession(int sessionIdx);
+	bool			 PopFreeSession(int& sessionIdx);
+
+	int	 GetMaxWorkerCount(int workerThreadCnt) const;
+	void CreateThreads(int workerThreadCnt);
+	void StartWorker(int slotIndex);
+	void PinThread(int core);
+	int	 GetSlotCore(const std::vector<int>& cores, int index) const;
+	void ScaleWorkers(int utilization, long long delayUs);
+	void SampleSpin(THREAD_SLOT& slot, long long elapsed);
+
+	void BindUdpPeer(SESSION* pSession);
+	void OnUdpDatagram(const SOCKADDR_IN& addr, const char* pData, int size);
+
+	bool SealFrame(SESSION* pSession, MESSAGE* pMessage);
+	bool OpenFrame(SESSION* pSession, MESSAGE* pMessage);
+	void OfferIntegrity(SESSION* pSession);
+	void OnIntegrityReady(SESSION* pSession);
+	void OfferEncryption(SESSION* pSession);
+	void OnCryptoReady(SESSION* pSession, SystemPacketHeader* pPacket);
+
+	void OnRpcRequest(SESSION* pSession, SystemPacketHeader* pPacket);
+
+	void OfferSharedMemory(SESSION* pSession);
+	void OnShmReady(SESSION* pSession);
+	void DrainShm(SESSION* pSession);
+	void PostShmSend(SESSION* pSession);
+	void ReleaseShmLink(SESSION* pSession);
+
+	static void CALLBACK OnShmSignaled(PVOID pContext, BOOLEAN timedOut);
+	static void CALLBACK OnResumeTimer(PVOID pContext, BOOLEAN timedOut);
+	static void			 PostResume(RESUME_TIMER* pTimer);
+
+	void	 FreezeSessions();
+	bool	 SerializeSession(SESSION* pSession, DWORD targetProcessId, std::vector<char>& buffer);
+	SESSION* RestoreSession(SOCKET sessionSocket, SESSION_UID sessionUID, const char* pRecvData, int recvSize, const char* pSendData, int sendSize);
 
 private:
-	SOCKET					 m_listenSocket;
-	HANDLE					 m_hIocp;
-	std::vector<std::thread> m_vecWorkerThread;
-	std::vector<std::thread> m_vecSendThread;
-	std::thread				 m_AcceptThread;
-	std::atomic<int>		 m_AtomicCurrentClientCount;
-	std::atomic<int>		 m_AtomicSessionUID;
-	int						 m_MaxClientCnt;
-
-	SESSION* m_SessionArray = nullptr;
-
-	Concurrency::concurrent_queue<int> m_queueSessionIndexArray;
+	SOCKET			 m_listenSocket;
+	LoopbackNetwork* m_pLoopback = nullptr;
+	HANDLE			 m_hIocp;
+	std::atomic<int> m_AtomicCurrentClientCount;
+	std::atomic<int> m_AtomicSessionUID;
+	std::atomic<int> m_MaxClientCnt;
+
+	// workers take the first m_MaxWorkerCnt slots, then the send threads, then the accept thread
+	THREADING_CONFIG		m_Threading;
+	THREAD_SLOT*			m_ThreadSlots = nullptr;
+	int						m_ThreadSlotCnt = 0;
+	THREAD_SLOT*			m_pAcceptSlot = nullptr;
+	int						m_MinWorkerCnt = 0;
+	int						m_MaxWorkerCnt = 0;
+	std::atomic<int>		m_ActiveWorkerCnt;
+	DWORD_PTR				m_NetCoreMask = 0; // 0 when no core is reserved
+	std::thread				m_MonitorThread;
+	OVERLAPPED				m_RetireOverlapped;
+	OVERLAPPED				m_ProbeOverlapped;
+	std::atomic<bool>		m_ProbePending;
+	long long				m_ProbeTick = 0;
+	std::atomic<long long>	m_ProbeDelayTicks;
+	std::atomic<long long>	m_CompletionDelayUs;
+
+	// a segment is published before m_SessionTableSize covers it, lookups take no lock
+	std::atomic<SESSION_SEGMENT*>	   m_SessionSegments[MAX_SESSION_SEGMENT_COUNT];
+	std::atomic<int>				   m_SessionTableSize;
+	std::mutex						   m_SessionTableLock;
+	std::atomic<unsigned long long>	   m_FreeSessionHead; // pop count << 32 | top index + 1, 0 index part when empty
+	int								   m_WarmSessionCnt;
+	int								   m_WarmThreadCnt;
+
 	ThreadLocalMemoryPool<MESSAGE>	 m_MessagePool;
+	ThreadLocalMemoryPool<FRAME_REF> m_FrameRefPool;
+
+	TopicTable m_Topics;
+
+	bool		   m_UseLargePageArena;
+	LargePageArena m_Arena;
+
+	int m_LargeFrameThreshold;
+
+	int		  m_CorkBytes;
+	long long m_CorkDeadlineTicks;
+
+	int								m_ZeroCopyBytes;
+	std::atomic<unsigned long long> m_ZeroCopySendCnt;
+	std::atomic<unsigned long long> m_ZeroCopySendBytes;
+
+	int		   m_RecvBudget;
+	RATE_LIMIT m_RateLimit;
+
+	long long		  m_TickFrequency;
+	SEND_LANE_COUNTER m_SendLaneCounter[(int)SEND_PRIORITY::COUNT];
+
+	std::atomic<bool> m_HandOff;
+	std::atomic<int>  m_PausedSendThreadCnt;
+
+	UdpSocket			   m_UdpSocket;
+	std::atomic<bool>	   m_UdpStarted{ false };
+	std::thread			   m_UdpThread;
+	UdpPeer::ALLOCATE_FUNC m_UdpAllocate;
+	UdpPeer::FREE_FUNC	   m_UdpFree;
+	std::vector<MESSAGE*>  m_vecUdpDelivered;
+
+	bool				  m_UseSharedMemory;
+	bool				  m_UseIntegrity;
+	bool				  m_UseEncryption;
+	SystemPacketProcessor m_SystemPacketProcessor;
+
+	std::unordered_map<int, RPC_HANDLER> m_mapRpcHandlers;
+
+	TrafficCapture m_Capture;
+	MessageTracer  m_Tracer;
 };
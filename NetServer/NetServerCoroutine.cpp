@@ -0,0 +1,104 @@
+#include "NetServerCoroutine.h"
+#include "NetUtil.h"
+
+CoSession::CoSession(CoNetServer* pServer, SESSION_UID sessionUID)
+: m_pServer(pServer)
+, m_SessionUID(sessionUID)
+, m_RefCount(2)
+{
+}
+
+CoSession::~CoSession()
+{
+	MESSAGE* pMessage = nullptr;
+	while ((pMessage = m_Inbox.TakeQueued()) != nullptr)
+		m_pServer->FreeMessage(pMessage);
+}
+
+void CoSession::Release()
+{
+	if (--m_RefCount == 0)
+		delete this;
+}
+
+ReadyAwaiter<bool> CoSession::Send(MESSAGE* pMessage, SEND_PRIORITY priority)
+{
+	return ReadyAwaiter<bool>{ m_pServer->Send(m_SessionUID, pMessage, priority) };
+}
+
+bool CoSession::Disconnect()
+{
+	return m_pServer->Disconnect(m_SessionUID);
+}
+
+MESSAGE* CoSession::AllocateMessage()
+{
+	return m_pServer->AllocateMessage();
+}
+
+void CoSession::FreeMessage(MESSAGE* pMessage)
+{
+	m_pServer->FreeMessage(pMessage);
+}
+
+CoNetServer::CoNetServer(int maxUserCnt)
+: m_vecSession(maxUserCnt, nullptr)
+{
+}
+
+void CoNetServer::OnClientJoin(SESSION_UID sessionUID)
+{
+	const int sessionIndex = NetUtil::GetSessionIndexPart(sessionUID);
+	if (sessionIndex >= (int)m_vecSession.size())
+	{
+		Disconnect(sessionUID);
+		return;
+	}
+
+	CoSession* pSession = new CoSession(this, sessionUID);
+	m_vecSession[sessionIndex] = pSession;
+
+	RunSession(this, pSession);
+}
+
+void CoNetServer::OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage)
+{
+	const int sessionIndex = NetUtil::GetSessionIndexPart(sessionUID);
+	if (sessionIndex >= (int)m_vecSession.size())
+	{
+		FreeMessage(pMessage);
+		return;
+	}
+
+	CoSession* pSession = m_vecSession[sessionIndex];
+	if (pSession == nullptr || pSession->m_SessionUID != sessionUID)
+	{
+		FreeMessage(pMessage);
+		return;
+	}
+
+	pSession->m_Inbox.Deliver(pMessage);
+}
+
+void CoNetServer::OnClientLeave(SESSION_UID sessionUID)
+{
+	const int sessionIndex = NetUtil::GetSessionIndexPart(sessionUID);
+	if (sessionIndex >= (int)m_vecSession.size())
+		return;
+
+	CoSession* pSession = m_vecSession[sessionIndex];
+	if (pSession == nullptr || pSession->m_SessionUID != sessionUID)
+		return;
+
+	m_vecSession[sessionIndex] = nullptr;
+
+	pSession->m_Inbox.Close();
+	pSession->Release();
+}
+
+NetTask CoNetServer::RunSession(CoNetServer* pServer, CoSession* pSession)
+{
+	co_await pServer->OnSession(*pSession);
+
+	pSession->Release();
+}
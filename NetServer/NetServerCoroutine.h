@@ -0,0 +1,58 @@
+#pragma once
+#include "NetServer.h"
+#include "Coroutine.h"
+
+class CoNetServer;
+
+// outlives the connection until the handler has returned
+class CoSession
+{
+	friend class CoNetServer;
+
+public:
+	SESSION_UID GetSessionUID() const { return m_SessionUID; }
+
+	// nullptr once the client is gone
+	MessageInbox::RecvAwaiter Recv() { return m_Inbox.Recv(); }
+	ReadyAwaiter<bool>		  Send(MESSAGE* pMessage, SEND_PRIORITY priority = SEND_PRIORITY::BULK);
+	bool					  Disconnect();
+
+	MESSAGE* AllocateMessage();
+	void	 FreeMessage(MESSAGE* pMessage);
+
+private:
+	CoSession(CoNetServer* pServer, SESSION_UID sessionUID);
+	~CoSession();
+
+	void Release();
+
+private:
+	CoNetServer*	 m_pServer;
+	SESSION_UID		 m_SessionUID;
+	MessageInbox	 m_Inbox;
+	std::atomic<int> m_RefCount;
+};
+
+// one coroutine per connection in place of the join, recv and leave callbacks
+class CoNetServer : public NetServer
+{
+	friend class CoSession;
+
+public:
+	// maxUserCnt must be the one given to Start
+	explicit CoNetServer(int maxUserCnt);
+
+protected:
+	virtual CoTask OnSession(CoSession& session) = 0;
+
+private:
+	void OnClientJoin(SESSION_UID sessionUID);
+	void OnRecv(SESSION_UID sessionUID, MESSAGE* pMessage);
+	void OnClientLeave(SESSION_UID sessionUID);
+
+	static NetTask RunSession(CoNetServer* pServer, CoSession* pSession);
+
+private:
+	// join, recv and leave of one session never overlap
+	std::vector<CoSession*> m_vecSession;
+};
@@ -0,0 +1,70 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+#include "SystemPacket.h"
+
+// unauthenticated ephemeral X25519, it stops passive capture only.
+// everything queued behind CryptoSwitch is encrypted
+void NetServer::OfferEncryption(SESSION* pSession)
+{
+	if (!m_UseEncryption)
+		return;
+
+	SystemPacket_CryptoOffer packet;
+	if (!X25519GenerateKeyPair(pSession->cryptoPrivateKey, packet.m_PublicKey))
+	{
+		NetUtil::PrintError(GetLastError(), __LINE__);
+		return;
+	}
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	pSession->cryptoPending = true;
+
+	Send(pSession->sessionUID, pMessage);
+}
+
+void NetServer::OnCryptoReady(SESSION* pSession, SystemPacketHeader* pPacket)
+{
+	if (!pSession->cryptoPending)
+		return;
+
+	pSession->cryptoPending = false;
+
+	SystemPacket_CryptoReady* pReady = static_cast<SystemPacket_CryptoReady*>(pPacket);
+
+	unsigned char sharedSecret[X25519_KEY_SIZE];
+	bool		  agreed = X25519SharedSecret(pSession->cryptoPrivateKey, pReady->m_PublicKey, sharedSecret);
+	SecureZeroMemory(pSession->cryptoPrivateKey, sizeof(pSession->cryptoPrivateKey));
+
+	if (!agreed)
+	{
+		ShutdownSession(pSession);
+		return;
+	}
+
+	DeriveSessionKeys(sharedSecret, pSession->recvCrypto.key, pSession->sendCrypto.key);
+	SecureZeroMemory(sharedSecret, sizeof(sharedSecret));
+
+	pSession->recvCrypto.counter = 0;
+	pSession->sendCrypto.counter = 0;
+	pSession->decryptRecv = true;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_CryptoSwitch packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	// set before the push
+	pSession->pCryptoSwitchMessage = pMessage;
+	PushSend(pSession, pMessage, SEND_PRIORITY::BULK);
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(pSession->sessionUID));
+}
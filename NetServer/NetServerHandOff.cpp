@@ -0,0 +1,439 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+#include "OwnerSecurity.h"
+
+#include <cstring>
+
+namespace
+{
+struct HANDOFF_HEADER
+{
+	int				  sessionCount;
+	int				  sessionUIDCounter;
+	WSAPROTOCOL_INFOA listenSocketInfo;
+};
+
+// followed by recvSize bytes of unframed stream data and sendSize bytes of queued frames
+struct HANDOFF_SESSION
+{
+	SESSION_UID		  sessionUID;
+	WSAPROTOCOL_INFOA socketInfo;
+	int				  recvSize;
+	int				  sendSize;
+	bool			  integrityRecv;
+	bool			  integritySend;
+	bool			  decryptRecv;
+	bool			  encryptSend;
+	AEAD_STATE		  recvCrypto;
+	AEAD_STATE		  sendCrypto;
+};
+
+bool WritePipe(HANDLE hPipe, const void* pData, size_t size)
+{
+	const char* pCursor = static_cast<const char*>(pData);
+	while (size > 0)
+	{
+		DWORD written = 0;
+		if (!WriteFile(hPipe, pCursor, (DWORD)size, &written, nullptr))
+			return false;
+
+		pCursor += written;
+		size -= written;
+	}
+	return true;
+}
+
+bool ReadPipe(HANDLE hPipe, void* pBuffer, size_t size)
+{
+	char* pCursor = static_cast<char*>(pBuffer);
+	while (size > 0)
+	{
+		DWORD read = 0;
+		if (!ReadFile(hPipe, pCursor, (DWORD)size, &read, nullptr) || read == 0)
+			return false;
+
+		pCursor += read;
+		size -= read;
+	}
+	return true;
+}
+
+// the successor can only attach a socket once this process dropped its binding (Windows 8.1+)
+bool DetachCompletionPort(SOCKET sessionSocket)
+{
+	struct COMPLETION_INFO
+	{
+		HANDLE Port;
+		PVOID  Key;
+	};
+
+	struct IO_STATUS
+	{
+		LONG_PTR  Status;
+		ULONG_PTR Information;
+	};
+
+	using NtSetInformationFileFunc = LONG(NTAPI*)(HANDLE, IO_STATUS*, PVOID, ULONG, int);
+	constexpr int FILE_REPLACE_COMPLETION_INFORMATION = 61;
+
+	static NtSetInformationFileFunc pNtSetInformationFile =
+		(NtSetInformationFileFunc)GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtSetInformationFile");
+	if (pNtSetInformationFile == nullptr)
+		return false;
+
+	COMPLETION_INFO info = { nullptr, nullptr };
+	IO_STATUS		status;
+	return pNtSetInformationFile((HANDLE)sessionSocket, &status, &info, sizeof(info), FILE_REPLACE_COMPLETION_INFORMATION) >= 0;
+}
+
+// same account, same executable file name
+bool IsSuccessor(DWORD processId)
+{
+	if (!OwnerSecurity::IsOwnerProcess(processId))
+		return false;
+
+	char ownPath[MAX_PATH];
+	if (GetModuleFileNameA(nullptr, ownPath, MAX_PATH) == 0)
+		return false;
+
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+	if (hProcess == nullptr)
+		return false;
+
+	char  peerPath[MAX_PATH];
+	DWORD peerPathSize = MAX_PATH;
+	bool  result = QueryFullProcessImageNameA(hProcess, 0, peerPath, &peerPathSize) != FALSE;
+	CloseHandle(hProcess);
+
+	const char* pOwnName = std::strrchr(ownPath, '\\');
+	const char* pPeerName = std::strrchr(peerPath, '\\');
+	return result && _stricmp(pOwnName != nullptr ? pOwnName + 1 : ownPath, pPeerName != nullptr ? pPeerName + 1 : peerPath) == 0;
+}
+} // namespace
+
+bool NetServer::WaitHandOff(const char* pipeName)
+{
+	if (m_pLoopback != nullptr)
+		return false;
+
+	OwnerSecurity security;
+	if (!security.Initialize())
+	{
+		NetUtil::PrintError(GetLastError(), __LINE__);
+		return false;
+	}
+
+	HANDLE hPipe = CreateNamedPipeA(pipeName, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 64 * 1024, 64 * 1024, 0, security.Get());
+	if (hPipe == INVALID_HANDLE_VALUE)
+	{
+		NetUtil::PrintError(GetLastError(), __LINE__);
+		return false;
+	}
+
+	// nothing is written before the client is verified
+	ULONG targetProcessId = 0;
+	while (true)
+	{
+		if (!ConnectNamedPipe(hPipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+		{
+			CloseHandle(hPipe);
+			return false;
+		}
+
+		if (GetNamedPipeClientProcessId(hPipe, &targetProcessId) && IsSuccessor(targetProcessId))
+			break;
+
+		NetUtil::PrintError(ERROR_ACCESS_DENIED, __LINE__);
+		DisconnectNamedPipe(hPipe);
+	}
+
+	HANDOFF_HEADER header;
+	ZeroMemory(&header, sizeof(header));
+	if (WSADuplicateSocketA(m_listenSocket, targetProcessId, &header.listenSocketInfo) == SOCKET_ERROR)
+	{
+		NetUtil::PrintError(WSAGetLastError(), __LINE__);
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	m_HandOff = true;
+
+	closesocket(m_listenSocket);
+	m_pAcceptSlot->thread.join();
+
+	while (m_PausedSendThreadCnt < m_Threading.sendThreadCnt)
+		Sleep(1);
+
+	FreezeSessions();
+
+	std::vector<char>	  buffer;
+	std::vector<SESSION*> vecHandOffSession;
+	const int			  tableSize = m_SessionTableSize;
+	for (int idx = 0; idx < tableSize; ++idx)
+	{
+		SESSION* pSession = GetSession(idx);
+		if (pSession->IsReleased())
+			continue;
+
+		if (!SerializeSession(pSession, targetProcessId, buffer))
+		{
+			NetUtil::PrintError(WSAGetLastError(), __LINE__);
+			ReleaseSession(pSession);
+			continue;
+		}
+
+		vecHandOffSession.push_back(pSession);
+	}
+
+	header.sessionCount = (int)vecHandOffSession.size();
+	header.sessionUIDCounter = m_AtomicSessionUID;
+
+	if (!WritePipe(hPipe, &header, sizeof(header)) || !WritePipe(hPipe, buffer.data(), buffer.size()))
+	{
+		NetUtil::PrintError(GetLastError(), __LINE__);
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	// open until the successor has its copies
+	char ack = 0;
+	ReadPipe(hPipe, &ack, sizeof(ack));
+	CloseHandle(hPipe);
+
+	for (SESSION* pSession : vecHandOffSession)
+	{
+		pSession->MarkReleased();
+		closesocket(pSession->sessionSocket);
+	}
+
+	return true;
+}
+
+bool NetServer::StartFromHandOff(const char* pipeName, int workerThreadCnt, int maxUserCnt)
+{
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+
+	HANDLE hPipe = CreateFileA(pipeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (hPipe == INVALID_HANDLE_VALUE)
+		return false;
+
+	HANDOFF_HEADER header;
+	if (!ReadPipe(hPipe, &header, sizeof(header)))
+	{
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	m_listenSocket = WSASocketA(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, &header.listenSocketInfo, 0, 0);
+	if (m_listenSocket == INVALID_SOCKET)
+	{
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	m_hIocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, GetMaxWorkerCount(workerThreadCnt));
+	if (m_hIocp == NULL || !InitSessionTable(maxUserCnt, false))
+	{
+		CloseHandle(hPipe);
+		return false;
+	}
+
+	std::vector<SESSION*> vecRestoredSession;
+	std::vector<bool>	  vecUsedIndex(m_MaxClientCnt, false);
+	std::vector<char>	  buffer;
+	for (int i = 0; i < header.sessionCount; ++i)
+	{
+		HANDOFF_SESSION record;
+		if (!ReadPipe(hPipe, &record, sizeof(record)))
+			break;
+
+		buffer.resize(record.recvSize + record.sendSize);
+		if (!ReadPipe(hPipe, buffer.data(), buffer.size()))
+			break;
+
+		SOCKET sessionSocket = WSASocketA(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, &record.socketInfo, 0, WSA_FLAG_OVERLAPPED);
+		if (sessionSocket == INVALID_SOCKET)
+			continue;
+
+		int sessionIdx = NetUtil::GetSessionIndexPart(record.sessionUID);
+		if (sessionIdx >= m_MaxClientCnt || vecUsedIndex[sessionIdx] || !GrowSessionTable(sessionIdx + 1, 1, false))
+		{
+			closesocket(sessionSocket);
+			continue;
+		}
+
+		SESSION* pSession = RestoreSession(sessionSocket, record.sessionUID, buffer.data(), record.recvSize, buffer.data() + record.recvSize, record.sendSize);
+		if (pSession == nullptr)
+		{
+			closesocket(sessionSocket);
+			continue;
+		}
+
+		pSession->integrityRecv = record.integrityRecv;
+		pSession->integritySend = record.integritySend;
+		pSession->decryptRecv = record.decryptRecv;
+		pSession->encryptSend = record.encryptSend;
+		pSession->recvCrypto = record.recvCrypto;
+		pSession->sendCrypto = record.sendCrypto;
+		SecureZeroMemory(&record, sizeof(record));
+
+		vecUsedIndex[sessionIdx] = true;
+		vecRestoredSession.push_back(pSession);
+	}
+
+	char ack = 1;
+	WritePipe(hPipe, &ack, sizeof(ack));
+	CloseHandle(hPipe);
+
+	m_AtomicSessionUID = header.sessionUIDCounter;
+
+	for (int sessionIndex = m_SessionTableSize - 1; sessionIndex >= 0; --sessionIndex)
+	{
+		if (sessionIndex >= (int)vecUsedIndex.size() || !vecUsedIndex[sessionIndex])
+			PushFreeSession(sessionIndex);
+	}
+
+	CreateThreads(workerThreadCnt);
+
+	// RestoreSession left each session holding its first reference
+	for (SESSION* pSession : vecRestoredSession)
+	{
+		BindUdpPeer(pSession);
+
+		OnClientJoin(pSession->sessionUID);
+
+		AfterRecvProcess(pSession, 0);
+
+		UnlockPrevent(pSession);
+	}
+
+	return true;
+}
+
+void NetServer::FreezeSessions()
+{
+	// sends finish, cancelling would lose how much reached the peer. recvs are cancelled
+	while (true)
+	{
+		bool	  busy = false;
+		const int tableSize = m_SessionTableSize;
+		for (int idx = 0; idx < tableSize; ++idx)
+		{
+			SESSION* pSession = GetSession(idx);
+			if (pSession->IsReleased() || pSession->GetIoCount() == 0)
+				continue;
+
+			busy = true;
+			CancelIoEx((HANDLE)pSession->sessionSocket, &pSession->recvOverlapped);
+		}
+
+		if (!busy)
+			break;
+
+		Sleep(1);
+	}
+}
+
+bool NetServer::SerializeSession(SESSION* pSession, DWORD targetProcessId, std::vector<char>& buffer)
+{
+	// the rings don't survive the process
+	if (pSession->pShmLink != nullptr)
+		return false;
+
+	// switch markers and pending handshakes aren't carried over
+	if (pSession->pIntegritySwitchMessage != nullptr || pSession->pCryptoSwitchMessage != nullptr || pSession->cryptoPending)
+		return false;
+
+	if (!DetachCompletionPort(pSession->sessionSocket))
+		return false;
+
+	HANDOFF_SESSION record;
+	ZeroMemory(&record, sizeof(record));
+	record.sessionUID = pSession->sessionUID;
+	record.integrityRecv = pSession->integrityRecv;
+	record.integritySend = pSession->integritySend;
+	record.decryptRecv = pSession->decryptRecv;
+	record.encryptSend = pSession->encryptSend;
+	record.recvCrypto = pSession->recvCrypto;
+	record.sendCrypto = pSession->sendCrypto;
+	if (WSADuplicateSocketA(pSession->sessionSocket, targetProcessId, &record.socketInfo) == SOCKET_ERROR)
+		return false;
+
+	size_t recordOffset = buffer.size();
+	buffer.resize(recordOffset + sizeof(record));
+
+	if (pSession->pLargeMessage != nullptr)
+	{
+		const char* pData = (const char*)pSession->pLargeMessage;
+		buffer.insert(buffer.end(), pData, pData + pSession->largeReceivedSize);
+		record.recvSize = pSession->largeReceivedSize;
+	}
+	else
+	{
+		RingBuffer& recvQ = pSession->recvQ;
+		record.recvSize = (int)recvQ.size_in_use();
+		buffer.resize(buffer.size() + record.recvSize);
+		recvQ.peek(buffer.data() + buffer.size() - record.recvSize, record.recvSize);
+	}
+
+	// in PostSend's order, all as bulk. subscriptions aren't handed over
+	MESSAGE* pMessage = nullptr;
+	while ((pMessage = PopQueuedSend(pSession)) != nullptr || (pMessage = PopSharedCopy(pSession)) != nullptr)
+	{
+		const char* pData = (const char*)pMessage;
+		const int	frameSize = sizeof(pMessage->header) + pMessage->header.length;
+		buffer.insert(buffer.end(), pData, pData + frameSize);
+		record.sendSize += frameSize;
+
+		FreeMessage(pMessage);
+	}
+
+	std::memcpy(buffer.data() + recordOffset, &record, sizeof(record));
+	return true;
+}
+
+SESSION* NetServer::RestoreSession(SOCKET sessionSocket, SESSION_UID sessionUID, const char* pRecvData, int recvSize, const char* pSendData, int sendSize)
+{
+	int		 sessionIdx = NetUtil::GetSessionIndexPart(sessionUID);
+	SESSION* pSession = GetSession(sessionIdx);
+
+	if (CreateIoCompletionPort((HANDLE)sessionSocket, m_hIocp, (ULONG_PTR)pSession, NULL) == NULL)
+		return nullptr;
+
+	pSession->Reset();
+
+	if (!pSession->recvQ.put(pRecvData, recvSize))
+		return nullptr;
+
+	for (int offset = 0; offset < sendSize;)
+	{
+		HEADER header;
+		std::memcpy(&header, pSendData + offset, sizeof(header));
+
+		const int frameSize = sizeof(header) + header.length;
+
+		MESSAGE* pMessage = AllocateMessage();
+		if (pMessage == nullptr)
+			break;
+
+		std::memcpy((char*)pMessage, pSendData + offset, frameSize);
+		PushSend(pSession, pMessage, SEND_PRIORITY::BULK);
+
+		offset += frameSize;
+	}
+
+	pSession->sessionSocket = sessionSocket;
+	pSession->sessionUID = sessionUID;
+	pSession->Activate(sessionUID);
+
+	ResetRateLimit(pSession);
+
+	++m_AtomicCurrentClientCount;
+
+	if (pSession->HasQueuedSend())
+		MarkSendReady(sessionIdx);
+
+	return pSession;
+}
@@ -0,0 +1,97 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+
+bool NetServer::StartLoopback(LoopbackNetwork* pNetwork, int workerThreadCnt, int maxUserCnt)
+{
+	if (pNetwork == nullptr)
+		return false;
+
+	m_pLoopback = pNetwork;
+	m_listenSocket = INVALID_SOCKET;
+
+	m_hIocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, GetMaxWorkerCount(workerThreadCnt));
+	if (m_hIocp == NULL)
+		return false;
+
+	if (!InitSessionTable(maxUserCnt, true))
+		return false;
+
+	CreateThreads(workerThreadCnt);
+
+	return true;
+}
+
+void NetServer::LoopbackAcceptThread(THREAD_SLOT* pSlot)
+{
+	PinThread(pSlot->core);
+
+	while (true)
+	{
+		LoopbackPipe* pPipe = m_pLoopback->Accept();
+		if (pPipe == nullptr)
+			break;
+
+		if (m_AtomicCurrentClientCount >= m_MaxClientCnt)
+		{
+			pPipe->Close();
+			continue;
+		}
+
+		char clientIP[] = "127.0.0.1";
+		if (!OnConnectionRequest(clientIP, 0))
+		{
+			pPipe->Close();
+			continue;
+		}
+
+		int sessionIdx;
+		if (!PopFreeSession(sessionIdx))
+		{
+			pPipe->Close();
+			continue;
+		}
+
+		SESSION* pSession = GetSession(sessionIdx);
+		pPipe->Attach(m_hIocp, (ULONG_PTR)pSession);
+
+		++m_AtomicCurrentClientCount;
+
+		JoinSession(pSession, sessionIdx, INVALID_SOCKET, pPipe);
+	}
+
+	pSlot->running = false;
+}
+
+int NetServer::PostSessionRecv(SESSION* pSession, WSABUF* pBufs, int bufCount)
+{
+	if (pSession->pLoopback != nullptr)
+		return pSession->pLoopback->Recv(pBufs, bufCount, &pSession->recvOverlapped);
+
+	DWORD flags = 0;
+	return WSARecv(pSession->sessionSocket, pBufs, bufCount, nullptr, &flags, &pSession->recvOverlapped, nullptr);
+}
+
+int NetServer::PostSessionSend(SESSION* pSession, WSABUF* pBufs, int bufCount)
+{
+	if (pSession->pLoopback != nullptr)
+		return pSession->pLoopback->Send(pBufs, bufCount, &pSession->sendOverlapped);
+
+	DWORD flags = 0;
+	return WSASend(pSession->sessionSocket, pBufs, bufCount, nullptr, flags, &pSession->sendOverlapped, nullptr);
+}
+
+void NetServer::ShutdownSession(SESSION* pSession)
+{
+	if (pSession->pLoopback != nullptr)
+		pSession->pLoopback->Shutdown();
+	else
+		shutdown(pSession->sessionSocket, SD_BOTH);
+}
+
+void NetServer::CloseSession(SESSION* pSession)
+{
+	if (pSession->pLoopback != nullptr)
+		pSession->pLoopback->Close();
+	else
+		closesocket(pSession->sessionSocket);
+}
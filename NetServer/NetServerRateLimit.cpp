@@ -0,0 +1,95 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+
+#include <algorithm>
+
+void NetServer::ResumeRecv(SESSION* pSession, DWORD delayMs)
+{
+	ScheduleResume(pSession, pSession->resumeTimer, &pSession->resumeOverlapped, delayMs);
+}
+
+// the worker drops the reference taken here
+void NetServer::ScheduleResume(SESSION* pSession, RESUME_TIMER& timer, OVERLAPPED* pOverlapped, DWORD delayMs)
+{
+	if (!PreventRelease(pSession))
+		return;
+
+	pOverlapped->Internal = 0;
+
+	if (delayMs > 0)
+	{
+		timer.pServer = this;
+		timer.pSession = pSession;
+		timer.pOverlapped = pOverlapped;
+		timer.pending = 2;
+
+		if (CreateTimerQueueTimer(&timer.hTimer, nullptr, OnResumeTimer, &timer, delayMs, 0, WT_EXECUTEONLYONCE | WT_EXECUTEINTIMERTHREAD))
+		{
+			PostResume(&timer);
+			return;
+		}
+
+		timer.hTimer = nullptr;
+		NetUtil::PrintError(GetLastError(), __LINE__);
+	}
+
+	// 0 bytes would read as a closed connection
+	PostQueuedCompletionStatus(m_hIocp, 1, (ULONG_PTR)pSession, pOverlapped);
+}
+
+void CALLBACK NetServer::OnResumeTimer(PVOID pContext, BOOLEAN timedOut)
+{
+	PostResume(static_cast<RESUME_TIMER*>(pContext));
+}
+
+// nothing touches the timer after the post
+void NetServer::PostResume(RESUME_TIMER* pTimer)
+{
+	if (pTimer->pending.fetch_sub(1) != 1)
+		return;
+
+	PostQueuedCompletionStatus(pTimer->pServer->m_hIocp, 1, (ULONG_PTR)pTimer->pSession, pTimer->pOverlapped);
+}
+
+void NetServer::DeleteResumeTimer(RESUME_TIMER& timer)
+{
+	if (timer.hTimer == nullptr)
+		return;
+
+	DeleteTimerQueueTimer(nullptr, timer.hTimer, nullptr);
+	timer.hTimer = nullptr;
+}
+
+void NetServer::ResetRateLimit(SESSION* pSession)
+{
+	ULONGLONG now = GetTickCount64();
+	pSession->messageBucket.Reset(m_RateLimit.messagesPerSecond, m_RateLimit.messageBurst, now);
+	pSession->byteBucket.Reset(m_RateLimit.bytesPerSecond, m_RateLimit.byteBurst, now);
+}
+
+// false means stop reading, the session was scheduled to resume or shut down
+bool NetServer::AdmitFrame(SESSION* pSession, int frameSize, RESUME_TIMER& timer, OVERLAPPED* pResumeOverlapped)
+{
+	TokenBucket& messageBucket = pSession->messageBucket;
+	TokenBucket& byteBucket = pSession->byteBucket;
+	if (!messageBucket.IsEnabled() && !byteBucket.IsEnabled())
+		return true;
+
+	ULONGLONG now = GetTickCount64();
+	DWORD	  waitMs = (std::max)(messageBucket.GetWait(1, now), byteBucket.GetWait(frameSize, now));
+	if (waitMs == 0)
+	{
+		messageBucket.Take(1);
+		byteBucket.Take(frameSize);
+		return true;
+	}
+
+	if (m_RateLimit.policy == RATE_LIMIT_POLICY::DISCONNECT)
+	{
+		ShutdownSession(pSession);
+		return false;
+	}
+
+	ScheduleResume(pSession, timer, pResumeOverlapped, waitMs);
+	return false;
+}
@@ -0,0 +1,50 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+#include "SystemPacket.h"
+
+bool NetServer::RegisterRpc(int method, RPC_HANDLER handler)
+{
+	return m_mapRpcHandlers.emplace(method, std::move(handler)).second;
+}
+
+bool NetServer::Reply(SESSION_UID sessionUID, RPC_CALL_ID callId, const void* pBody, int bodySize, RPC_STATUS status)
+{
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return false;
+
+	SystemPacket_RpcResponse packet;
+	packet.m_CallId = callId;
+	packet.m_Status = status;
+	packet.SetSize(sizeof(packet) + bodySize);
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	if (!pMessage->put(&packet, sizeof(packet)) || (bodySize > 0 && !pMessage->put(pBody, bodySize)))
+	{
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	return Send(sessionUID, pMessage);
+}
+
+void NetServer::OnRpcRequest(SESSION* pSession, SystemPacketHeader* pPacket)
+{
+	SystemPacket_RpcRequest* pRequest = static_cast<SystemPacket_RpcRequest*>(pPacket);
+
+	const int bodySize = pRequest->GetSize() - (int)sizeof(SystemPacket_RpcRequest);
+	if (bodySize < 0)
+	{
+		NetUtil::PrintError(ERROR_INVALID_DATA, __LINE__);
+		return;
+	}
+
+	auto iter = m_mapRpcHandlers.find(pRequest->m_Method);
+	if (iter == m_mapRpcHandlers.end())
+	{
+		Reply(pSession->sessionUID, pRequest->m_CallId, nullptr, 0, RPC_STATUS::NO_METHOD);
+		return;
+	}
+
+	iter->second(pSession->sessionUID, pRequest->m_CallId, (const char*)(pRequest + 1), bodySize);
+}
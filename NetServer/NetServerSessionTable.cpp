@@ -0,0 +1,211 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+
+#include <malloc.h>
+
+static constexpr unsigned long long FREE_INDEX_MASK = 0xFFFFFFFFULL;
+
+// pushFree false is for a successor that restores sessions at their own indices first
+bool NetServer::InitSessionTable(int maxUserCnt, bool pushFree)
+{
+	m_MaxClientCnt = (std::min)(maxUserCnt, MAX_SESSION_COUNT);
+
+	if (m_UseLargePageArena)
+	{
+		m_Arena.Initialize();
+
+		m_MessagePool.SetArena(&m_Arena);
+	}
+
+	const int warmSessionCnt = (std::min)(m_WarmSessionCnt, (int)m_MaxClientCnt);
+	if (warmSessionCnt <= 0)
+		return true;
+
+	return GrowSessionTable(warmSessionCnt, m_WarmThreadCnt, pushFree);
+}
+
+// segments are built in parallel, then published in order
+bool NetServer::GrowSessionTable(int sessionCnt, int threadCnt, bool pushFree)
+{
+	std::lock_guard<std::mutex> lock(m_SessionTableLock);
+
+	const int firstSegment = m_SessionTableSize / SESSION_SEGMENT_SIZE;
+	const int lastSegment = (std::min)((sessionCnt + SESSION_SEGMENT_SIZE - 1) / SESSION_SEGMENT_SIZE, MAX_SESSION_SEGMENT_COUNT);
+	if (firstSegment >= lastSegment)
+		return sessionCnt <= m_SessionTableSize;
+
+	const int						segmentCnt = lastSegment - firstSegment;
+	std::vector<SESSION_SEGMENT*> vecSegment(segmentCnt, nullptr);
+
+	threadCnt = (std::max)((std::min)(threadCnt, segmentCnt), 1);
+	if (threadCnt == 1)
+	{
+		for (int i = 0; i < segmentCnt; ++i)
+			vecSegment[i] = CreateSessionSegment();
+	}
+	else
+	{
+		std::vector<std::thread> vecThread;
+		for (int t = 0; t < threadCnt; ++t)
+		{
+			vecThread.emplace_back([this, &vecSegment, segmentCnt, threadCnt, t]() {
+				for (int i = t; i < segmentCnt; i += threadCnt)
+					vecSegment[i] = CreateSessionSegment();
+			});
+		}
+
+		for (std::thread& thread : vecThread)
+			thread.join();
+	}
+
+	// all or nothing
+	for (int i = 0; i < segmentCnt; ++i)
+	{
+		if (vecSegment[i] != nullptr)
+			continue;
+
+		for (SESSION_SEGMENT* pSegment : vecSegment)
+			DestroySessionSegment(pSegment);
+
+		NetUtil::PrintError(ERROR_NOT_ENOUGH_MEMORY, __LINE__);
+		return false;
+	}
+
+	for (int i = 0; i < segmentCnt; ++i)
+	{
+		SESSION_SEGMENT* pSegment = vecSegment[i];
+
+		const int segment = firstSegment + i;
+		m_SessionSegments[segment].store(pSegment, std::memory_order_release);
+		m_SessionTableSize.store((segment + 1) * SESSION_SEGMENT_SIZE, std::memory_order_release);
+
+		if (!pushFree)
+			continue;
+
+		for (int sessionIdx = (segment + 1) * SESSION_SEGMENT_SIZE - 1; sessionIdx >= segment * SESSION_SEGMENT_SIZE; --sessionIdx)
+			PushFreeSession(sessionIdx);
+	}
+
+	return true;
+}
+
+SESSION_SEGMENT* NetServer::CreateSessionSegment()
+{
+	SESSION_SEGMENT* pSegment = new (std::nothrow) SESSION_SEGMENT;
+	if (pSegment == nullptr)
+		return nullptr;
+
+	for (std::atomic<char>& sendReady : pSegment->sendReady)
+		sendReady = 0;
+
+	pSegment->pSessions = nullptr;
+	pSegment->pUdpPeers = nullptr;
+	if (m_UdpStarted)
+	{
+		pSegment->pUdpPeers = new (std::nothrow) UdpPeer[SESSION_SEGMENT_SIZE];
+		if (pSegment->pUdpPeers == nullptr)
+		{
+			DestroySessionSegment(pSegment);
+			return nullptr;
+		}
+	}
+
+	// SESSION is cache line aligned
+	if (!m_UseLargePageArena)
+	{
+		void* pSessionMemory = _aligned_malloc(sizeof(SESSION) * SESSION_SEGMENT_SIZE, CACHE_LINE_SIZE);
+		if (pSessionMemory == nullptr)
+		{
+			DestroySessionSegment(pSegment);
+			return nullptr;
+		}
+
+		pSegment->pSessions = static_cast<SESSION*>(pSessionMemory);
+		for (int i = 0; i < SESSION_SEGMENT_SIZE; ++i)
+			new (&pSegment->pSessions[i]) SESSION;
+
+		return pSegment;
+	}
+
+	void* pSessionMemory = m_Arena.Carve(sizeof(SESSION) * SESSION_SEGMENT_SIZE, CACHE_LINE_SIZE);
+	char* pRecvMemory = static_cast<char*>(m_Arena.Carve((size_t)RINGBUFFER_SIZE * SESSION_SEGMENT_SIZE, CACHE_LINE_SIZE));
+	if (pSessionMemory == nullptr || pRecvMemory == nullptr)
+	{
+		// carved blocks stay with the arena
+		DestroySessionSegment(pSegment);
+		return nullptr;
+	}
+
+	pSegment->pSessions = static_cast<SESSION*>(pSessionMemory);
+	for (int i = 0; i < SESSION_SEGMENT_SIZE; ++i)
+		new (&pSegment->pSessions[i]) SESSION(pRecvMemory + (size_t)RINGBUFFER_SIZE * i);
+
+	return pSegment;
+}
+
+// only for a segment that was never published
+void NetServer::DestroySessionSegment(SESSION_SEGMENT* pSegment)
+{
+	if (pSegment == nullptr)
+		return;
+
+	if (pSegment->pSessions != nullptr)
+	{
+		for (int i = 0; i < SESSION_SEGMENT_SIZE; ++i)
+			pSegment->pSessions[i].~SESSION();
+
+		if (!m_UseLargePageArena)
+			_aligned_free(pSegment->pSessions);
+	}
+
+	delete[] pSegment->pUdpPeers;
+	delete pSegment;
+}
+
+// the pop count in the head defeats ABA
+void NetServer::PushFreeSession(int sessionIdx)
+{
+	SESSION* pSession = GetSession(sessionIdx);
+
+	unsigned long long head = m_FreeSessionHead.load(std::memory_order_relaxed);
+	unsigned long long newHead;
+	do
+	{
+		pSession->nextFreeIndex.store((int)(head & FREE_INDEX_MASK) - 1, std::memory_order_relaxed);
+		newHead = (head & ~FREE_INDEX_MASK) | (unsigned long long)(sessionIdx + 1);
+	} while (!m_FreeSessionHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool NetServer::PopFreeSession(int& sessionIdx)
+{
+	unsigned long long head = m_FreeSessionHead.load(std::memory_order_acquire);
+	while (true)
+	{
+		const int topIdx = (int)(head & FREE_INDEX_MASK) - 1;
+		if (topIdx < 0)
+		{
+			const int tableSize = m_SessionTableSize;
+			if (tableSize >= m_MaxClientCnt || !GrowSessionTable(tableSize + 1, 1, true))
+				return false;
+
+			head = m_FreeSessionHead.load(std::memory_order_acquire);
+			continue;
+		}
+
+		const int				 nextIdx = GetSession(topIdx)->nextFreeIndex.load(std::memory_order_relaxed);
+		const unsigned long long newHead = (((head >> 32) + 1) << 32) | (unsigned long long)(nextIdx + 1);
+		if (m_FreeSessionHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			sessionIdx = topIdx;
+			return true;
+		}
+	}
+}
+
+UdpPeer* NetServer::GetUdpPeer(int sessionIdx)
+{
+	if (!m_UdpStarted)
+		return nullptr;
+
+	return &m_SessionSegments[sessionIdx >> SESSION_SEGMENT_SHIFT].load(std::memory_order_acquire)->pUdpPeers[sessionIdx & (SESSION_SEGMENT_SIZE - 1)];
+}
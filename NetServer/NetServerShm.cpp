@@ -0,0 +1,241 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+#include "SystemPacket.h"
+
+#include <bcrypt.h>
+#include <cstdio>
+
+namespace
+{
+// loopback, or a client that connected to one of our own addresses
+bool IsSameHost(SOCKET sessionSocket)
+{
+	SOCKADDR_IN localAddr;
+	SOCKADDR_IN peerAddr;
+	int			localSize = sizeof(localAddr);
+	int			peerSize = sizeof(peerAddr);
+	if (getsockname(sessionSocket, (SOCKADDR*)&localAddr, &localSize) == SOCKET_ERROR || getpeername(sessionSocket, (SOCKADDR*)&peerAddr, &peerSize) == SOCKET_ERROR)
+		return false;
+
+	if ((ntohl(peerAddr.sin_addr.s_addr) >> 24) == 127)
+		return true;
+
+	return localAddr.sin_addr.s_addr == peerAddr.sin_addr.s_addr;
+}
+
+// unguessable, so the name can't be squatted on
+bool MakeShmName(char* pName, size_t nameSize)
+{
+	unsigned char nameKey[16];
+	if (BCryptGenRandom(nullptr, nameKey, sizeof(nameKey), BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0)
+		return false;
+
+	int length = std::snprintf(pName, nameSize, "Local\\NetServerShm_");
+	for (unsigned char byte : nameKey)
+		length += std::snprintf(pName + length, nameSize - length, "%02x", byte);
+
+	return true;
+}
+} // namespace
+
+// ShmReady / ShmSwitch are the last TCP frames each way, the receiver reads the ring after them
+void NetServer::OfferSharedMemory(SESSION* pSession)
+{
+	if (!m_UseSharedMemory || pSession->pLoopback != nullptr || !IsSameHost(pSession->sessionSocket))
+		return;
+
+	SystemPacket_ShmOffer packet;
+	if (!MakeShmName(packet.m_Name, sizeof(packet.m_Name)))
+		return;
+
+	SHM_LINK* pShmLink = new (std::nothrow) SHM_LINK;
+	if (pShmLink == nullptr)
+		return;
+
+	if (!pShmLink->channel.Create(packet.m_Name, SHM_RING_SIZE))
+	{
+		delete pShmLink;
+		return;
+	}
+
+	pShmLink->pServer = this;
+	pShmLink->pSession = pSession;
+	pShmLink->hWait = nullptr;
+	pShmLink->draining = false;
+	pShmLink->sendActive = false;
+	pShmLink->writing = false;
+	pShmLink->pSwitchMessage = nullptr;
+	pShmLink->pCarry = nullptr;
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+	{
+		delete pShmLink;
+		return;
+	}
+
+	pSession->pShmLink = pShmLink;
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	Send(pSession->sessionUID, pMessage);
+}
+
+void NetServer::OnShmReady(SESSION* pSession)
+{
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink == nullptr || pShmLink->hWait != nullptr)
+		return;
+
+	if (!RegisterWaitForSingleObject(&pShmLink->hWait, pShmLink->channel.GetRecvEvent(), OnShmSignaled, pShmLink, INFINITE, WT_EXECUTEINWAITTHREAD))
+	{
+		pShmLink->hWait = nullptr;
+		NetUtil::PrintError(GetLastError(), __LINE__);
+		return;
+	}
+
+	// pick up whatever the client wrote before the wait was registered
+	OnShmSignaled(pShmLink, FALSE);
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	SystemPacket_ShmSwitch packet;
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	// set before the push
+	pShmLink->pSwitchMessage = pMessage;
+	PushSend(pSession, pMessage, SEND_PRIORITY::BULK);
+
+	MarkSendReady(NetUtil::GetSessionIndexPart(pSession->sessionUID));
+}
+
+void CALLBACK NetServer::OnShmSignaled(PVOID pContext, BOOLEAN timedOut)
+{
+	SHM_LINK*  pShmLink = static_cast<SHM_LINK*>(pContext);
+	NetServer* pServer = pShmLink->pServer;
+	SESSION*   pSession = pShmLink->pSession;
+
+	// one drain per link, the ring is single consumer
+	if (pShmLink->draining.exchange(true))
+		return;
+
+	if (!pServer->PreventRelease(pSession))
+	{
+		pShmLink->draining = false;
+		return;
+	}
+
+	pSession->shmOverlapped.Internal = 0;
+
+	// 0 bytes would read as a closed connection
+	PostQueuedCompletionStatus(pServer->m_hIocp, 1, (ULONG_PTR)pSession, &pSession->shmOverlapped);
+}
+
+void NetServer::DrainShm(SESSION* pSession)
+{
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink == nullptr)
+		return;
+
+	ShmChannel& channel = pShmLink->channel;
+	int			framedCount = 0;
+	while (true)
+	{
+		while (!channel.IsEmpty())
+		{
+			// the drain stays claimed
+			if (m_RecvBudget > 0 && framedCount++ >= m_RecvBudget && PreventRelease(pSession))
+			{
+				pSession->shmOverlapped.Internal = 0;
+				PostQueuedCompletionStatus(m_hIocp, 1, (ULONG_PTR)pSession, &pSession->shmOverlapped);
+				return;
+			}
+
+			const int frameSize = channel.PeekFrameSize();
+			if (frameSize == 0)
+				break;
+
+			// a throttled drain stays claimed until its timer posts it
+			if (!AdmitFrame(pSession, frameSize, pSession->shmResumeTimer, &pSession->shmOverlapped))
+				return;
+
+			MESSAGE* pMessage = AllocateMessage();
+			if (pMessage == nullptr)
+				break;
+
+			if (!channel.Read(pMessage))
+			{
+				FreeMessage(pMessage);
+				break;
+			}
+
+			if (pMessage->header.type == PACKET_TYPE::SYSTEM)
+			{
+				m_SystemPacketProcessor.RunProcessor(pSession, pMessage);
+				FreeMessage(pMessage);
+				continue;
+			}
+
+			DispatchRecv(pSession, pMessage);
+		}
+
+		pShmLink->draining = false;
+
+		// a frame written before the wait was armed doesn't signal
+		if (channel.PrepareWait())
+			return;
+
+		if (pShmLink->draining.exchange(true))
+			return;
+	}
+}
+
+void NetServer::PostShmSend(SESSION* pSession)
+{
+	SHM_LINK* pShmLink = pSession->pShmLink;
+
+	if (pShmLink->writing.exchange(true))
+	{
+		MarkSendReady(NetUtil::GetSessionIndexPart(pSession->sessionUID));
+		return;
+	}
+
+	MESSAGE* pMessage = pShmLink->pCarry;
+	pShmLink->pCarry = nullptr;
+
+	while (pMessage != nullptr || (pMessage = PopQueuedSend(pSession)) != nullptr || (pMessage = PopSharedCopy(pSession)) != nullptr)
+	{
+		if (!pShmLink->channel.Write(pMessage))
+		{
+			pShmLink->pCarry = pMessage;
+			pShmLink->writing = false;
+			MarkSendReady(NetUtil::GetSessionIndexPart(pSession->sessionUID));
+			return;
+		}
+
+		FreeMessage(pMessage);
+		pMessage = nullptr;
+	}
+
+	pShmLink->writing = false;
+}
+
+void NetServer::ReleaseShmLink(SESSION* pSession)
+{
+	SHM_LINK* pShmLink = pSession->pShmLink;
+	if (pShmLink == nullptr)
+		return;
+
+	// blocks until a running OnShmSignaled has returned
+	if (pShmLink->hWait != nullptr)
+		UnregisterWaitEx(pShmLink->hWait, INVALID_HANDLE_VALUE);
+
+	FreeMessage(pShmLink->pCarry);
+
+	pSession->pShmLink = nullptr;
+	delete pShmLink;
+}
@@ -0,0 +1,293 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+
+#include <algorithm>
+
+// sized for the most workers that may ever run
+int NetServer::GetMaxWorkerCount(int workerThreadCnt) const
+{
+	return (std::max)({ workerThreadCnt, m_Threading.minWorkerCnt, m_Threading.maxWorkerCnt });
+}
+
+void NetServer::CreateThreads(int workerThreadCnt)
+{
+	if (m_Threading.sendThreadCnt < 1)
+		m_Threading.sendThreadCnt = 1;
+
+	m_MaxWorkerCnt = GetMaxWorkerCount(workerThreadCnt);
+	m_MinWorkerCnt = m_Threading.minWorkerCnt > 0 ? m_Threading.minWorkerCnt : workerThreadCnt;
+
+	m_NetCoreMask = 0;
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (!m_Threading.reservedCores.empty() && GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		DWORD_PTR reservedMask = 0;
+		for (int core : m_Threading.reservedCores)
+		{
+			if (core >= 0 && core < (int)(sizeof(DWORD_PTR) * 8))
+				reservedMask |= (DWORD_PTR)1 << core;
+		}
+
+		m_NetCoreMask = processMask & ~reservedMask;
+	}
+
+	m_ThreadSlotCnt = m_MaxWorkerCnt + m_Threading.sendThreadCnt + 1;
+	m_ThreadSlots = new THREAD_SLOT[m_ThreadSlotCnt];
+
+	const int initialWorkerCnt = (std::max)(workerThreadCnt, m_MinWorkerCnt);
+	for (int i = 0; i < initialWorkerCnt; ++i)
+		StartWorker(i);
+
+	for (int i = 0; i < m_Threading.sendThreadCnt; ++i)
+	{
+		THREAD_SLOT* pSlot = &m_ThreadSlots[m_MaxWorkerCnt + i];
+		pSlot->role = THREAD_ROLE::SEND;
+		pSlot->core = GetSlotCore(m_Threading.sendCores, i);
+		pSlot->running = true;
+		pSlot->thread = std::thread([this, pSlot, i]() { SendThread(pSlot, i); });
+	}
+
+	m_pAcceptSlot = &m_ThreadSlots[m_ThreadSlotCnt - 1];
+	m_pAcceptSlot->role = THREAD_ROLE::ACCEPT;
+	m_pAcceptSlot->core = GetSlotCore(std::vector<int>{ m_Threading.acceptCore }, 0);
+	m_pAcceptSlot->running = true;
+	if (m_pLoopback != nullptr)
+		m_pAcceptSlot->thread = std::thread([this]() { LoopbackAcceptThread(m_pAcceptSlot); });
+	else
+		m_pAcceptSlot->thread = std::thread([this]() { AcceptThread(m_pAcceptSlot); });
+
+	m_MonitorThread = std::thread([this]() { MonitorThread(); });
+}
+
+void NetServer::StartWorker(int slotIndex)
+{
+	THREAD_SLOT* pSlot = &m_ThreadSlots[slotIndex];
+
+	if (pSlot->hWake == NULL)
+	{
+		pSlot->hWake = CreateEventA(NULL, FALSE, FALSE, NULL);
+		if (pSlot->hWake == NULL)
+		{
+			NetUtil::PrintError(GetLastError(), __LINE__);
+			return;
+		}
+	}
+
+	const int numaNodeCnt = m_UseLargePageArena ? LargePageArena::GetNumaNodeCount() : 1;
+	const int numaNode = numaNodeCnt > 1 ? slotIndex % numaNodeCnt : NUMA_NODE_ANY;
+
+	pSlot->role = THREAD_ROLE::WORKER;
+	pSlot->core = GetSlotCore(m_Threading.workerCores, slotIndex);
+	pSlot->sampledBusyTicks = pSlot->busyTicks;
+	pSlot->utilization = 0;
+	pSlot->sampledSpinTicks = pSlot->spinTicks;
+	pSlot->sampledSpinCnt = pSlot->spinCnt;
+	pSlot->sampledSpinHitCnt = pSlot->spinHitCnt;
+	pSlot->spinPercent = 0;
+	pSlot->spinHitRate = 0;
+	pSlot->spinCapped = false;
+	pSlot->spinWindowUs = m_Threading.spinUs;
+	pSlot->running = true;
+
+	++m_ActiveWorkerCnt;
+
+	// a worker never ends, pool blocks point at its thread local queues
+	if (pSlot->thread.joinable())
+		SetEvent(pSlot->hWake);
+	else
+		pSlot->thread = std::thread([this, pSlot, numaNode]() { WorkerThread(pSlot, numaNode); });
+}
+
+int NetServer::GetSlotCore(const std::vector<int>& cores, int index) const
+{
+	if (cores.empty())
+		return -1;
+
+	const int core = cores[index % cores.size()];
+	if (core < 0 || core >= (int)(sizeof(DWORD_PTR) * 8))
+		return -1;
+
+	if (std::find(m_Threading.reservedCores.begin(), m_Threading.reservedCores.end(), core) != m_Threading.reservedCores.end())
+		return -1;
+
+	return core;
+}
+
+// -1 keeps the thread off the reserved cores
+void NetServer::PinThread(int core)
+{
+	DWORD_PTR mask = core >= 0 ? (DWORD_PTR)1 << core : m_NetCoreMask;
+	if (mask == 0)
+		return;
+
+	if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+		NetUtil::PrintError(GetLastError(), __LINE__);
+}
+
+// the queueing delay is a timestamped probe posted behind the queued completions
+void NetServer::MonitorThread()
+{
+	LARGE_INTEGER sampleTick;
+	QueryPerformanceCounter(&sampleTick);
+
+	while (true)
+	{
+		Sleep(m_Threading.sampleIntervalMs);
+
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+
+		const long long elapsed = now.QuadPart - sampleTick.QuadPart;
+		sampleTick = now;
+		if (elapsed <= 0)
+			continue;
+
+		int workerUtilization = 0;
+		int runningWorkerCnt = 0;
+		for (int i = 0; i < m_ThreadSlotCnt; ++i)
+		{
+			THREAD_SLOT& slot = m_ThreadSlots[i];
+
+			const long long busyTicks = slot.busyTicks.load(std::memory_order_relaxed);
+			const int		utilization = (int)(std::min)((busyTicks - slot.sampledBusyTicks) * 100 / elapsed, 100LL);
+			slot.sampledBusyTicks = busyTicks;
+			slot.utilization = utilization;
+
+			if (slot.role == THREAD_ROLE::WORKER)
+				SampleSpin(slot, elapsed);
+
+			if (slot.role == THREAD_ROLE::WORKER && slot.running)
+			{
+				workerUtilization += utilization;
+				++runningWorkerCnt;
+			}
+		}
+
+		long long delayTicks = m_ProbeDelayTicks;
+		if (m_ProbePending)
+			delayTicks = (std::max)(delayTicks, now.QuadPart - m_ProbeTick);
+		else
+		{
+			m_ProbeTick = now.QuadPart;
+			m_ProbePending = true;
+			PostQueuedCompletionStatus(m_hIocp, 1, NULL, &m_ProbeOverlapped);
+		}
+
+		m_CompletionDelayUs = delayTicks * 1000000 / m_TickFrequency;
+
+		if (m_HandOff || m_MinWorkerCnt == m_MaxWorkerCnt || runningWorkerCnt == 0)
+			continue;
+
+		ScaleWorkers(workerUtilization / runningWorkerCnt, m_CompletionDelayUs);
+	}
+}
+
+void NetServer::ScaleWorkers(int utilization, long long delayUs)
+{
+	const int activeWorkerCnt = m_ActiveWorkerCnt;
+	if (activeWorkerCnt < m_MaxWorkerCnt && (delayUs >= m_Threading.scaleUpDelayUs || utilization >= m_Threading.scaleUpUtilization))
+	{
+		for (int i = 0; i < m_MaxWorkerCnt; ++i)
+		{
+			if (!m_ThreadSlots[i].running)
+			{
+				StartWorker(i);
+				return;
+			}
+		}
+		return;
+	}
+
+	if (activeWorkerCnt > m_MinWorkerCnt && delayUs < m_Threading.scaleUpDelayUs / 4 && utilization <= m_Threading.scaleDownUtilization)
+	{
+		--m_ActiveWorkerCnt;
+		PostQueuedCompletionStatus(m_hIocp, 1, NULL, &m_RetireOverlapped);
+	}
+}
+
+void NetServer::SampleSpin(THREAD_SLOT& slot, long long elapsed)
+{
+	const long long spinTicks = slot.spinTicks.load(std::memory_order_relaxed);
+	const long long spinCnt = slot.spinCnt.load(std::memory_order_relaxed);
+	const long long spinHitCnt = slot.spinHitCnt.load(std::memory_order_relaxed);
+
+	const int spinPercent = (int)(std::min)((spinTicks - slot.sampledSpinTicks) * 100 / elapsed, 100LL);
+	slot.spinPercent = spinPercent;
+	slot.spinHitRate = spinCnt > slot.sampledSpinCnt ? (int)((spinHitCnt - slot.sampledSpinHitCnt) * 100 / (spinCnt - slot.sampledSpinCnt)) : 0;
+	slot.spinCapped = spinPercent > m_Threading.spinBudgetPercent;
+
+	slot.sampledSpinTicks = spinTicks;
+	slot.sampledSpinCnt = spinCnt;
+	slot.sampledSpinHitCnt = spinHitCnt;
+}
+
+int NetServer::WaitCompletions(THREAD_SLOT* pSlot, OVERLAPPED_ENTRY* pEntries, int batchSize)
+{
+	ULONG entryCnt = 0;
+
+	if (m_Threading.spinUs > 0 && !pSlot->spinCapped.load(std::memory_order_relaxed))
+	{
+		LARGE_INTEGER begin;
+		QueryPerformanceCounter(&begin);
+
+		const long long windowTicks = (long long)pSlot->spinWindowUs * m_TickFrequency / 1000000;
+
+		LARGE_INTEGER now;
+		do
+		{
+			if (GetQueuedCompletionStatusEx(m_hIocp, pEntries, batchSize, &entryCnt, 0, FALSE) && entryCnt > 0)
+				break;
+
+			entryCnt = 0;
+			YieldProcessor();
+			QueryPerformanceCounter(&now);
+		} while (now.QuadPart - begin.QuadPart < windowTicks);
+
+		QueryPerformanceCounter(&now);
+		pSlot->spinTicks.store(pSlot->spinTicks.load(std::memory_order_relaxed) + now.QuadPart - begin.QuadPart, std::memory_order_relaxed);
+		pSlot->spinCnt.store(pSlot->spinCnt.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		if (entryCnt > 0)
+		{
+			pSlot->spinHitCnt.store(pSlot->spinHitCnt.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			pSlot->spinWindowUs = (std::min)(pSlot->spinWindowUs * 2, m_Threading.spinUs);
+			return (int)entryCnt;
+		}
+
+		pSlot->spinWindowUs = (std::max)(pSlot->spinWindowUs / 2, SPIN_MIN_US);
+	}
+
+	// a failed I/O still comes back as an entry, this is a closed port
+	if (!GetQueuedCompletionStatusEx(m_hIocp, pEntries, batchSize, &entryCnt, INFINITE, FALSE))
+	{
+		pEntries[0].lpCompletionKey = 0;
+		pEntries[0].lpOverlapped = nullptr;
+		pEntries[0].dwNumberOfBytesTransferred = 0;
+		return 1;
+	}
+
+	return (int)entryCnt;
+}
+
+std::vector<THREAD_STATS> NetServer::GetThreadStats() const
+{
+	std::vector<THREAD_STATS> vecStats;
+	vecStats.reserve(m_ThreadSlotCnt);
+
+	for (int i = 0; i < m_ThreadSlotCnt; ++i)
+	{
+		const THREAD_SLOT& slot = m_ThreadSlots[i];
+
+		THREAD_STATS stats;
+		stats.role = slot.role;
+		stats.core = slot.core;
+		stats.utilization = slot.utilization;
+		stats.spinPercent = slot.spinPercent;
+		stats.spinHitRate = slot.spinHitRate;
+		stats.running = slot.running;
+		vecStats.push_back(stats);
+	}
+
+	return vecStats;
+}
@@ -0,0 +1,175 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+
+#include <algorithm>
+
+// held so ReleaseSession can't leave its topics in between
+bool NetServer::Subscribe(SESSION_UID sessionUID, TOPIC_ID topic)
+{
+	SESSION* pSession = AcquireSession(sessionUID);
+	if (pSession == nullptr)
+		return false;
+
+	bool subscribed;
+	{
+		std::lock_guard<std::mutex> lock(pSession->topicLock);
+		subscribed = m_Topics.Subscribe(topic, sessionUID);
+		if (subscribed)
+			pSession->vecTopic.push_back(topic);
+	}
+
+	UnlockPrevent(pSession);
+	return subscribed;
+}
+
+bool NetServer::Unsubscribe(SESSION_UID sessionUID, TOPIC_ID topic)
+{
+	SESSION* pSession = AcquireSession(sessionUID);
+	if (pSession == nullptr)
+		return false;
+
+	bool unsubscribed;
+	{
+		std::lock_guard<std::mutex> lock(pSession->topicLock);
+		unsubscribed = m_Topics.Unsubscribe(topic, sessionUID);
+
+		std::vector<TOPIC_ID>& vecTopic = pSession->vecTopic;
+		vecTopic.erase(std::remove(vecTopic.begin(), vecTopic.end(), topic), vecTopic.end());
+	}
+
+	UnlockPrevent(pSession);
+	return unsubscribed;
+}
+
+bool NetServer::Publish(TOPIC_ID topic, MESSAGE* pMessage)
+{
+	if (pMessage == nullptr)
+		return false;
+
+	TOPIC_MEMBERS members = m_Topics.GetMembers(topic);
+	if (members == nullptr)
+	{
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	// one count per member and one for this call
+	const int memberCnt = (int)members->size();
+	pMessage->shareCount.store(memberCnt + 1, std::memory_order_relaxed);
+
+	for (int begin = FANOUT_CHUNK_SIZE; begin < memberCnt; begin += FANOUT_CHUNK_SIZE)
+	{
+		FANOUT_TASK* pTask = new FANOUT_TASK;
+		ZeroMemory(&pTask->overlapped, sizeof(pTask->overlapped));
+		pTask->pFrame = pMessage;
+		pTask->members = members;
+		pTask->begin = begin;
+		pTask->end = (std::min)(begin + FANOUT_CHUNK_SIZE, memberCnt);
+
+		if (!PostQueuedCompletionStatus(m_hIocp, 1, NULL, &pTask->overlapped))
+		{
+			NetUtil::PrintError(GetLastError(), __LINE__);
+			FanOut(pTask->pFrame, *pTask->members, pTask->begin, pTask->end);
+			delete pTask;
+		}
+	}
+
+	FanOut(pMessage, *members, 0, (std::min)(FANOUT_CHUNK_SIZE, memberCnt));
+
+	ReleaseSharedFrame(pMessage);
+	return true;
+}
+
+void NetServer::FanOut(MESSAGE* pFrame, const std::vector<SESSION_UID>& members, int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		SESSION* pSession = AcquireSession(members[i]);
+		if (pSession == nullptr)
+		{
+			ReleaseSharedFrame(pFrame);
+			continue;
+		}
+
+		FRAME_REF* pRef = m_FrameRefPool.Allocate();
+		if (pRef == nullptr)
+		{
+			ReleaseSharedFrame(pFrame);
+			UnlockPrevent(pSession);
+			continue;
+		}
+
+		pRef->pFrame = pFrame;
+		PushShared(pSession, pRef);
+
+		MarkSendReady(NetUtil::GetSessionIndexPart(members[i]));
+
+		UnlockPrevent(pSession);
+	}
+}
+
+// the shared lane isn't in the lane age stats, subscribers share the queued tick
+void NetServer::PushShared(SESSION* pSession, FRAME_REF* pRef)
+{
+	const int frameSize = sizeof(pRef->pFrame->header) + pRef->pFrame->header.length;
+
+	pSession->sendSharedQ.Push(pRef);
+
+	if (m_CorkBytes > 0)
+	{
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+
+		pSession->corkBytes += frameSize;
+
+		long long noTick = 0;
+		pSession->corkTick.compare_exchange_strong(noTick, now.QuadPart);
+	}
+}
+
+MESSAGE* NetServer::PopSharedCopy(SESSION* pSession)
+{
+	FRAME_REF* pRef = pSession->sendSharedQ.Pop();
+	if (pRef == nullptr)
+		return nullptr;
+
+	MESSAGE* pCopy = CopySharedFrame(pRef);
+	if (pCopy == nullptr)
+		NetUtil::PrintError(ERROR_NOT_ENOUGH_MEMORY, __LINE__);
+
+	return pCopy;
+}
+
+MESSAGE* NetServer::CopySharedFrame(FRAME_REF* pRef)
+{
+	MESSAGE* pFrame = pRef->pFrame;
+	MESSAGE* pCopy = AllocateMessage();
+	if (pCopy != nullptr)
+		std::memcpy((char*)pCopy, (const char*)pFrame, sizeof(pFrame->header) + pFrame->header.length);
+
+	ReleaseFrameRef(pRef);
+	return pCopy;
+}
+
+void NetServer::ReleaseFrameRef(FRAME_REF* pRef)
+{
+	MESSAGE* pFrame = pRef->pFrame;
+	m_FrameRefPool.Free(pRef);
+
+	ReleaseSharedFrame(pFrame);
+}
+
+void NetServer::ReleaseSharedFrame(MESSAGE* pFrame)
+{
+	if (pFrame->shareCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		FreeMessage(pFrame);
+}
+
+void NetServer::LeaveTopics(SESSION* pSession)
+{
+	std::lock_guard<std::mutex> lock(pSession->topicLock);
+	for (TOPIC_ID topic : pSession->vecTopic)
+		m_Topics.Unsubscribe(topic, pSession->sessionUID);
+
+	pSession->vecTopic.clear();
+}
@@ -0,0 +1,160 @@
+#include "NetServer.h"
+#include "NetUtil.h"
+#include "SystemPacket.h"
+
+#include <bcrypt.h>
+
+bool NetServer::StartUdp(const char* ip, short port)
+{
+	if (m_MaxClientCnt == 0 || m_UdpStarted)
+		return false;
+
+	if (!m_UdpSocket.Open(ip, port))
+		return false;
+
+	m_UdpAllocate = [this]() { return AllocateMessage(); };
+	m_UdpFree = [this](MESSAGE* pMessage) { FreeMessage(pMessage); };
+
+	// published last, the accept thread binds peers as soon as it sees it
+	{
+		std::lock_guard<std::mutex> lock(m_SessionTableLock);
+
+		const int segmentCnt = m_SessionTableSize / SESSION_SEGMENT_SIZE;
+		for (int segment = 0; segment < segmentCnt; ++segment)
+		{
+			SESSION_SEGMENT* pSegment = m_SessionSegments[segment];
+			pSegment->pUdpPeers = new (std::nothrow) UdpPeer[SESSION_SEGMENT_SIZE];
+			if (pSegment->pUdpPeers == nullptr)
+				return false;
+		}
+
+		m_UdpStarted = true;
+	}
+
+	m_UdpThread = std::thread([this]() { UdpThread(); });
+
+	return true;
+}
+
+bool NetServer::SendDatagram(SESSION_UID sessionUID, MESSAGE* pMessage, DELIVERY delivery)
+{
+	if (pMessage == nullptr)
+		return false;
+
+	int sessionIdx = NetUtil::GetSessionIndexPart(sessionUID);
+	if (!m_UdpStarted || sessionIdx < 0 || sessionIdx >= m_SessionTableSize || !UdpPeer::CanCarry(pMessage))
+	{
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	UdpPeer& peer = *GetUdpPeer(sessionIdx);
+	if (peer.GetSessionUID() != sessionUID)
+	{
+		FreeMessage(pMessage);
+		return false;
+	}
+
+	peer.Queue(pMessage, delivery);
+	return true;
+}
+
+void NetServer::UdpThread()
+{
+	char datagram[UDP_MAX_DATAGRAM_SIZE];
+
+	while (true)
+	{
+		if (m_UdpSocket.Wait(1))
+		{
+			m_UdpSocket.Receive([this](const SOCKADDR_IN& addr, const char* pData, int size) {
+				OnUdpDatagram(addr, pData, size);
+			});
+		}
+
+		ULONGLONG now = GetTickCount64();
+		const int tableSize = m_SessionTableSize.load(std::memory_order_acquire);
+		for (int idx = 0; idx < tableSize; ++idx)
+		{
+			UdpPeer& peer = *GetUdpPeer(idx);
+			if (!peer.IsBound())
+				continue;
+
+			peer.Lock();
+
+			for (int batch = 0; batch < UDP_MAX_BATCH && peer.IsBound(); ++batch)
+			{
+				int size = peer.BuildDatagram(datagram, sizeof(datagram), now, m_UdpFree);
+				if (size == 0)
+					break;
+
+				m_UdpSocket.SendTo(peer.GetAddress(), datagram, size);
+			}
+
+			peer.Unlock();
+		}
+
+		m_UdpSocket.FlushDelayed();
+	}
+}
+
+void NetServer::BindUdpPeer(SESSION* pSession)
+{
+	if (!m_UdpStarted)
+		return;
+
+	// the token alone ties a datagram to its session
+	SystemPacket_UdpBind packet;
+	packet.m_SessionUID = pSession->sessionUID;
+	if (BCryptGenRandom(nullptr, (unsigned char*)&packet.m_Token, sizeof(packet.m_Token), BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0)
+		return;
+
+	int sessionIdx = NetUtil::GetSessionIndexPart(pSession->sessionUID);
+	GetUdpPeer(sessionIdx)->Reset(packet.m_SessionUID, packet.m_Token, m_UdpFree);
+
+	MESSAGE* pMessage = AllocateMessage();
+	if (pMessage == nullptr)
+		return;
+
+	pMessage->header.type = PACKET_TYPE::SYSTEM;
+	pMessage->put(&packet, sizeof(packet));
+
+	Send(pSession->sessionUID, pMessage);
+}
+
+void NetServer::OnUdpDatagram(const SOCKADDR_IN& addr, const char* pData, int size)
+{
+	if (size < (int)sizeof(UDP_HEADER))
+		return;
+
+	UDP_HEADER header;
+	std::memcpy(&header, pData, sizeof(header));
+
+	SESSION* pSession = AcquireSession(header.sessionUID);
+	if (pSession == nullptr)
+		return;
+
+	UdpPeer& peer = *GetUdpPeer(NetUtil::GetSessionIndexPart(header.sessionUID));
+
+	peer.Lock();
+
+	if (peer.GetSessionUID() != header.sessionUID || peer.GetToken() != header.token)
+	{
+		peer.Unlock();
+		UnlockPrevent(pSession);
+		return;
+	}
+
+	// the latest source address wins
+	peer.SetAddress(addr);
+	peer.OnDatagram(pData, size, m_UdpAllocate, m_UdpFree, m_vecUdpDelivered);
+
+	peer.Unlock();
+
+	for (MESSAGE* pMessage : m_vecUdpDelivered)
+		OnRecv(header.sessionUID, pMessage);
+
+	m_vecUdpDelivered.clear();
+
+	UnlockPrevent(pSession);
+}